@@ -15,15 +15,32 @@
  *   http://cr.yp.to/ecdh.html
  *
  * djb's sample implementation of curve25519 is written in a special assembly
- * language called qhasm and uses the floating point registers.
+ * language called qhasm and uses the floating point registers. The four-way
+ * floating-point ladder below follows it.
  *
  * This is, almost, a clean room reimplementation from the curve25519 paper. It
  * uses many of the tricks described therein. Only the crecip function is taken
  * from the sample implementation.
  */
 
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <sys/random.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-internal.h"
+#include "curve25519-donna-sha512.h"
+#if defined(CURVE25519_DONNA_TELEMETRY)
+#include "curve25519-donna-telemetry.h"
+#endif
+#if !defined(__x86_64__)
+#include <time.h>
+#endif
 
 typedef uint8_t u8;
 typedef uint64_t limb;
@@ -31,37 +48,70 @@ typedef limb felem[5];
 // This is a special gcc mode for 128-bit integers. It's implemented on 64-bit
 // platforms only as far as I know.
 typedef unsigned uint128_t __attribute__((mode(TI)));
+typedef int int128_t __attribute__((mode(TI)));
+
+/* The number of scalar multiplications that curve25519_donna_batch finishes
+ * with a single shared inversion. */
+#define CURVE25519_BATCH 32
+
+/* A partly filled group of ladders is only given to the four-way ladder if at
+ * least this many of its lanes are in use. */
+#define CURVE25519_LANES_MIN 3
+
+/* The same for the eight-way ladder. */
+#define CURVE25519_LANES8_MIN 5
 
 #undef force_inline
 #define force_inline __attribute__((always_inline))
 
-/* Sum two numbers: output += in */
+/* Returns the time stamp counter on x86-64 and the time in nanoseconds
+ * elsewhere. */
+static inline uint64_t
+ticks_now(void) {
+#if defined(__x86_64__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/* With CURVE25519_DONNA_TELEMETRY, the entry points and ladders time each call
+ * into the histograms of curve25519-donna-telemetry.h. TELEMETRY_START is the
+ * last declaration of a function and TELEMETRY_END goes before its returns. */
+#if defined(CURVE25519_DONNA_TELEMETRY)
+#define TELEMETRY_START const uint64_t telemetry_start = ticks_now()
+#define TELEMETRY_END(probe) \
+  curve25519_telemetry_record(probe, ticks_now() - telemetry_start)
+#else
+#define TELEMETRY_START (void) 0
+#define TELEMETRY_END(probe) (void) 0
+#endif
+
+/* output = a + b. The limbs of the result must stay below 2^54 for fmul. */
 static inline void force_inline
-fsum(limb *output, const limb *in) {
-  output[0] += in[0];
-  output[1] += in[1];
-  output[2] += in[2];
-  output[3] += in[3];
-  output[4] += in[4];
+fadd(felem output, const felem a, const felem b) {
+  output[0] = a[0] + b[0];
+  output[1] = a[1] + b[1];
+  output[2] = a[2] + b[2];
+  output[3] = a[3] + b[3];
+  output[4] = a[4] + b[4];
 }
 
-/* Find the difference of two numbers: output = in - output
- * (note the order of the arguments!)
- *
- * Assumes that out[i] < 2**52
- * On return, out[i] < 2**55
- */
+/* output = a - b, computed as a + 2p - b. b must be carried, i.e. the output
+ * of fmul, fsquare_times or fcarry, so that its limbs are below those of 2p.
+ * If the limbs of a are < 2^52.1, those of the result are < 2^53.1. */
 static inline void force_inline
-fdifference_backwards(felem out, const felem in) {
-  /* 152 is 19 << 3 */
-  static const limb two54m152 = (((limb)1) << 54) - 152;
-  static const limb two54m8 = (((limb)1) << 54) - 8;
+fsub(felem output, const felem a, const felem b) {
+  static const limb two52m38 = (((limb)1) << 52) - 38;
+  static const limb two52m2 = (((limb)1) << 52) - 2;
 
-  out[0] = in[0] + two54m152 - out[0];
-  out[1] = in[1] + two54m8 - out[1];
-  out[2] = in[2] + two54m8 - out[2];
-  out[3] = in[3] + two54m8 - out[3];
-  out[4] = in[4] + two54m8 - out[4];
+  output[0] = a[0] + two52m38 - b[0];
+  output[1] = a[1] + two52m2 - b[1];
+  output[2] = a[2] + two52m2 - b[2];
+  output[3] = a[3] + two52m2 - b[3];
+  output[4] = a[4] + two52m2 - b[4];
 }
 
 /* Multiply a number by a scalar: output = in * scalar */
@@ -89,11 +139,12 @@ fscalar_product(felem output, const felem in, const limb scalar) {
 
 /* Multiply two numbers: output = in2 * in
  *
- * output must be distinct to both inputs. The inputs are reduced coefficient
- * form, the output is not.
+ * The inputs are reduced coefficient form, the output is not. The limbs of
+ * the inputs must satisfy FMUL_SAFE, below.
  *
- * Assumes that in[i] < 2**55 and likewise for in2.
- * On return, output[i] < 2**52
+ * On return the output is carried: output[1] < 2^51 + 2^13 and the other
+ * limbs are < 2^51. The carry out of output[1] is left for the next
+ * operation, which can always absorb it.
  */
 static inline void force_inline
 fmul(felem output, const felem in2, const felem in) {
@@ -134,8 +185,7 @@ fmul(felem output, const felem in2, const felem in) {
   t[3] += c;      r3 = (limb)t[3] & 0x7ffffffffffff; c = (limb)(t[3] >> 51);
   t[4] += c;      r4 = (limb)t[4] & 0x7ffffffffffff; c = (limb)(t[4] >> 51);
   r0 +=   c * 19; c = r0 >> 51; r0 = r0 & 0x7ffffffffffff;
-  r1 +=   c;      c = r1 >> 51; r1 = r1 & 0x7ffffffffffff;
-  r2 +=   c;
+  r1 +=   c;
 
   output[0] = r0;
   output[1] = r1;
@@ -144,6 +194,11 @@ fmul(felem output, const felem in2, const felem in) {
   output[4] = r4;
 }
 
+/* Square a number count times: output = in^(2^count)
+ *
+ * The limbs of in must satisfy FMUL_SAFE(b, b), below, where b is their bound.
+ * The output is carried, as for fmul.
+ */
 static inline void force_inline
 fsquare_times(felem output, const felem in, limb count) {
   uint128_t t[5];
@@ -175,8 +230,7 @@ fsquare_times(felem output, const felem in, limb count) {
     t[3] += c;      r3 = (limb)t[3] & 0x7ffffffffffff; c = (limb)(t[3] >> 51);
     t[4] += c;      r4 = (limb)t[4] & 0x7ffffffffffff; c = (limb)(t[4] >> 51);
     r0 +=   c * 19; c = r0 >> 51; r0 = r0 & 0x7ffffffffffff;
-    r1 +=   c;      c = r1 >> 51; r1 = r1 & 0x7ffffffffffff;
-    r2 +=   c;
+    r1 +=   c;
   } while(--count);
 
   output[0] = r0;
@@ -280,47 +334,97 @@ fcontract(u8 *output, const felem input) {
   store_limb(output+24, (t[3] >> 39) | (t[4] << 12));
 }
 
+// -----------------------------------------------------------------------------
+// Limb bounds
+//
+// fmul and fsquare_times leave their last carry undone, and the ladder step
+// feeds sums and differences to them without carrying, so the bounds that make
+// this safe are checked by the compiler. Each BOUND_ macro is an upper bound
+// on all five limbs of a value, computed in 128 bits.
+// -----------------------------------------------------------------------------
+#define BOUND_ONE ((uint128_t) 1)
+
+/* The output of fexpand. */
+#define BOUND_EXPANDED (BOUND_ONE << 51)
+/* A carried value: the output of fmul, fsquare_times or fcarry. */
+#define BOUND_CARRIED ((BOUND_ONE << 51) + (1 << 13))
+/* The smallest limb of 2p, which fsub adds. */
+#define BOUND_2P_MIN ((BOUND_ONE << 52) - 38)
+
+#define BOUND_ADD(a, b) ((a) + (b))
+#define BOUND_SUB(a) ((a) + (BOUND_ONE << 52))
+/* fscalar_product: 19 times the final carry lands on 51 bits. */
+#define BOUND_SCALAR(a, s) \
+  ((BOUND_ONE << 51) + 19 * ((((a) * (s)) >> 51) + 1))
+
+/* The carry out of t[4] in fmul. t[3] < 23ab + 2^64, so its carry into t[4]
+ * is below 2^64 whenever the accumulators are safe. */
+#define FMUL_CARRY4(a, b) ((5 * (a) * (b) + (BOUND_ONE << 64)) >> 51)
+
+/* True if fmul is safe on inputs whose limbs are below a and b: the limbs
+ * times 38 fit in 64 bits, the largest accumulator (77ab, plus a carry) leaves
+ * its carry 64 bits, and the final carry is small enough that the output is
+ * within BOUND_CARRIED. fsquare_times(in) is safe if FMUL_SAFE(b, b) is. */
+#define FMUL_SAFE(a, b) \
+  (38 * (a) < (BOUND_ONE << 64) && 38 * (b) < (BOUND_ONE << 64) && \
+   77 * (a) * (b) + (BOUND_ONE << 64) < (BOUND_ONE << 115) && \
+   ((BOUND_ONE << 51) + 19 * (FMUL_CARRY4(a, b) + 1)) >> 51 < (1 << 13))
+
+_Static_assert(BOUND_CARRIED <= BOUND_2P_MIN, "fsub: b above 2p");
+_Static_assert(BOUND_EXPANDED <= BOUND_CARRIED, "fexpand: not carried");
+_Static_assert(FMUL_SAFE(BOUND_CARRIED, BOUND_CARRIED), "fmul: carried");
+
+/* The values in fmonty. Its inputs are carried, or fresh from fexpand. */
+#define BOUND_MONTY_SUM BOUND_ADD(BOUND_CARRIED, BOUND_CARRIED)
+#define BOUND_MONTY_DIFF BOUND_SUB(BOUND_CARRIED)
+#define BOUND_MONTY_ZZZ \
+  BOUND_ADD(BOUND_SCALAR(BOUND_MONTY_DIFF, 121665), BOUND_CARRIED)
+
+_Static_assert(FMUL_SAFE(BOUND_MONTY_DIFF, BOUND_MONTY_SUM), "fmonty: da, cb");
+_Static_assert(FMUL_SAFE(BOUND_MONTY_SUM, BOUND_MONTY_SUM), "fmonty: x3, aa");
+_Static_assert(FMUL_SAFE(BOUND_MONTY_DIFF, BOUND_MONTY_DIFF), "fmonty: z3, bb");
+_Static_assert(FMUL_SAFE(BOUND_MONTY_DIFF, BOUND_MONTY_ZZZ), "fmonty: z2");
+
 /* Input: Q, Q', Q-Q'
  * Output: 2Q, Q+Q'
  *
- *   x2 z3: long form
- *   x3 z3: long form
- *   x z: short form, destroyed
- *   xprime zprime: short form, destroyed
- *   qmqp: short form, preserved
+ *   x2 z2: carried
+ *   x3 z3: carried
+ *   x z: carried, preserved
+ *   xprime zprime: carried, preserved
+ *   qmqp: carried, preserved
+ *
+ * Every difference subtracts a carried value, so fsub's 2p offset suffices,
+ * and no sum or difference is carried before it is multiplied; the bounds are
+ * checked above.
  */
 static void
 fmonty(limb *x2, limb *z2, /* output 2Q */
        limb *x3, limb *z3, /* output Q + Q' */
-       limb *x, limb *z,   /* input Q */
-       limb *xprime, limb *zprime, /* input Q' */
+       const limb *x, const limb *z, /* input Q */
+       const limb *xprime, const limb *zprime, /* input Q' */
        const limb *qmqp /* input Q - Q' */) {
-  limb origx[5], origxprime[5], zzz[5], xx[5], zz[5], xxprime[5],
-        zzprime[5], zzzprime[5];
-
-  memcpy(origx, x, 5 * sizeof(limb));
-  fsum(x, z);
-  fdifference_backwards(z, origx);  // does x - z
-
-  memcpy(origxprime, xprime, sizeof(limb) * 5);
-  fsum(xprime, zprime);
-  fdifference_backwards(zprime, origxprime);
-  fmul(xxprime, xprime, z);
-  fmul(zzprime, x, zprime);
-  memcpy(origxprime, xxprime, sizeof(limb) * 5);
-  fsum(xxprime, zzprime);
-  fdifference_backwards(zzprime, origxprime);
-  fsquare_times(x3, xxprime, 1);
-  fsquare_times(zzzprime, zzprime, 1);
-  fmul(z3, zzzprime, qmqp);
-
-  fsquare_times(xx, x, 1);
-  fsquare_times(zz, z, 1);
-  fmul(x2, xx, zz);
-  fdifference_backwards(zz, xx);  // does zz = xx - zz
-  fscalar_product(zzz, zz, 121665);
-  fsum(zzz, xx);
-  fmul(z2, zz, zzz);
+  felem a, b, c, d, da, cb, aa, bb, e, t;
+
+  fadd(a, x, z);
+  fsub(b, x, z);
+  fadd(c, xprime, zprime);
+  fsub(d, xprime, zprime);
+  fmul(da, d, a);
+  fmul(cb, c, b);
+  fadd(t, da, cb);
+  fsquare_times(x3, t, 1);
+  fsub(t, da, cb);
+  fsquare_times(t, t, 1);
+  fmul(z3, t, qmqp);
+
+  fsquare_times(aa, a, 1);
+  fsquare_times(bb, b, 1);
+  fmul(x2, aa, bb);
+  fsub(e, aa, bb);
+  fscalar_product(t, e, 121665);
+  fadd(t, t, aa);
+  fmul(z2, e, t);
 }
 
 // -----------------------------------------------------------------------------
@@ -342,6 +446,53 @@ swap_conditional(limb a[5], limb b[5], limb iswap) {
   }
 }
 
+/* Runs count steps of the ladder, for bits top-1 down to top-count of the
+ * little endian number n, on the state nQ = (x:z), (n+1)Q = (xp:zp), where q
+ * is the x-coordinate of Q (short form). The state is updated in place. */
+static void
+ladder_steps(limb *x, limb *z, limb *xp, limb *zp, const u8 *n, unsigned top,
+             unsigned count, const limb *q) {
+  limb e[5], f[5], g[5], h[5];
+  limb *nqpqx = xp, *nqpqz = zp, *nqx = x, *nqz = z, *t;
+  limb *nqpqx2 = e, *nqpqz2 = f, *nqx2 = g, *nqz2 = h;
+  unsigned i;
+
+  for (i = top; i > top - count; --i) {
+    const limb bit = (n[(i - 1) >> 3] >> ((i - 1) & 7)) & 1;
+
+    swap_conditional(nqx, nqpqx, bit);
+    swap_conditional(nqz, nqpqz, bit);
+    fmonty(nqx2, nqz2,
+           nqpqx2, nqpqz2,
+           nqx, nqz,
+           nqpqx, nqpqz,
+           q);
+    swap_conditional(nqx2, nqpqx2, bit);
+    swap_conditional(nqz2, nqpqz2, bit);
+
+    t = nqx;
+    nqx = nqx2;
+    nqx2 = t;
+    t = nqz;
+    nqz = nqz2;
+    nqz2 = t;
+    t = nqpqx;
+    nqpqx = nqpqx2;
+    nqpqx2 = t;
+    t = nqpqz;
+    nqpqz = nqpqz2;
+    nqpqz2 = t;
+  }
+
+  /* After an odd number of steps the state is in the temporaries. */
+  if (nqx != x) {
+    memcpy(x, nqx, sizeof(limb) * 5);
+    memcpy(z, nqz, sizeof(limb) * 5);
+    memcpy(xp, nqpqx, sizeof(limb) * 5);
+    memcpy(zp, nqpqz, sizeof(limb) * 5);
+  }
+}
+
 /* Calculates nQ where Q is the x-coordinate of a point on the curve
  *
  *   resultx/resultz: the x coordinate of the resulting curve point (short form)
@@ -350,49 +501,126 @@ swap_conditional(limb a[5], limb b[5], limb iswap) {
  */
 static void
 cmult(limb *resultx, limb *resultz, const u8 *n, const limb *q) {
-  limb a[5] = {0}, b[5] = {1}, c[5] = {1}, d[5] = {0};
-  limb *nqpqx = a, *nqpqz = b, *nqx = c, *nqz = d, *t;
-  limb e[5] = {0}, f[5] = {1}, g[5] = {0}, h[5] = {1};
-  limb *nqpqx2 = e, *nqpqz2 = f, *nqx2 = g, *nqz2 = h;
+  limb a[5], b[5] = {1};
+  TELEMETRY_START;
 
-  unsigned i, j;
+  memcpy(a, q, sizeof(limb) * 5);
+  memset(resultx, 0, sizeof(limb) * 5);
+  memset(resultz, 0, sizeof(limb) * 5);
+  resultx[0] = 1;
+
+  ladder_steps(resultx, resultz, a, b, n, 256, 256, q);
+  TELEMETRY_END(CURVE25519_PROBE_LADDER);
+}
 
-  memcpy(nqpqx, q, sizeof(limb) * 5);
+// -----------------------------------------------------------------------------
+// Two ladders at once, in plain 64-bit code.
+//
+// The step of a single ladder is one long chain of dependent multiplications,
+// which leaves the multiplier idle while each product's carries propagate. Two
+// independent ladders, interleaved one field operation at a time, give the
+// out-of-order core a second chain to fill those gaps with. The two ladders
+// share the loop and the rotation of their buffers; only the swaps depend on
+// their own scalars.
+// -----------------------------------------------------------------------------
+
+/* fmonty for two independent sets of points. Each argument is an array of two
+ * elements, with the same requirements as for fmonty. */
+static void
+fmonty_x2(felem *x2, felem *z2, felem *x3, felem *z3, const felem *x,
+          const felem *z, const felem *xprime, const felem *zprime,
+          const felem *qmqp) {
+  felem a[2], b[2], c[2], d[2], da[2], cb[2], aa[2], bb[2], e[2], t[2];
+
+  fadd(a[0], x[0], z[0]);
+  fadd(a[1], x[1], z[1]);
+  fsub(b[0], x[0], z[0]);
+  fsub(b[1], x[1], z[1]);
+  fadd(c[0], xprime[0], zprime[0]);
+  fadd(c[1], xprime[1], zprime[1]);
+  fsub(d[0], xprime[0], zprime[0]);
+  fsub(d[1], xprime[1], zprime[1]);
+  fmul(da[0], d[0], a[0]);
+  fmul(da[1], d[1], a[1]);
+  fmul(cb[0], c[0], b[0]);
+  fmul(cb[1], c[1], b[1]);
+  fadd(t[0], da[0], cb[0]);
+  fadd(t[1], da[1], cb[1]);
+  fsquare_times(x3[0], t[0], 1);
+  fsquare_times(x3[1], t[1], 1);
+  fsub(t[0], da[0], cb[0]);
+  fsub(t[1], da[1], cb[1]);
+  fsquare_times(t[0], t[0], 1);
+  fsquare_times(t[1], t[1], 1);
+  fmul(z3[0], t[0], qmqp[0]);
+  fmul(z3[1], t[1], qmqp[1]);
+
+  fsquare_times(aa[0], a[0], 1);
+  fsquare_times(aa[1], a[1], 1);
+  fsquare_times(bb[0], b[0], 1);
+  fsquare_times(bb[1], b[1], 1);
+  fmul(x2[0], aa[0], bb[0]);
+  fmul(x2[1], aa[1], bb[1]);
+  fsub(e[0], aa[0], bb[0]);
+  fsub(e[1], aa[1], bb[1]);
+  fscalar_product(t[0], e[0], 121665);
+  fscalar_product(t[1], e[1], 121665);
+  fadd(t[0], t[0], aa[0]);
+  fadd(t[1], t[1], aa[1]);
+  fmul(z2[0], e[0], t[0]);
+  fmul(z2[1], e[1], t[1]);
+}
 
-  for (i = 0; i < 32; ++i) {
-    u8 byte = n[31 - i];
-    for (j = 0; j < 8; ++j) {
-      const limb bit = byte >> 7;
+/* Like cmult, for two scalars and points at once. Each argument is an array
+ * of two. */
+static void
+cmult_x2(felem *resultx, felem *resultz, const u8 *const *n, const felem *q) {
+  felem x[2], z[2], xp[2], zp[2], e[2], f[2], g[2], h[2];
+  felem *nqx = x, *nqz = z, *nqpqx = xp, *nqpqz = zp, *t;
+  felem *nqx2 = e, *nqz2 = f, *nqpqx2 = g, *nqpqz2 = h;
+  unsigned i, j;
+  TELEMETRY_START;
 
-      swap_conditional(nqx, nqpqx, bit);
-      swap_conditional(nqz, nqpqz, bit);
-      fmonty(nqx2, nqz2,
-             nqpqx2, nqpqz2,
-             nqx, nqz,
-             nqpqx, nqpqz,
-             q);
-      swap_conditional(nqx2, nqpqx2, bit);
-      swap_conditional(nqz2, nqpqz2, bit);
+  memset(x, 0, sizeof(x));
+  memset(z, 0, sizeof(z));
+  memset(zp, 0, sizeof(zp));
+  memcpy(xp, q, sizeof(xp));
+  for (j = 0; j < 2; ++j) {
+    x[j][0] = 1;
+    zp[j][0] = 1;
+  }
 
-      t = nqx;
-      nqx = nqx2;
-      nqx2 = t;
-      t = nqz;
-      nqz = nqz2;
-      nqz2 = t;
-      t = nqpqx;
-      nqpqx = nqpqx2;
-      nqpqx2 = t;
-      t = nqpqz;
-      nqpqz = nqpqz2;
-      nqpqz2 = t;
+  for (i = 256; i > 0; --i) {
+    limb bit[2];
 
-      byte <<= 1;
+    for (j = 0; j < 2; ++j) {
+      bit[j] = (n[j][(i - 1) >> 3] >> ((i - 1) & 7)) & 1;
+      swap_conditional(nqx[j], nqpqx[j], bit[j]);
+      swap_conditional(nqz[j], nqpqz[j], bit[j]);
+    }
+    fmonty_x2(nqx2, nqz2, nqpqx2, nqpqz2, nqx, nqz, nqpqx, nqpqz, q);
+    for (j = 0; j < 2; ++j) {
+      swap_conditional(nqx2[j], nqpqx2[j], bit[j]);
+      swap_conditional(nqz2[j], nqpqz2[j], bit[j]);
     }
+
+    t = nqx;
+    nqx = nqx2;
+    nqx2 = t;
+    t = nqz;
+    nqz = nqz2;
+    nqz2 = t;
+    t = nqpqx;
+    nqpqx = nqpqx2;
+    nqpqx2 = t;
+    t = nqpqz;
+    nqpqz = nqpqz2;
+    nqpqz2 = t;
   }
 
-  memcpy(resultx, nqx, sizeof(limb) * 5);
-  memcpy(resultz, nqz, sizeof(limb) * 5);
+  memcpy(resultx, nqx, sizeof(x));
+  memcpy(resultz, nqz, sizeof(z));
+  TELEMETRY_END(CURVE25519_PROBE_LADDER_X2);
 }
 
 
@@ -427,23 +655,3232 @@ crecip(felem out, const felem z) {
   /* 2^255 - 21 */ fmul(out, t0, a);
 }
 
-int curve25519_donna(u8 *, const u8 *, const u8 *);
+/* Returns 1 if in is zero mod p and 0 otherwise, in constant time. */
+static limb
+fiszero(const felem in) {
+  u8 bytes[32];
+  limb acc = 0;
+  unsigned i;
 
-int
-curve25519_donna(u8 *mypublic, const u8 *secret, const u8 *basepoint) {
-  limb bp[5], x[5], z[5], zmone[5];
-  uint8_t e[32];
-  int i;
+  fcontract(bytes, in);
+  for (i = 0; i < 32; ++i) acc |= bytes[i];
+  return (acc - 1) >> 63;
+}
 
-  for (i = 0;i < 32;++i) e[i] = secret[i];
-  e[0] &= 248;
-  e[31] &= 127;
-  e[31] |= 64;
+// -----------------------------------------------------------------------------
+// Invert @n field elements with a single crecip using Montgomery's trick:
+// 3(n-1) multiplications and one inversion instead of n inversions.
+//
+// Elements that are zero map to zero, exactly as crecip does, so one zero input
+// does not poison the rest of the batch. @n must be at most CURVE25519_BATCH,
+// @scratch must hold @n elements and @out may alias @z.
+// -----------------------------------------------------------------------------
+static void
+crecip_batch(felem *out, const felem *z, felem *scratch, unsigned n) {
+  felem inv, t, zi;
+  limb iszero[CURVE25519_BATCH];
+  unsigned i, j;
 
-  fexpand(bp, basepoint);
-  cmult(x, z, e, bp);
-  crecip(zmone, z);
-  fmul(z, x, zmone);
-  fcontract(mypublic, z);
-  return 0;
+  for (i = 0; i < n; ++i) {
+    iszero[i] = fiszero(z[i]);
+    memcpy(zi, z[i], sizeof(felem));
+    zi[0] += iszero[i];
+    if (i == 0) {
+      memcpy(scratch[0], zi, sizeof(felem));
+    } else {
+      fmul(scratch[i], scratch[i - 1], zi);
+    }
+  }
+
+  crecip(inv, scratch[n - 1]);
+
+  for (i = n - 1; i > 0; --i) {
+    memcpy(zi, z[i], sizeof(felem));
+    zi[0] += iszero[i];
+    fmul(t, inv, scratch[i - 1]);
+    fmul(inv, inv, zi);
+    for (j = 0; j < 5; ++j) out[i][j] = t[j] & (iszero[i] - 1);
+  }
+  for (j = 0; j < 5; ++j) out[0][j] = inv[j] & (iszero[0] - 1);
+}
+
+#if defined(__x86_64__)
+// -----------------------------------------------------------------------------
+// Four-way AVX2 ladder.
+//
+// Four independent ladders run side by side, one per 64-bit lane of a 256-bit
+// vector. vpmuludq only multiplies 32-bit operands, so inside the lanes field
+// elements use ten unsigned limbs in radix 2^25.5, as in curve25519-donna.c:
+//
+//   x[0] + 2^26·x[1] + 2^51·x[2] + 2^77·x[3] + ... + 2^230·x[9]
+//
+// i.e. the even limbs are 26 bits wide and the odd limbs 25 bits. Two adjacent
+// limbs make up exactly one 51-bit limb of the scalar code, which makes moving
+// values in and out of the lanes cheap.
+//
+// After v4carry, even limbs are < 2^26 and odd limbs < 2^25 + 2^16. A sum of
+// two such values, or a difference computed by v4difference, has even limbs
+// < 2^27.6 and odd limbs < 2^26.6. v4mul and v4square accept those bounds: the
+// operands scaled by 19 or 38 still fit in 32 bits and no 64-bit accumulator
+// exceeds 2^62.2.
+// -----------------------------------------------------------------------------
+
+typedef uint64_t v4limb __attribute__((vector_size(32)));
+typedef v4limb v4felem[10];
+
+#define lanes_target __attribute__((target("avx2")))
+#define vmul(a, b) ((v4limb) _mm256_mul_epu32((__m256i) (a), (__m256i) (b)))
+
+/* Sum two numbers: output = a + b */
+static inline void force_inline lanes_target
+v4sum(v4felem output, const v4felem a, const v4felem b) {
+  unsigned i;
+
+  for (i = 0; i < 10; ++i) output[i] = a[i] + b[i];
+}
+
+/* Find the difference of two numbers: output = a - b
+ *
+ * 2p is added to keep the limbs positive, so b must have been carried.
+ */
+static inline void force_inline lanes_target
+v4difference(v4felem output, const v4felem a, const v4felem b) {
+  const v4limb two_p0 = {0x7ffffda, 0x7ffffda, 0x7ffffda, 0x7ffffda};
+  const v4limb two_p_even = {0x7fffffe, 0x7fffffe, 0x7fffffe, 0x7fffffe};
+  const v4limb two_p_odd = {0x3fffffe, 0x3fffffe, 0x3fffffe, 0x3fffffe};
+
+  output[0] = a[0] + two_p0 - b[0];
+  output[1] = a[1] + two_p_odd - b[1];
+  output[2] = a[2] + two_p_even - b[2];
+  output[3] = a[3] + two_p_odd - b[3];
+  output[4] = a[4] + two_p_even - b[4];
+  output[5] = a[5] + two_p_odd - b[5];
+  output[6] = a[6] + two_p_even - b[6];
+  output[7] = a[7] + two_p_odd - b[7];
+  output[8] = a[8] + two_p_even - b[8];
+  output[9] = a[9] + two_p_odd - b[9];
+}
+
+/* Bring the limbs of h back to 26/25 bits. The inputs must be < 2^63. */
+static inline void force_inline lanes_target
+v4carry(v4felem h) {
+  const v4limb mask26 = {0x3ffffff, 0x3ffffff, 0x3ffffff, 0x3ffffff};
+  const v4limb mask25 = {0x1ffffff, 0x1ffffff, 0x1ffffff, 0x1ffffff};
+  v4limb c;
+
+  c = h[0] >> 26; h[1] += c; h[0] &= mask26;
+  c = h[4] >> 26; h[5] += c; h[4] &= mask26;
+  c = h[1] >> 25; h[2] += c; h[1] &= mask25;
+  c = h[5] >> 25; h[6] += c; h[5] &= mask25;
+  c = h[2] >> 26; h[3] += c; h[2] &= mask26;
+  c = h[6] >> 26; h[7] += c; h[6] &= mask26;
+  c = h[3] >> 25; h[4] += c; h[3] &= mask25;
+  c = h[7] >> 25; h[8] += c; h[7] &= mask25;
+  c = h[4] >> 26; h[5] += c; h[4] &= mask26;
+  c = h[8] >> 26; h[9] += c; h[8] &= mask26;
+  /* This carry can be up to 2^38, too wide for vpmuludq, so multiply it by 19
+   * with shifts. */
+  c = h[9] >> 25; h[0] += c + (c << 1) + (c << 4); h[9] &= mask25;
+  c = h[0] >> 26; h[1] += c; h[0] &= mask26;
+}
+
+/* Multiply two numbers: output = f * g */
+static inline void force_inline lanes_target
+v4mul(v4felem output, const v4felem f, const v4felem g) {
+  const v4limb nineteen = {19, 19, 19, 19};
+  const v4limb f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  const v4limb f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+  const v4limb g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+  const v4limb g5 = g[5], g6 = g[6], g7 = g[7], g8 = g[8], g9 = g[9];
+  const v4limb f1_2 = f1 + f1, f3_2 = f3 + f3, f5_2 = f5 + f5;
+  const v4limb f7_2 = f7 + f7, f9_2 = f9 + f9;
+  const v4limb g1_19 = vmul(g1, nineteen), g2_19 = vmul(g2, nineteen);
+  const v4limb g3_19 = vmul(g3, nineteen), g4_19 = vmul(g4, nineteen);
+  const v4limb g5_19 = vmul(g5, nineteen), g6_19 = vmul(g6, nineteen);
+  const v4limb g7_19 = vmul(g7, nineteen), g8_19 = vmul(g8, nineteen);
+  const v4limb g9_19 = vmul(g9, nineteen);
+
+  output[0] = vmul(f0, g0) + vmul(f1_2, g9_19) + vmul(f2, g8_19) +
+              vmul(f3_2, g7_19) + vmul(f4, g6_19) + vmul(f5_2, g5_19) +
+              vmul(f6, g4_19) + vmul(f7_2, g3_19) + vmul(f8, g2_19) +
+              vmul(f9_2, g1_19);
+  output[1] = vmul(f0, g1) + vmul(f1, g0) + vmul(f2, g9_19) +
+              vmul(f3, g8_19) + vmul(f4, g7_19) + vmul(f5, g6_19) +
+              vmul(f6, g5_19) + vmul(f7, g4_19) + vmul(f8, g3_19) +
+              vmul(f9, g2_19);
+  output[2] = vmul(f0, g2) + vmul(f1_2, g1) + vmul(f2, g0) +
+              vmul(f3_2, g9_19) + vmul(f4, g8_19) + vmul(f5_2, g7_19) +
+              vmul(f6, g6_19) + vmul(f7_2, g5_19) + vmul(f8, g4_19) +
+              vmul(f9_2, g3_19);
+  output[3] = vmul(f0, g3) + vmul(f1, g2) + vmul(f2, g1) + vmul(f3, g0) +
+              vmul(f4, g9_19) + vmul(f5, g8_19) + vmul(f6, g7_19) +
+              vmul(f7, g6_19) + vmul(f8, g5_19) + vmul(f9, g4_19);
+  output[4] = vmul(f0, g4) + vmul(f1_2, g3) + vmul(f2, g2) +
+              vmul(f3_2, g1) + vmul(f4, g0) + vmul(f5_2, g9_19) +
+              vmul(f6, g8_19) + vmul(f7_2, g7_19) + vmul(f8, g6_19) +
+              vmul(f9_2, g5_19);
+  output[5] = vmul(f0, g5) + vmul(f1, g4) + vmul(f2, g3) + vmul(f3, g2) +
+              vmul(f4, g1) + vmul(f5, g0) + vmul(f6, g9_19) +
+              vmul(f7, g8_19) + vmul(f8, g7_19) + vmul(f9, g6_19);
+  output[6] = vmul(f0, g6) + vmul(f1_2, g5) + vmul(f2, g4) +
+              vmul(f3_2, g3) + vmul(f4, g2) + vmul(f5_2, g1) + vmul(f6, g0) +
+              vmul(f7_2, g9_19) + vmul(f8, g8_19) + vmul(f9_2, g7_19);
+  output[7] = vmul(f0, g7) + vmul(f1, g6) + vmul(f2, g5) + vmul(f3, g4) +
+              vmul(f4, g3) + vmul(f5, g2) + vmul(f6, g1) + vmul(f7, g0) +
+              vmul(f8, g9_19) + vmul(f9, g8_19);
+  output[8] = vmul(f0, g8) + vmul(f1_2, g7) + vmul(f2, g6) +
+              vmul(f3_2, g5) + vmul(f4, g4) + vmul(f5_2, g3) + vmul(f6, g2) +
+              vmul(f7_2, g1) + vmul(f8, g0) + vmul(f9_2, g9_19);
+  output[9] = vmul(f0, g9) + vmul(f1, g8) + vmul(f2, g7) + vmul(f3, g6) +
+              vmul(f4, g5) + vmul(f5, g4) + vmul(f6, g3) + vmul(f7, g2) +
+              vmul(f8, g1) + vmul(f9, g0);
+
+  v4carry(output);
+}
+
+/* Square a number: output = f * f */
+static inline void force_inline lanes_target
+v4square(v4felem output, const v4felem f) {
+  const v4limb nineteen = {19, 19, 19, 19};
+  const v4limb thirtyeight = {38, 38, 38, 38};
+  const v4limb f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  const v4limb f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+  const v4limb f0_2 = f0 + f0, f1_2 = f1 + f1, f2_2 = f2 + f2;
+  const v4limb f3_2 = f3 + f3, f4_2 = f4 + f4, f5_2 = f5 + f5;
+  const v4limb f6_2 = f6 + f6, f7_2 = f7 + f7, f8_2 = f8 + f8;
+  const v4limb f9_2 = f9 + f9;
+  const v4limb f5_19 = vmul(f5, nineteen), f6_19 = vmul(f6, nineteen);
+  const v4limb f7_19 = vmul(f7, nineteen), f8_19 = vmul(f8, nineteen);
+  const v4limb f9_19 = vmul(f9, nineteen);
+  const v4limb f7_38 = vmul(f7, thirtyeight), f9_38 = vmul(f9, thirtyeight);
+
+  output[0] = vmul(f0, f0) + vmul(f1_2, f9_38) + vmul(f2_2, f8_19) +
+              vmul(f3_2, f7_38) + vmul(f4_2, f6_19) + vmul(f5_2, f5_19);
+  output[1] = vmul(f0_2, f1) + vmul(f2_2, f9_19) + vmul(f3_2, f8_19) +
+              vmul(f4_2, f7_19) + vmul(f5_2, f6_19);
+  output[2] = vmul(f0_2, f2) + vmul(f1_2, f1) + vmul(f3_2, f9_38) +
+              vmul(f4_2, f8_19) + vmul(f5_2, f7_38) + vmul(f6, f6_19);
+  output[3] = vmul(f0_2, f3) + vmul(f1_2, f2) + vmul(f4_2, f9_19) +
+              vmul(f5_2, f8_19) + vmul(f6_2, f7_19);
+  output[4] = vmul(f0_2, f4) + vmul(f1_2, f3_2) + vmul(f2, f2) +
+              vmul(f5_2, f9_38) + vmul(f6_2, f8_19) + vmul(f7_2, f7_19);
+  output[5] = vmul(f0_2, f5) + vmul(f1_2, f4) + vmul(f2_2, f3) +
+              vmul(f6_2, f9_19) + vmul(f7_2, f8_19);
+  output[6] = vmul(f0_2, f6) + vmul(f1_2, f5_2) + vmul(f2_2, f4) +
+              vmul(f3_2, f3) + vmul(f7_2, f9_38) + vmul(f8, f8_19);
+  output[7] = vmul(f0_2, f7) + vmul(f1_2, f6) + vmul(f2_2, f5) +
+              vmul(f3_2, f4) + vmul(f8_2, f9_19);
+  output[8] = vmul(f0_2, f8) + vmul(f1_2, f7_2) + vmul(f2_2, f6) +
+              vmul(f3_2, f5_2) + vmul(f4, f4) + vmul(f9_2, f9_19);
+  output[9] = vmul(f0_2, f9) + vmul(f1_2, f8) + vmul(f2_2, f7) +
+              vmul(f3_2, f6) + vmul(f4_2, f5);
+
+  v4carry(output);
+}
+
+/* Multiply a number by a small scalar: output = in * scalar
+ *
+ * scalar * in[i] must fit in 63 bits.
+ */
+static inline void force_inline lanes_target
+v4scalar_product(v4felem output, const v4felem in, const uint32_t scalar) {
+  const v4limb s = {scalar, scalar, scalar, scalar};
+  unsigned i;
+
+  for (i = 0; i < 10; ++i) output[i] = vmul(in[i], s);
+  v4carry(output);
+}
+
+/* Swap a and b in the lanes where mask is all ones. */
+static inline void force_inline lanes_target
+v4swap_conditional(v4felem a, v4felem b, const v4limb mask) {
+  unsigned i;
+
+  for (i = 0; i < 10; ++i) {
+    const v4limb x = mask & (a[i] ^ b[i]);
+    a[i] ^= x;
+    b[i] ^= x;
+  }
+}
+
+/* Calculates n[i]·q[i] for four lanes, like cmult.
+ *
+ *   resultx/resultz: the x coordinates of the resulting points (short form)
+ *   n: four little endian, 32-byte numbers with bit 255 clear
+ *   q: four points of the curve (short form)
+ */
+static void lanes_target
+cmult_lanes(felem *resultx, felem *resultz, const u8 *const *n,
+            const felem *q) {
+  v4felem x1, x2, z2, x3, z3, a, b, c, d, da, cb, aa, bb, e, t;
+  v4limb swap = {0, 0, 0, 0}, bit;
+  unsigned i, j;
+  int pos;
+  TELEMETRY_START;
+
+  for (j = 0; j < 5; ++j) {
+    const v4limb l = {q[0][j], q[1][j], q[2][j], q[3][j]};
+    const v4limb mask26 = {0x3ffffff, 0x3ffffff, 0x3ffffff, 0x3ffffff};
+    x1[2 * j] = l & mask26;
+    x1[2 * j + 1] = l >> 26;
+  }
+  for (i = 0; i < 10; ++i) {
+    const v4limb zero = {0, 0, 0, 0};
+    x2[i] = zero;
+    z2[i] = zero;
+    x3[i] = x1[i];
+    z3[i] = zero;
+  }
+  x2[0] += 1;
+  z3[0] += 1;
+
+  for (pos = 254; pos >= 0; --pos) {
+    bit[0] = (n[0][pos >> 3] >> (pos & 7)) & 1;
+    bit[1] = (n[1][pos >> 3] >> (pos & 7)) & 1;
+    bit[2] = (n[2][pos >> 3] >> (pos & 7)) & 1;
+    bit[3] = (n[3][pos >> 3] >> (pos & 7)) & 1;
+    swap ^= bit;
+    v4swap_conditional(x2, x3, -swap);
+    v4swap_conditional(z2, z3, -swap);
+    swap = bit;
+
+    v4sum(a, x2, z2);
+    v4difference(b, x2, z2);
+    v4sum(c, x3, z3);
+    v4difference(d, x3, z3);
+    v4mul(da, d, a);
+    v4mul(cb, c, b);
+    v4sum(t, da, cb);
+    v4square(x3, t);
+    v4difference(t, da, cb);
+    v4square(t, t);
+    v4mul(z3, x1, t);
+    v4square(aa, a);
+    v4square(bb, b);
+    v4mul(x2, aa, bb);
+    v4difference(e, aa, bb);
+    v4scalar_product(t, e, 121665);
+    v4sum(t, t, aa);
+    v4mul(z2, e, t);
+  }
+  v4swap_conditional(x2, x3, -swap);
+  v4swap_conditional(z2, z3, -swap);
+
+  for (i = 0; i < 4; ++i) {
+    for (j = 0; j < 5; ++j) {
+      resultx[i][j] = x2[2 * j][i] + (x2[2 * j + 1][i] << 26);
+      resultz[i][j] = z2[2 * j][i] + (z2[2 * j + 1][i] << 26);
+    }
+  }
+  TELEMETRY_END(CURVE25519_PROBE_LADDER_LANES);
+}
+
+static int
+have_lanes(void) {
+  return __builtin_cpu_supports("avx2");
+}
+
+// -----------------------------------------------------------------------------
+// Eight-way AVX-512 ladder.
+//
+// The four-way ladder widened to the eight 64-bit lanes of a 512-bit vector,
+// with the same limbs and bounds; each v8 function below is its v4 namesake.
+// Values are moved between the scalar code's arrays of field elements and the
+// lanes by lanes8_load and lanes8_store, which transpose eight elements at a
+// time.
+// -----------------------------------------------------------------------------
+
+typedef uint64_t v8limb __attribute__((vector_size(64)));
+typedef v8limb v8felem[10];
+
+#define lanes8_target __attribute__((target("avx512f")))
+#define v8splat(x) {x, x, x, x, x, x, x, x}
+#define vmul8(a, b) ((v8limb) _mm512_mul_epu32((__m512i) (a), (__m512i) (b)))
+
+/* As v4sum. */
+static inline void force_inline lanes8_target
+v8sum(v8felem output, const v8felem a, const v8felem b) {
+  unsigned i;
+
+  for (i = 0; i < 10; ++i) output[i] = a[i] + b[i];
+}
+
+/* As v4difference: b must have been carried. */
+static inline void force_inline lanes8_target
+v8difference(v8felem output, const v8felem a, const v8felem b) {
+  const v8limb two_p0 = v8splat(0x7ffffda);
+  const v8limb two_p_even = v8splat(0x7fffffe);
+  const v8limb two_p_odd = v8splat(0x3fffffe);
+
+  output[0] = a[0] + two_p0 - b[0];
+  output[1] = a[1] + two_p_odd - b[1];
+  output[2] = a[2] + two_p_even - b[2];
+  output[3] = a[3] + two_p_odd - b[3];
+  output[4] = a[4] + two_p_even - b[4];
+  output[5] = a[5] + two_p_odd - b[5];
+  output[6] = a[6] + two_p_even - b[6];
+  output[7] = a[7] + two_p_odd - b[7];
+  output[8] = a[8] + two_p_even - b[8];
+  output[9] = a[9] + two_p_odd - b[9];
+}
+
+/* As v4carry. */
+static inline void force_inline lanes8_target
+v8carry(v8felem h) {
+  const v8limb mask26 = v8splat(0x3ffffff);
+  const v8limb mask25 = v8splat(0x1ffffff);
+  v8limb c;
+
+  c = h[0] >> 26; h[1] += c; h[0] &= mask26;
+  c = h[4] >> 26; h[5] += c; h[4] &= mask26;
+  c = h[1] >> 25; h[2] += c; h[1] &= mask25;
+  c = h[5] >> 25; h[6] += c; h[5] &= mask25;
+  c = h[2] >> 26; h[3] += c; h[2] &= mask26;
+  c = h[6] >> 26; h[7] += c; h[6] &= mask26;
+  c = h[3] >> 25; h[4] += c; h[3] &= mask25;
+  c = h[7] >> 25; h[8] += c; h[7] &= mask25;
+  c = h[4] >> 26; h[5] += c; h[4] &= mask26;
+  c = h[8] >> 26; h[9] += c; h[8] &= mask26;
+  c = h[9] >> 25; h[0] += c + (c << 1) + (c << 4); h[9] &= mask25;
+  c = h[0] >> 26; h[1] += c; h[0] &= mask26;
+}
+
+/* As v4mul. */
+static inline void force_inline lanes8_target
+v8mul(v8felem output, const v8felem f, const v8felem g) {
+  const v8limb nineteen = v8splat(19);
+  const v8limb f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  const v8limb f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+  const v8limb g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+  const v8limb g5 = g[5], g6 = g[6], g7 = g[7], g8 = g[8], g9 = g[9];
+  const v8limb f1_2 = f1 + f1, f3_2 = f3 + f3, f5_2 = f5 + f5;
+  const v8limb f7_2 = f7 + f7, f9_2 = f9 + f9;
+  const v8limb g1_19 = vmul8(g1, nineteen), g2_19 = vmul8(g2, nineteen);
+  const v8limb g3_19 = vmul8(g3, nineteen), g4_19 = vmul8(g4, nineteen);
+  const v8limb g5_19 = vmul8(g5, nineteen), g6_19 = vmul8(g6, nineteen);
+  const v8limb g7_19 = vmul8(g7, nineteen), g8_19 = vmul8(g8, nineteen);
+  const v8limb g9_19 = vmul8(g9, nineteen);
+
+  output[0] = vmul8(f0, g0) + vmul8(f1_2, g9_19) + vmul8(f2, g8_19) +
+              vmul8(f3_2, g7_19) + vmul8(f4, g6_19) + vmul8(f5_2, g5_19) +
+              vmul8(f6, g4_19) + vmul8(f7_2, g3_19) + vmul8(f8, g2_19) +
+              vmul8(f9_2, g1_19);
+  output[1] = vmul8(f0, g1) + vmul8(f1, g0) + vmul8(f2, g9_19) +
+              vmul8(f3, g8_19) + vmul8(f4, g7_19) + vmul8(f5, g6_19) +
+              vmul8(f6, g5_19) + vmul8(f7, g4_19) + vmul8(f8, g3_19) +
+              vmul8(f9, g2_19);
+  output[2] = vmul8(f0, g2) + vmul8(f1_2, g1) + vmul8(f2, g0) +
+              vmul8(f3_2, g9_19) + vmul8(f4, g8_19) + vmul8(f5_2, g7_19) +
+              vmul8(f6, g6_19) + vmul8(f7_2, g5_19) + vmul8(f8, g4_19) +
+              vmul8(f9_2, g3_19);
+  output[3] = vmul8(f0, g3) + vmul8(f1, g2) + vmul8(f2, g1) + vmul8(f3, g0) +
+              vmul8(f4, g9_19) + vmul8(f5, g8_19) + vmul8(f6, g7_19) +
+              vmul8(f7, g6_19) + vmul8(f8, g5_19) + vmul8(f9, g4_19);
+  output[4] = vmul8(f0, g4) + vmul8(f1_2, g3) + vmul8(f2, g2) +
+              vmul8(f3_2, g1) + vmul8(f4, g0) + vmul8(f5_2, g9_19) +
+              vmul8(f6, g8_19) + vmul8(f7_2, g7_19) + vmul8(f8, g6_19) +
+              vmul8(f9_2, g5_19);
+  output[5] = vmul8(f0, g5) + vmul8(f1, g4) + vmul8(f2, g3) + vmul8(f3, g2) +
+              vmul8(f4, g1) + vmul8(f5, g0) + vmul8(f6, g9_19) +
+              vmul8(f7, g8_19) + vmul8(f8, g7_19) + vmul8(f9, g6_19);
+  output[6] = vmul8(f0, g6) + vmul8(f1_2, g5) + vmul8(f2, g4) +
+              vmul8(f3_2, g3) + vmul8(f4, g2) + vmul8(f5_2, g1) + vmul8(f6, g0) +
+              vmul8(f7_2, g9_19) + vmul8(f8, g8_19) + vmul8(f9_2, g7_19);
+  output[7] = vmul8(f0, g7) + vmul8(f1, g6) + vmul8(f2, g5) + vmul8(f3, g4) +
+              vmul8(f4, g3) + vmul8(f5, g2) + vmul8(f6, g1) + vmul8(f7, g0) +
+              vmul8(f8, g9_19) + vmul8(f9, g8_19);
+  output[8] = vmul8(f0, g8) + vmul8(f1_2, g7) + vmul8(f2, g6) +
+              vmul8(f3_2, g5) + vmul8(f4, g4) + vmul8(f5_2, g3) + vmul8(f6, g2) +
+              vmul8(f7_2, g1) + vmul8(f8, g0) + vmul8(f9_2, g9_19);
+  output[9] = vmul8(f0, g9) + vmul8(f1, g8) + vmul8(f2, g7) + vmul8(f3, g6) +
+              vmul8(f4, g5) + vmul8(f5, g4) + vmul8(f6, g3) + vmul8(f7, g2) +
+              vmul8(f8, g1) + vmul8(f9, g0);
+
+  v8carry(output);
+}
+
+/* As v4square. */
+static inline void force_inline lanes8_target
+v8square(v8felem output, const v8felem f) {
+  const v8limb nineteen = v8splat(19);
+  const v8limb thirtyeight = v8splat(38);
+  const v8limb f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  const v8limb f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+  const v8limb f0_2 = f0 + f0, f1_2 = f1 + f1, f2_2 = f2 + f2;
+  const v8limb f3_2 = f3 + f3, f4_2 = f4 + f4, f5_2 = f5 + f5;
+  const v8limb f6_2 = f6 + f6, f7_2 = f7 + f7, f8_2 = f8 + f8;
+  const v8limb f9_2 = f9 + f9;
+  const v8limb f5_19 = vmul8(f5, nineteen), f6_19 = vmul8(f6, nineteen);
+  const v8limb f7_19 = vmul8(f7, nineteen), f8_19 = vmul8(f8, nineteen);
+  const v8limb f9_19 = vmul8(f9, nineteen);
+  const v8limb f7_38 = vmul8(f7, thirtyeight), f9_38 = vmul8(f9, thirtyeight);
+
+  output[0] = vmul8(f0, f0) + vmul8(f1_2, f9_38) + vmul8(f2_2, f8_19) +
+              vmul8(f3_2, f7_38) + vmul8(f4_2, f6_19) + vmul8(f5_2, f5_19);
+  output[1] = vmul8(f0_2, f1) + vmul8(f2_2, f9_19) + vmul8(f3_2, f8_19) +
+              vmul8(f4_2, f7_19) + vmul8(f5_2, f6_19);
+  output[2] = vmul8(f0_2, f2) + vmul8(f1_2, f1) + vmul8(f3_2, f9_38) +
+              vmul8(f4_2, f8_19) + vmul8(f5_2, f7_38) + vmul8(f6, f6_19);
+  output[3] = vmul8(f0_2, f3) + vmul8(f1_2, f2) + vmul8(f4_2, f9_19) +
+              vmul8(f5_2, f8_19) + vmul8(f6_2, f7_19);
+  output[4] = vmul8(f0_2, f4) + vmul8(f1_2, f3_2) + vmul8(f2, f2) +
+              vmul8(f5_2, f9_38) + vmul8(f6_2, f8_19) + vmul8(f7_2, f7_19);
+  output[5] = vmul8(f0_2, f5) + vmul8(f1_2, f4) + vmul8(f2_2, f3) +
+              vmul8(f6_2, f9_19) + vmul8(f7_2, f8_19);
+  output[6] = vmul8(f0_2, f6) + vmul8(f1_2, f5_2) + vmul8(f2_2, f4) +
+              vmul8(f3_2, f3) + vmul8(f7_2, f9_38) + vmul8(f8, f8_19);
+  output[7] = vmul8(f0_2, f7) + vmul8(f1_2, f6) + vmul8(f2_2, f5) +
+              vmul8(f3_2, f4) + vmul8(f8_2, f9_19);
+  output[8] = vmul8(f0_2, f8) + vmul8(f1_2, f7_2) + vmul8(f2_2, f6) +
+              vmul8(f3_2, f5_2) + vmul8(f4, f4) + vmul8(f9_2, f9_19);
+  output[9] = vmul8(f0_2, f9) + vmul8(f1_2, f8) + vmul8(f2_2, f7) +
+              vmul8(f3_2, f6) + vmul8(f4_2, f5);
+
+  v8carry(output);
+}
+
+/* As v4scalar_product. */
+static inline void force_inline lanes8_target
+v8scalar_product(v8felem output, const v8felem in, const uint32_t scalar) {
+  const v8limb s = v8splat(scalar);
+  unsigned i;
+
+  for (i = 0; i < 10; ++i) output[i] = vmul8(in[i], s);
+  v8carry(output);
+}
+
+/* As v4swap_conditional. */
+static inline void force_inline lanes8_target
+v8swap_conditional(v8felem a, v8felem b, const v8limb mask) {
+  unsigned i;
+
+  for (i = 0; i < 10; ++i) {
+    const v8limb x = mask & (a[i] ^ b[i]);
+    a[i] ^= x;
+    b[i] ^= x;
+  }
+}
+
+/* Transposes q[0..7] into out: limb j of q[i] becomes lane i of out[2j] and
+ * out[2j+1]. */
+static inline void force_inline lanes8_target
+lanes8_load(v8felem out, const felem *q) {
+  const v8limb mask26 = v8splat(0x3ffffff);
+  unsigned j;
+
+  for (j = 0; j < 5; ++j) {
+    const v8limb l = {q[0][j], q[1][j], q[2][j], q[3][j],
+                      q[4][j], q[5][j], q[6][j], q[7][j]};
+    out[2 * j] = l & mask26;
+    out[2 * j + 1] = l >> 26;
+  }
+}
+
+/* The inverse of lanes8_load. */
+static inline void force_inline lanes8_target
+lanes8_store(felem *out, const v8felem in) {
+  unsigned i, j;
+
+  for (i = 0; i < 8; ++i) {
+    for (j = 0; j < 5; ++j) out[i][j] = in[2 * j][i] + (in[2 * j + 1][i] << 26);
+  }
+}
+
+/* Calculates n[i]·q[i] for eight lanes, like cmult_lanes. */
+static void lanes8_target
+cmult_lanes8(felem *resultx, felem *resultz, const u8 *const *n,
+             const felem *q) {
+  v8felem x1, x2, z2, x3, z3, a, b, c, d, da, cb, aa, bb, e, t;
+  v8limb swap = v8splat(0), bit;
+  unsigned i;
+  int pos;
+  TELEMETRY_START;
+
+  lanes8_load(x1, q);
+  for (i = 0; i < 10; ++i) {
+    const v8limb zero = v8splat(0);
+    x2[i] = zero;
+    z2[i] = zero;
+    x3[i] = x1[i];
+    z3[i] = zero;
+  }
+  x2[0] += 1;
+  z3[0] += 1;
+
+  for (pos = 254; pos >= 0; --pos) {
+    for (i = 0; i < 8; ++i) bit[i] = (n[i][pos >> 3] >> (pos & 7)) & 1;
+    swap ^= bit;
+    v8swap_conditional(x2, x3, -swap);
+    v8swap_conditional(z2, z3, -swap);
+    swap = bit;
+
+    v8sum(a, x2, z2);
+    v8difference(b, x2, z2);
+    v8sum(c, x3, z3);
+    v8difference(d, x3, z3);
+    v8mul(da, d, a);
+    v8mul(cb, c, b);
+    v8sum(t, da, cb);
+    v8square(x3, t);
+    v8difference(t, da, cb);
+    v8square(t, t);
+    v8mul(z3, x1, t);
+    v8square(aa, a);
+    v8square(bb, b);
+    v8mul(x2, aa, bb);
+    v8difference(e, aa, bb);
+    v8scalar_product(t, e, 121665);
+    v8sum(t, t, aa);
+    v8mul(z2, e, t);
+  }
+  v8swap_conditional(x2, x3, -swap);
+  v8swap_conditional(z2, z3, -swap);
+
+  lanes8_store(resultx, x2);
+  lanes8_store(resultz, z2);
+  TELEMETRY_END(CURVE25519_PROBE_LADDER_LANES8);
+}
+
+static int
+have_lanes8(void) {
+  return __builtin_cpu_supports("avx512f");
+}
+
+// -----------------------------------------------------------------------------
+// Four-way floating-point ladder.
+//
+// Four ladders in the four doubles of a 256-bit vector, in the manner of djb's
+// original code, which kept field elements in the floating point registers.
+// For the products to be exact in a double's 53 bits, elements use twelve
+// signed limbs in radix 2^21.25, as djb's did:
+//
+//   x[0] + x[1] + ... + x[11]
+//
+// where x[i] is a multiple of 2^e(i), e(i) = ceil(21.25·i), so that each limb
+// carries its own scale and x[i]·y[j] is a multiple of 2^e(i+j). After
+// f4carry, |x[i]| <= 2^(e(i+1)-1), i.e. at most 2^21 units of 2^e(i), with a
+// little more in limbs 1 and 7. With sums or differences of two such values as
+// inputs, a limb of a product is a sum of twelve terms of at most 2^45 units
+// each, scaled by 19 for the terms that wrap past 2^255, which stays below
+// 2^53 units of 2^e(k).
+//
+// Carries round a limb to a multiple of 2^e(i+1) by adding and subtracting
+// 3·2^(51+e(i+1)), so this code must not be built with -ffast-math. With FMA,
+// the compiler fuses each product into its sum, which changes nothing since
+// every step is exact.
+// -----------------------------------------------------------------------------
+
+typedef double v4double __attribute__((vector_size(32)));
+typedef v4double f4felem[12];
+
+#define flanes_target __attribute__((target("avx2,fma")))
+#define f4splat(x) {x, x, x, x}
+
+/* e(i) and 2^e(i) for i = 0 .. 12. */
+static const unsigned flanes_shift[13] = {
+  0, 22, 43, 64, 85, 107, 128, 149, 170, 192, 213, 234, 255
+};
+static const double flanes_unit[13] = {
+  0x1p0, 0x1p22, 0x1p43, 0x1p64, 0x1p85, 0x1p107, 0x1p128, 0x1p149, 0x1p170,
+  0x1p192, 0x1p213, 0x1p234, 0x1p255
+};
+
+/* Sum two numbers: output = a + b */
+static inline void force_inline flanes_target
+f4sum(f4felem output, const f4felem a, const f4felem b) {
+  unsigned i;
+
+  for (i = 0; i < 12; ++i) output[i] = a[i] + b[i];
+}
+
+/* Find the difference of two numbers: output = a - b. The limbs are signed,
+ * so no multiple of p needs adding. */
+static inline void force_inline flanes_target
+f4difference(f4felem output, const f4felem a, const f4felem b) {
+  unsigned i;
+
+  for (i = 0; i < 12; ++i) output[i] = a[i] - b[i];
+}
+
+/* Returns x rounded to a multiple of alpha/3·2^-51, for |x| < alpha/3. */
+static inline v4double force_inline flanes_target
+f4round(const v4double x, const double alpha) {
+  const v4double a = f4splat(alpha);
+
+  return (x + a) - a;
+}
+
+/* Bring the limbs of h back within the bounds above, in two chains of six
+ * carries. Each limb must be below 2^52 units of its scale. */
+static inline void force_inline flanes_target
+f4carry(f4felem h) {
+  const v4double s = f4splat(0x13p-255);
+  v4double c;
+
+  c = f4round(h[0], 0x3p73); h[0] -= c; h[1] += c;
+  c = f4round(h[6], 0x3p200); h[6] -= c; h[7] += c;
+  c = f4round(h[1], 0x3p94); h[1] -= c; h[2] += c;
+  c = f4round(h[7], 0x3p221); h[7] -= c; h[8] += c;
+  c = f4round(h[2], 0x3p115); h[2] -= c; h[3] += c;
+  c = f4round(h[8], 0x3p243); h[8] -= c; h[9] += c;
+  c = f4round(h[3], 0x3p136); h[3] -= c; h[4] += c;
+  c = f4round(h[9], 0x3p264); h[9] -= c; h[10] += c;
+  c = f4round(h[4], 0x3p158); h[4] -= c; h[5] += c;
+  c = f4round(h[10], 0x3p285); h[10] -= c; h[11] += c;
+  c = f4round(h[5], 0x3p179); h[5] -= c; h[6] += c;
+  c = f4round(h[11], 0x3p306); h[11] -= c; h[0] += c * s;
+  c = f4round(h[0], 0x3p73); h[0] -= c; h[1] += c;
+  c = f4round(h[6], 0x3p200); h[6] -= c; h[7] += c;
+}
+
+/* Multiply two numbers: output = f * g
+ *
+ * g*_19 are the limbs of g scaled by 19·2^-255, for the terms past 2^255.
+ */
+static inline void force_inline flanes_target
+f4mul(f4felem output, const f4felem f, const f4felem g) {
+  const v4double s = f4splat(0x13p-255);
+  const v4double f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  const v4double f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+  const v4double f10 = f[10], f11 = f[11];
+  const v4double g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+  const v4double g5 = g[5], g6 = g[6], g7 = g[7], g8 = g[8], g9 = g[9];
+  const v4double g10 = g[10], g11 = g[11];
+  const v4double g1_19 = g1 * s, g2_19 = g2 * s, g3_19 = g3 * s,
+                 g4_19 = g4 * s, g5_19 = g5 * s, g6_19 = g6 * s,
+                 g7_19 = g7 * s, g8_19 = g8 * s, g9_19 = g9 * s,
+                 g10_19 = g10 * s, g11_19 = g11 * s;
+
+  output[0] = f0 * g0 + f1 * g11_19 + f2 * g10_19 + f3 * g9_19 + f4 * g8_19 +
+              f5 * g7_19 + f6 * g6_19 + f7 * g5_19 + f8 * g4_19 + f9 * g3_19 +
+              f10 * g2_19 + f11 * g1_19;
+  output[1] = f0 * g1 + f1 * g0 + f2 * g11_19 + f3 * g10_19 + f4 * g9_19 +
+              f5 * g8_19 + f6 * g7_19 + f7 * g6_19 + f8 * g5_19 + f9 * g4_19 +
+              f10 * g3_19 + f11 * g2_19;
+  output[2] = f0 * g2 + f1 * g1 + f2 * g0 + f3 * g11_19 + f4 * g10_19 +
+              f5 * g9_19 + f6 * g8_19 + f7 * g7_19 + f8 * g6_19 + f9 * g5_19 +
+              f10 * g4_19 + f11 * g3_19;
+  output[3] = f0 * g3 + f1 * g2 + f2 * g1 + f3 * g0 + f4 * g11_19 +
+              f5 * g10_19 + f6 * g9_19 + f7 * g8_19 + f8 * g7_19 + f9 * g6_19 +
+              f10 * g5_19 + f11 * g4_19;
+  output[4] = f0 * g4 + f1 * g3 + f2 * g2 + f3 * g1 + f4 * g0 + f5 * g11_19 +
+              f6 * g10_19 + f7 * g9_19 + f8 * g8_19 + f9 * g7_19 +
+              f10 * g6_19 + f11 * g5_19;
+  output[5] = f0 * g5 + f1 * g4 + f2 * g3 + f3 * g2 + f4 * g1 + f5 * g0 +
+              f6 * g11_19 + f7 * g10_19 + f8 * g9_19 + f9 * g8_19 +
+              f10 * g7_19 + f11 * g6_19;
+  output[6] = f0 * g6 + f1 * g5 + f2 * g4 + f3 * g3 + f4 * g2 + f5 * g1 +
+              f6 * g0 + f7 * g11_19 + f8 * g10_19 + f9 * g9_19 + f10 * g8_19 +
+              f11 * g7_19;
+  output[7] = f0 * g7 + f1 * g6 + f2 * g5 + f3 * g4 + f4 * g3 + f5 * g2 +
+              f6 * g1 + f7 * g0 + f8 * g11_19 + f9 * g10_19 + f10 * g9_19 +
+              f11 * g8_19;
+  output[8] = f0 * g8 + f1 * g7 + f2 * g6 + f3 * g5 + f4 * g4 + f5 * g3 +
+              f6 * g2 + f7 * g1 + f8 * g0 + f9 * g11_19 + f10 * g10_19 +
+              f11 * g9_19;
+  output[9] = f0 * g9 + f1 * g8 + f2 * g7 + f3 * g6 + f4 * g5 + f5 * g4 +
+              f6 * g3 + f7 * g2 + f8 * g1 + f9 * g0 + f10 * g11_19 +
+              f11 * g10_19;
+  output[10] = f0 * g10 + f1 * g9 + f2 * g8 + f3 * g7 + f4 * g6 + f5 * g5 +
+               f6 * g4 + f7 * g3 + f8 * g2 + f9 * g1 + f10 * g0 + f11 * g11_19;
+  output[11] = f0 * g11 + f1 * g10 + f2 * g9 + f3 * g8 + f4 * g7 + f5 * g6 +
+               f6 * g5 + f7 * g4 + f8 * g3 + f9 * g2 + f10 * g1 + f11 * g0;
+  f4carry(output);
+}
+
+/* Square a number: output = f * f */
+static inline void force_inline flanes_target
+f4square(f4felem output, const f4felem f) {
+  const v4double s = f4splat(0x13p-255);
+  const v4double f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+  const v4double f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+  const v4double f10 = f[10], f11 = f[11];
+  const v4double f0_2 = f0 + f0, f1_2 = f1 + f1, f2_2 = f2 + f2,
+                 f3_2 = f3 + f3, f4_2 = f4 + f4, f5_2 = f5 + f5,
+                 f6_2 = f6 + f6, f7_2 = f7 + f7, f8_2 = f8 + f8,
+                 f9_2 = f9 + f9, f10_2 = f10 + f10;
+  const v4double f6_19 = f6 * s, f7_19 = f7 * s, f8_19 = f8 * s,
+                 f9_19 = f9 * s, f10_19 = f10 * s, f11_19 = f11 * s;
+
+  output[0] = f0 * f0 + f1_2 * f11_19 + f2_2 * f10_19 + f3_2 * f9_19 +
+              f4_2 * f8_19 + f5_2 * f7_19 + f6 * f6_19;
+  output[1] = f0_2 * f1 + f2_2 * f11_19 + f3_2 * f10_19 + f4_2 * f9_19 +
+              f5_2 * f8_19 + f6_2 * f7_19;
+  output[2] = f0_2 * f2 + f1 * f1 + f3_2 * f11_19 + f4_2 * f10_19 +
+              f5_2 * f9_19 + f6_2 * f8_19 + f7 * f7_19;
+  output[3] = f0_2 * f3 + f1_2 * f2 + f4_2 * f11_19 + f5_2 * f10_19 +
+              f6_2 * f9_19 + f7_2 * f8_19;
+  output[4] = f0_2 * f4 + f1_2 * f3 + f2 * f2 + f5_2 * f11_19 + f6_2 * f10_19 +
+              f7_2 * f9_19 + f8 * f8_19;
+  output[5] = f0_2 * f5 + f1_2 * f4 + f2_2 * f3 + f6_2 * f11_19 +
+              f7_2 * f10_19 + f8_2 * f9_19;
+  output[6] = f0_2 * f6 + f1_2 * f5 + f2_2 * f4 + f3 * f3 + f7_2 * f11_19 +
+              f8_2 * f10_19 + f9 * f9_19;
+  output[7] = f0_2 * f7 + f1_2 * f6 + f2_2 * f5 + f3_2 * f4 + f8_2 * f11_19 +
+              f9_2 * f10_19;
+  output[8] = f0_2 * f8 + f1_2 * f7 + f2_2 * f6 + f3_2 * f5 + f4 * f4 +
+              f9_2 * f11_19 + f10 * f10_19;
+  output[9] = f0_2 * f9 + f1_2 * f8 + f2_2 * f7 + f3_2 * f6 + f4_2 * f5 +
+              f10_2 * f11_19;
+  output[10] = f0_2 * f10 + f1_2 * f9 + f2_2 * f8 + f3_2 * f7 + f4_2 * f6 +
+               f5 * f5 + f11 * f11_19;
+  output[11] = f0_2 * f11 + f1_2 * f10 + f2_2 * f9 + f3_2 * f8 + f4_2 * f7 +
+               f5_2 * f6;
+  f4carry(output);
+}
+
+/* Multiply a number by a small scalar: output = in * scalar */
+static inline void force_inline flanes_target
+f4scalar_product(f4felem output, const f4felem in, const double scalar) {
+  const v4double s = f4splat(scalar);
+  unsigned i;
+
+  for (i = 0; i < 12; ++i) output[i] = in[i] * s;
+  f4carry(output);
+}
+
+/* Swap a and b in the lanes where mask is all ones. */
+static inline void force_inline flanes_target
+f4swap_conditional(f4felem a, f4felem b, const v4limb mask) {
+  unsigned i;
+
+  for (i = 0; i < 12; ++i) {
+    const v4limb x = mask & ((v4limb) a[i] ^ (v4limb) b[i]);
+    a[i] = (v4double) ((v4limb) a[i] ^ x);
+    b[i] = (v4double) ((v4limb) b[i] ^ x);
+  }
+}
+
+/* Returns bits start to start + len - 1 of a, which must be carried. */
+static limb
+felem_bits(const felem a, unsigned start, unsigned len) {
+  const unsigned k = start / 51, r = start % 51;
+  uint128_t w = a[k] >> r;
+
+  if (k < 4) w |= (uint128_t) a[k + 1] << (51 - r);
+  return (limb) w & (((limb) 1 << len) - 1);
+}
+
+/* Transposes q[0..3] into the limbs of out. */
+static void flanes_target
+flanes_load(f4felem out, const felem *q) {
+  unsigned i, j;
+
+  for (i = 0; i < 12; ++i) {
+    const unsigned len = flanes_shift[i + 1] - flanes_shift[i];
+    for (j = 0; j < 4; ++j) {
+      out[i][j] = (double) felem_bits(q[j], flanes_shift[i], len) *
+                  flanes_unit[i];
+    }
+  }
+  f4carry(out);
+}
+
+/* The inverse of flanes_load. The limbs are signed, so 4p is added before the
+ * carries to make the value positive. */
+static void
+flanes_store(felem *out, const f4felem in) {
+  unsigned i, j, k;
+
+  for (j = 0; j < 4; ++j) {
+    int128_t t[5] = {4 * 0x7ffffffffffed, 4 * 0x7ffffffffffff,
+                     4 * 0x7ffffffffffff, 4 * 0x7ffffffffffff,
+                     4 * 0x7ffffffffffff};
+
+    for (i = 0; i < 12; ++i) {
+      const int64_t l = (int64_t) (in[i][j] / flanes_unit[i]);
+      t[flanes_shift[i] / 51] +=
+          (int128_t) l * ((int128_t) 1 << flanes_shift[i] % 51);
+    }
+    for (k = 0; k < 4; ++k) {
+      t[k + 1] += t[k] >> 51;
+      t[k] &= 0x7ffffffffffff;
+    }
+    t[0] += 19 * (t[4] >> 51);
+    t[4] &= 0x7ffffffffffff;
+    t[1] += t[0] >> 51;
+    t[0] &= 0x7ffffffffffff;
+    for (k = 0; k < 5; ++k) out[j][k] = (limb) t[k];
+  }
+}
+
+/* Calculates n[i]·q[i] for four lanes, like cmult_lanes. */
+static void flanes_target
+cmult_flanes(felem *resultx, felem *resultz, const u8 *const *n,
+             const felem *q) {
+  f4felem x1, x2, z2, x3, z3, a, b, c, d, da, cb, aa, bb, e, t;
+  v4limb swap = {0, 0, 0, 0}, bit;
+  unsigned i;
+  int pos;
+  TELEMETRY_START;
+
+  flanes_load(x1, q);
+  for (i = 0; i < 12; ++i) {
+    const v4double zero = f4splat(0);
+    x2[i] = zero;
+    z2[i] = zero;
+    x3[i] = x1[i];
+    z3[i] = zero;
+  }
+  x2[0] += 1;
+  z3[0] += 1;
+
+  for (pos = 254; pos >= 0; --pos) {
+    for (i = 0; i < 4; ++i) bit[i] = (n[i][pos >> 3] >> (pos & 7)) & 1;
+    swap ^= bit;
+    f4swap_conditional(x2, x3, -swap);
+    f4swap_conditional(z2, z3, -swap);
+    swap = bit;
+
+    f4sum(a, x2, z2);
+    f4difference(b, x2, z2);
+    f4sum(c, x3, z3);
+    f4difference(d, x3, z3);
+    f4mul(da, d, a);
+    f4mul(cb, c, b);
+    f4sum(t, da, cb);
+    f4square(x3, t);
+    f4difference(t, da, cb);
+    f4square(t, t);
+    f4mul(z3, x1, t);
+    f4square(aa, a);
+    f4square(bb, b);
+    f4mul(x2, aa, bb);
+    f4difference(e, aa, bb);
+    f4scalar_product(t, e, 121665);
+    f4sum(t, t, aa);
+    f4mul(z2, e, t);
+  }
+  f4swap_conditional(x2, x3, -swap);
+  f4swap_conditional(z2, z3, -swap);
+
+  flanes_store(resultx, x2);
+  flanes_store(resultz, z2);
+  TELEMETRY_END(CURVE25519_PROBE_LADDER_FLANES);
+}
+
+static int
+have_flanes(void) {
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+#else
+static int
+have_lanes(void) {
+  return 0;
+}
+
+static int
+have_lanes8(void) {
+  return 0;
+}
+
+static int
+have_flanes(void) {
+  return 0;
+}
+#endif  // __x86_64__
+
+#if defined(__x86_64__)
+typedef void (*lanes_ladder)(felem *, felem *, const u8 *const *,
+                             const felem *);
+
+/* Runs ladder, which takes lanes points, over the count points at n and q in
+ * groups. A partly filled last group is run, with its first point repeated in
+ * the lanes that are left over, if at least min of its lanes are in use.
+ * Returns the number of points done. */
+static unsigned
+cmult_groups(lanes_ladder ladder, unsigned lanes, unsigned min,
+             felem *resultx, felem *resultz, const u8 *const *n,
+             const felem *q, unsigned count) {
+  const u8 *tail_n[8];
+  felem tail_q[8], tail_x[8], tail_z[8];
+  unsigned i, j;
+
+  for (i = 0; count - i >= lanes; i += lanes) {
+    ladder(resultx + i, resultz + i, n + i, q + i);
+  }
+  if (count - i < min) return i;
+
+  for (j = 0; j < lanes; ++j) {
+    const unsigned k = i + j < count ? i + j : i;
+    tail_n[j] = n[k];
+    memcpy(tail_q[j], q[k], sizeof(felem));
+  }
+  ladder(tail_x, tail_z, tail_n, tail_q);
+  memcpy(resultx + i, tail_x, (count - i) * sizeof(felem));
+  memcpy(resultz + i, tail_z, (count - i) * sizeof(felem));
+  return count;
+}
+#endif
+
+/* Defined with the Edwards code below. */
+static void cmult_windowed(felem, felem, const u8 *, const felem);
+
+static int
+backend_supported(enum curve25519_donna_backend backend) {
+  switch (backend) {
+    case CURVE25519_BACKEND_SCALAR:
+    case CURVE25519_BACKEND_EDWARDS:
+      return 1;
+    case CURVE25519_BACKEND_AVX2:
+      return have_lanes();
+    case CURVE25519_BACKEND_AVX512:
+      return have_lanes8() && have_lanes();
+    case CURVE25519_BACKEND_FLOAT:
+      return have_flanes();
+    default:
+      return 0;
+  }
+}
+
+/* Returns the fewest ticks of ticks_now, over three runs, that the ladders
+ * of backend take for eight scalar multiplications. */
+static uint64_t
+time_backend(enum curve25519_donna_backend backend) {
+  static const u8 scalar[32] = {0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55, 0xaa, 0x55};
+  const u8 *n[8];
+  felem q[8], x[8], z[8];
+  uint64_t best = UINT64_MAX, start, ticks;
+  unsigned i, run;
+
+  for (i = 0; i < 8; ++i) {
+    n[i] = scalar;
+    memset(q[i], 0, sizeof(felem));
+    q[i][0] = 9;
+  }
+  for (run = 0; run < 3; ++run) {
+    start = ticks_now();
+    switch (backend) {
+#if defined(__x86_64__)
+      case CURVE25519_BACKEND_AVX512:
+        cmult_lanes8(x, z, n, q);
+        break;
+      case CURVE25519_BACKEND_AVX2:
+        cmult_lanes(x, z, n, q);
+        cmult_lanes(x + 4, z + 4, n + 4, q + 4);
+        break;
+      case CURVE25519_BACKEND_FLOAT:
+        cmult_flanes(x, z, n, q);
+        cmult_flanes(x + 4, z + 4, n + 4, q + 4);
+        break;
+#endif
+      case CURVE25519_BACKEND_EDWARDS:
+        for (i = 0; i < 8; ++i) cmult_windowed(x[i], z[i], n[i], q[i]);
+        break;
+      default:
+        for (i = 0; i < 8; i += 2) cmult_x2(x + i, z + i, n + i, q + i);
+        break;
+    }
+    ticks = ticks_now() - start;
+    if (ticks < best) best = ticks;
+  }
+  return best;
+}
+
+/* Returns the ladder backend that does the most scalar multiplications per
+ * second here, timing each that the CPU supports. The Edwards backend is only
+ * used when it is set. */
+static enum curve25519_donna_backend
+fastest_backend(void) {
+  enum curve25519_donna_backend best = CURVE25519_BACKEND_SCALAR, b;
+  uint64_t best_ticks = UINT64_MAX, ticks;
+
+  for (b = CURVE25519_BACKEND_SCALAR; b < CURVE25519_BACKEND_EDWARDS; ++b) {
+    if (!backend_supported(b)) continue;
+    ticks = time_backend(b);
+    if (ticks < best_ticks) {
+      best = b;
+      best_ticks = ticks;
+    }
+  }
+  return best;
+}
+
+/* The backend in use, or CURVE25519_BACKEND_AUTO until it is first needed.
+ * Threads that race to resolve it just time the backends more than once. */
+static int backend_in_use;
+
+int curve25519_donna_set_backend(enum curve25519_donna_backend);
+
+int
+curve25519_donna_set_backend(enum curve25519_donna_backend backend) {
+  if (backend != CURVE25519_BACKEND_AUTO && !backend_supported(backend)) {
+    return -1;
+  }
+  __atomic_store_n(&backend_in_use, backend, __ATOMIC_RELAXED);
+  return 0;
+}
+
+enum curve25519_donna_backend curve25519_donna_get_backend(void);
+
+enum curve25519_donna_backend
+curve25519_donna_get_backend(void) {
+  enum curve25519_donna_backend backend =
+      __atomic_load_n(&backend_in_use, __ATOMIC_RELAXED);
+
+  if (backend == CURVE25519_BACKEND_AUTO) {
+    backend = fastest_backend();
+    __atomic_store_n(&backend_in_use, backend, __ATOMIC_RELAXED);
+  }
+  return backend;
+}
+
+/* Calculates n[i]·q[i] for count points with the backend in use, finishing
+ * with the two-way and single ladders or, on the Edwards backend, with
+ * windowed multiplications. The scalars must have bit 255 clear. */
+static void
+cmult_many(felem *resultx, felem *resultz, const u8 *const *n, const felem *q,
+           unsigned count) {
+  unsigned i = 0;
+
+#if defined(__x86_64__)
+  switch (curve25519_donna_get_backend()) {
+    case CURVE25519_BACKEND_AVX512:
+      i = cmult_groups(cmult_lanes8, 8, CURVE25519_LANES8_MIN, resultx, resultz,
+                       n, q, count);
+      /* fall through */
+    case CURVE25519_BACKEND_AVX2:
+      i += cmult_groups(cmult_lanes, 4, CURVE25519_LANES_MIN, resultx + i,
+                        resultz + i, n + i, q + i, count - i);
+      break;
+    case CURVE25519_BACKEND_FLOAT:
+      i = cmult_groups(cmult_flanes, 4, CURVE25519_LANES_MIN, resultx, resultz,
+                       n, q, count);
+      break;
+    default:
+      break;
+  }
+#endif
+  if (curve25519_donna_get_backend() == CURVE25519_BACKEND_EDWARDS) {
+    for (; i < count; ++i) cmult_windowed(resultx[i], resultz[i], n[i], q[i]);
+  }
+
+  for (; count - i >= 2; i += 2) {
+    cmult_x2(resultx + i, resultz + i, n + i, q + i);
+  }
+  for (; i < count; ++i) cmult(resultx[i], resultz[i], n[i], q[i]);
+}
+
+int curve25519_donna(u8 *, const u8 *, const u8 *);
+
+int
+curve25519_donna(u8 *mypublic, const u8 *secret, const u8 *basepoint) {
+  limb bp[5], x[5], z[5], zmone[5];
+  uint8_t e[32];
+  int i;
+  TELEMETRY_START;
+
+  for (i = 0;i < 32;++i) e[i] = secret[i];
+  e[0] &= 248;
+  e[31] &= 127;
+  e[31] |= 64;
+
+  fexpand(bp, basepoint);
+  /* Not curve25519_donna_get_backend, which would time the backends on the
+   * first call: a single multiplication runs the ladder unless the Edwards
+   * backend was set. */
+  if (__atomic_load_n(&backend_in_use, __ATOMIC_RELAXED) ==
+      CURVE25519_BACKEND_EDWARDS) {
+    cmult_windowed(x, z, e, bp);
+  } else {
+    cmult(x, z, e, bp);
+  }
+  crecip(zmone, z);
+  fmul(z, x, zmone);
+  fcontract(mypublic, z);
+  TELEMETRY_END(CURVE25519_PROBE_DONNA);
+  return 0;
+}
+
+int curve25519_donna_x2(u8 *, const u8 *, const u8 *);
+
+/* Computes two independent scalar multiplications:
+ *
+ *   mypublic[i] = curve25519_donna(secret[i], basepoint[i])
+ *
+ * where each argument is an array of two 32-byte values, with the two ladders
+ * interleaved by cmult_x2 and one inversion shared between them. mypublic may
+ * alias secret.
+ */
+int
+curve25519_donna_x2(u8 *mypublic, const u8 *secret, const u8 *basepoint) {
+  felem bp[2], x[2], z[2], scratch[2], t;
+  uint8_t e[2][32];
+  const u8 *ep[2] = {e[0], e[1]};
+  unsigned i, j;
+  TELEMETRY_START;
+
+  for (i = 0; i < 2; ++i) {
+    for (j = 0; j < 32; ++j) e[i][j] = secret[32 * i + j];
+    e[i][0] &= 248;
+    e[i][31] &= 127;
+    e[i][31] |= 64;
+    fexpand(bp[i], basepoint + 32 * i);
+  }
+
+  cmult_x2(x, z, ep, bp);
+  crecip_batch(z, z, scratch, 2);
+  for (i = 0; i < 2; ++i) {
+    fmul(t, x[i], z[i]);
+    fcontract(mypublic + 32 * i, t);
+  }
+  TELEMETRY_END(CURVE25519_PROBE_X2);
+  return 0;
+}
+
+int curve25519_donna_batch(u8 *, const u8 *, const u8 *, size_t);
+
+/* Computes n independent scalar multiplications:
+ *
+ *   mypublic[i] = curve25519_donna(secret[i], basepoint[i])
+ *
+ * where each argument is an array of n 32-byte values. If basepoint is NULL
+ * the standard base point (9) is used for every element, which makes this a
+ * batch key generation function. The ladders run on the backend of
+ * curve25519_donna_get_backend and the final inversions are shared between up to
+ * CURVE25519_BATCH elements at a time. mypublic may alias secret.
+ */
+int
+curve25519_donna_batch(u8 *mypublic, const u8 *secret, const u8 *basepoint,
+                       size_t n) {
+  static const u8 nine[32] = {9};
+  felem bp[CURVE25519_BATCH], x[CURVE25519_BATCH], z[CURVE25519_BATCH],
+        scratch[CURVE25519_BATCH], t;
+  uint8_t e[CURVE25519_BATCH][32];
+  const u8 *ep[CURVE25519_BATCH];
+  size_t done;
+  unsigned i, j, chunk;
+  TELEMETRY_START;
+
+  for (done = 0; done < n; done += chunk) {
+    chunk = n - done < CURVE25519_BATCH ? n - done : CURVE25519_BATCH;
+
+    for (i = 0; i < chunk; ++i) {
+      for (j = 0; j < 32; ++j) e[i][j] = secret[32 * (done + i) + j];
+      e[i][0] &= 248;
+      e[i][31] &= 127;
+      e[i][31] |= 64;
+      ep[i] = e[i];
+
+      fexpand(bp[i], basepoint ? basepoint + 32 * (done + i) : nine);
+    }
+
+    cmult_many(x, z, ep, bp, chunk);
+    crecip_batch(z, z, scratch, chunk);
+
+    for (i = 0; i < chunk; ++i) {
+      fmul(t, x[i], z[i]);
+      fcontract(mypublic + 32 * (done + i), t);
+    }
+  }
+  TELEMETRY_END(CURVE25519_PROBE_BATCH);
+  return 0;
+}
+
+int curve25519_donna_fanout(u8 *, const u8 *, const u8 *, size_t);
+
+/* Computes the shared keys between one secret and n peers:
+ *
+ *   shared[i] = curve25519_donna(secret, peers[i])
+ *
+ * where shared and peers are arrays of n 32-byte values. The secret is clamped
+ * once and, since every ladder then takes the same sequence of swaps, the
+ * peers are packed into the lanes of the backend in use. The final
+ * inversions are shared between up to CURVE25519_BATCH peers at a time.
+ * shared may alias peers.
+ */
+int
+curve25519_donna_fanout(u8 *shared, const u8 *secret, const u8 *peers,
+                        size_t n) {
+  felem bp[CURVE25519_BATCH], x[CURVE25519_BATCH], z[CURVE25519_BATCH],
+        scratch[CURVE25519_BATCH], t;
+  uint8_t e[32];
+  const u8 *ep[CURVE25519_BATCH];
+  size_t done;
+  unsigned i, chunk;
+  TELEMETRY_START;
+
+  for (i = 0; i < 32; ++i) e[i] = secret[i];
+  e[0] &= 248;
+  e[31] &= 127;
+  e[31] |= 64;
+  for (i = 0; i < CURVE25519_BATCH; ++i) ep[i] = e;
+
+  for (done = 0; done < n; done += chunk) {
+    chunk = n - done < CURVE25519_BATCH ? n - done : CURVE25519_BATCH;
+
+    for (i = 0; i < chunk; ++i) fexpand(bp[i], peers + 32 * (done + i));
+    cmult_many(x, z, ep, bp, chunk);
+    crecip_batch(z, z, scratch, chunk);
+
+    for (i = 0; i < chunk; ++i) {
+      fmul(t, x[i], z[i]);
+      fcontract(shared + 32 * (done + i), t);
+    }
+  }
+  TELEMETRY_END(CURVE25519_PROBE_FANOUT);
+  return 0;
+}
+
+/* Sets out[i] to n[i]·q[i] for count <= CURVE25519_BATCH points, with one
+ * shared inversion. */
+static void
+cmult_to(u8 *const *out, const u8 *const *n, const felem *q, unsigned count) {
+  felem x[CURVE25519_BATCH], z[CURVE25519_BATCH], scratch[CURVE25519_BATCH], t;
+  unsigned i;
+
+  cmult_many(x, z, n, q, count);
+  crecip_batch(z, z, scratch, count);
+  for (i = 0; i < count; ++i) {
+    fmul(t, x[i], z[i]);
+    fcontract(out[i], t);
+  }
+}
+
+int curve25519_donna_handshakes(struct curve25519_donna_handshake *, size_t);
+
+/* Computes the Diffie-Hellman operations of n handshake messages:
+ *
+ *   h[i].shared[k] = curve25519_donna(h[i].secret[k], h[i].peer[k])
+ *
+ * for k < h[i].count. The operations of all the messages are queued in order
+ * and run CURVE25519_BATCH at a time through cmult_to, so
+ * a message's operations may share a block with those of its neighbours and a
+ * block may end part way through a message. Messages are checked for shared
+ * keys of all zeros once every block has run.
+ */
+int
+curve25519_donna_handshakes(struct curve25519_donna_handshake *h, size_t n) {
+  felem bp[CURVE25519_BATCH];
+  uint8_t e[CURVE25519_BATCH][32];
+  const u8 *ep[CURVE25519_BATCH];
+  u8 *out[CURVE25519_BATCH];
+  size_t i;
+  unsigned j, k, chunk = 0, zero;
+  int ret = 0;
+  TELEMETRY_START;
+
+  for (i = 0; i < n; ++i) {
+    if (h[i].count > CURVE25519_DONNA_HANDSHAKE_DH) continue;
+    for (k = 0; k < h[i].count; ++k) {
+      for (j = 0; j < 32; ++j) e[chunk][j] = h[i].secret[k][j];
+      e[chunk][0] &= 248;
+      e[chunk][31] &= 127;
+      e[chunk][31] |= 64;
+      ep[chunk] = e[chunk];
+      fexpand(bp[chunk], h[i].peer[k]);
+      out[chunk] = h[i].shared[k];
+      if (++chunk == CURVE25519_BATCH) {
+        cmult_to(out, ep, bp, chunk);
+        chunk = 0;
+      }
+    }
+  }
+  if (chunk) cmult_to(out, ep, bp, chunk);
+  donna_memset(e, 0, sizeof(e));
+
+  for (i = 0; i < n; ++i) {
+    h[i].result = 0;
+    if (h[i].count > CURVE25519_DONNA_HANDSHAKE_DH) {
+      memset(h[i].shared, 0, sizeof(h[i].shared));
+      h[i].result = -1;
+      ret = -1;
+      continue;
+    }
+    zero = 0;
+    for (k = 0; k < h[i].count; ++k) {
+      unsigned acc = 0;
+      for (j = 0; j < 32; ++j) acc |= h[i].shared[k][j];
+      zero |= (acc - 1) >> 8;
+    }
+    if (zero & 1) {
+      memset(h[i].shared, 0, sizeof(h[i].shared));
+      h[i].result = -1;
+      ret = -1;
+    }
+  }
+  TELEMETRY_END(CURVE25519_PROBE_HANDSHAKES);
+  return ret;
+}
+
+// -----------------------------------------------------------------------------
+// A ladder run a few steps at a time.
+//
+// The state between calls is the state of cmult, kept in a caller-owned
+// struct. Bit 255 of a clamped scalar is zero, and a ladder step on that bit
+// leaves the point at infinity where it is, so the first step is skipped.
+// -----------------------------------------------------------------------------
+
+void curve25519_donna_ladder_init(struct curve25519_donna_ladder *,
+                                  const u8 *, const u8 *);
+
+void
+curve25519_donna_ladder_init(struct curve25519_donna_ladder *l,
+                             const u8 *secret, const u8 *basepoint) {
+  unsigned i;
+
+  for (i = 0; i < 32; ++i) l->e[i] = secret[i];
+  l->e[0] &= 248;
+  l->e[31] &= 127;
+  l->e[31] |= 64;
+
+  fexpand(l->q, basepoint);
+  memset(l->x, 0, sizeof(l->x));
+  memset(l->z, 0, sizeof(l->z));
+  memset(l->zp, 0, sizeof(l->zp));
+  memcpy(l->xp, l->q, sizeof(l->xp));
+  l->x[0] = 1;
+  l->zp[0] = 1;
+  l->remaining = CURVE25519_DONNA_LADDER_STEPS;
+}
+
+unsigned curve25519_donna_ladder_step(struct curve25519_donna_ladder *,
+                                      unsigned);
+
+unsigned
+curve25519_donna_ladder_step(struct curve25519_donna_ladder *l,
+                             unsigned steps) {
+  if (steps > l->remaining) steps = l->remaining;
+  ladder_steps(l->x, l->z, l->xp, l->zp, l->e, l->remaining, steps, l->q);
+  l->remaining -= steps;
+  return l->remaining;
+}
+
+int curve25519_donna_ladder_finish(struct curve25519_donna_ladder *, u8 *);
+
+int
+curve25519_donna_ladder_finish(struct curve25519_donna_ladder *l,
+                               u8 *mypublic) {
+  felem zinv, t;
+
+  curve25519_donna_ladder_step(l, l->remaining);
+  crecip(zinv, l->z);
+  fmul(t, l->x, zinv);
+  fcontract(mypublic, t);
+  donna_memset(l, 0, sizeof(*l));
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Ed25519 signature verification.
+//
+// Points of the twisted Edwards curve -x^2 + y^2 = 1 + d·x^2·y^2 are kept in
+// the extended coordinates of Hisil, Wong, Carter and Dawson: (X:Y:Z:T) with
+// x = X/Z, y = Y/Z and x·y = T/Z. The formulas follow djb's ref10. Everything
+// below works on public values only and so runs in variable time.
+//
+// Signatures are checked with the cofactored equation [8][S]B = [8]R + [8][k]A,
+// which RFC 8032 permits. The random linear combination that the batch
+// verifier checks can only agree with the cofactorless equation when R and A
+// have no small order component, so using the cofactored equation in both
+// verifiers makes them accept exactly the same signatures.
+// -----------------------------------------------------------------------------
+
+/* The number of signatures whose equations are combined into one multi-scalar
+ * multiplication. */
+#define ED25519_BATCH 64
+
+/* The window sizes, in bits, between which the multi-scalar multiplication
+ * chooses. */
+#define ED25519_WINDOW_MIN 4
+#define ED25519_WINDOW_MAX 8
+
+typedef struct { felem X, Y, Z, T; } ge_p3;
+typedef struct { felem X, Y, Z; } ge_p2;
+/* A completed point ((X:Z), (Y:T)), the output of an addition or a doubling. */
+typedef struct { felem X, Y, Z, T; } ge_p1p1;
+/* A point prepared for being added to others. */
+typedef struct { felem YplusX, YminusX, Z, T2d; } ge_cached;
+/* An affine ge_cached with Z = 1. */
+typedef struct { felem yplusx, yminusx, xy2d; } ge_precomp;
+
+static const felem fe_d = {
+  0x34dca135978a3, 0x1a8283b156ebd, 0x5e7a26001c029, 0x739c663a03cbb,
+  0x52036cee2b6ff
+};
+static const felem fe_d2 = {
+  0x69b9426b2f159, 0x35050762add7a, 0x3cf44c0038052, 0x6738cc7407977,
+  0x2406d9dc56dff
+};
+static const felem fe_sqrtm1 = {
+  0x61b274a0ea0b0, 0xd5a5fc8f189d, 0x7ef5e9cbd0c60, 0x78595a6804c9e,
+  0x2b8324804fc1d
+};
+
+/* B, 3B, 5B, ..., 15B. */
+static const ge_precomp ge_base_odd[8] = {
+  {{0x493c6f58c3b85, 0xdf7181c325f7, 0xf50b0b3e4cb7, 0x5329385a44c32, 0x7cf9d3a33d4b},
+   {0x3905d740913e, 0xba2817d673a2, 0x23e2827f4e67c, 0x133d2e0c21a34, 0x44fd2f9298f81},
+   {0x11205877aaa68, 0x479955893d579, 0x50d66309b67a0, 0x2d42d0dbee5ee, 0x6f117b689f0c6}},
+  {{0x5b0a84cee9730, 0x61d10c97155e4, 0x4059cc8096a10, 0x47a608da8014f, 0x7a164e1b9a80f},
+   {0x11fe8a4fcd265, 0x7bcb8374faacc, 0x52f5af4ef4d4f, 0x5314098f98d10, 0x2ab91587555bd},
+   {0x6933f0dd0d889, 0x44386bb4c4295, 0x3cb6d3162508c, 0x26368b872a2c6, 0x5a2826af12b9b}},
+  {{0x2bc4408a5bb33, 0x78ebdda05442, 0x2ffb112354123, 0x375ee8df5862d, 0x2945ccf146e20},
+   {0x182c3a447d6ba, 0x22964e536eff2, 0x192821f540053, 0x2f9f19e788e5c, 0x154a7e73eb1b5},
+   {0x3dbf1812a8285, 0xfa17ba3f9797, 0x6f69cb49c3820, 0x34d5a0db3858d, 0x43aabe696b3bb}},
+  {{0x25cd0944ea3bf, 0x75673b81a4d63, 0x150b925d1c0d4, 0x13f38d9294114, 0x461bea69283c9},
+   {0x72c9aaa3221b1, 0x267774474f74d, 0x64b0e9b28085, 0x3f04ef53b27c9, 0x1d6edd5d2e531},
+   {0x36dc801b8b3a2, 0xe0a7d4935e30, 0x1deb7cecc0d7d, 0x53a94e20dd2c, 0x7a9fbb1c6a0f9}},
+  {{0x6678aa6a8632f, 0x5ea3788d8b365, 0x21bd6d6994279, 0x7ace75919e4e3, 0x34b9ed338add7},
+   {0x6217e039d8064, 0x6dea408337e6d, 0x57ac112628206, 0x647cb65e30473, 0x49c05a51fadc9},
+   {0x4e8bf9045af1b, 0x514e33a45e0d6, 0x7533c5b8bfe0f, 0x583557b7e14c9, 0x73c172021b008}},
+  {{0x700848a802ade, 0x1e04605c4e5f7, 0x5c0d01b9767fb, 0x7d7889f42388b, 0x4275aae2546d8},
+   {0x75b0249864348, 0x52ee11070262b, 0x237ae54fb5acd, 0x3bfd1d03aaab5, 0x18ab598029d5c},
+   {0x32cc5fd6089e9, 0x426505c949b05, 0x46a18880c7ad2, 0x4a4221888ccda, 0x3dc65522b53df}},
+  {{0xc222a2007f6d, 0x356b79bdb77ee, 0x41ee81efe12ce, 0x120a9bd07097d, 0x234fd7eec346f},
+   {0x7013b327fbf93, 0x1336eeded6a0d, 0x2b565a2bbf3af, 0x253ce89591955, 0x267882d17602},
+   {0xa119732ea378, 0x63bf1ba8e2a6c, 0x69f94cc90df9a, 0x431d1779bfc48, 0x497ba6fdaa097}},
+  {{0x6cc0313cfeaa0, 0x1a313848da499, 0x7cb534219230a, 0x39596dedefd60, 0x61e22917f12de},
+   {0x3cd86468ccf0b, 0x48553221ac081, 0x6c9464b4e0a6e, 0x75fba84180403, 0x43b5cd4218d05},
+   {0x2762f9bd0b516, 0x1c6e7fbddcbb3, 0x75909c3ace2bd, 0x42101972d3ec9, 0x511d61210ae4d}},
+};
+
+/* Carry the limbs of f down to 51 bits (plus a little in f[0]). */
+static void
+fcarry(felem f) {
+  limb c;
+
+  c = f[0] >> 51; f[0] &= 0x7ffffffffffff; f[1] += c;
+  c = f[1] >> 51; f[1] &= 0x7ffffffffffff; f[2] += c;
+  c = f[2] >> 51; f[2] &= 0x7ffffffffffff; f[3] += c;
+  c = f[3] >> 51; f[3] &= 0x7ffffffffffff; f[4] += c;
+  c = f[4] >> 51; f[4] &= 0x7ffffffffffff; f[0] += 19 * c;
+}
+
+/* output = -in, carried. in must be carried. */
+static void
+fneg(felem output, const felem in) {
+  static const felem zero = {0};
+
+  fsub(output, zero, in);
+  fcarry(output);
+}
+
+/* Returns the low bit of the fully reduced form of in: the "sign" of RFC 8032. */
+static int
+fisnegative(const felem in) {
+  u8 bytes[32];
+
+  fcontract(bytes, in);
+  return bytes[0] & 1;
+}
+
+/* Raise z to the 2^252 - 3 power, i.e. (p-5)/8, for square roots. */
+static void
+fpow22523(felem out, const felem z) {
+  felem a, t0, b, c;
+
+  /* 2 */ fsquare_times(a, z, 1); // a = 2
+  /* 8 */ fsquare_times(t0, a, 2);
+  /* 9 */ fmul(b, t0, z); // b = 9
+  /* 11 */ fmul(a, b, a); // a = 11
+  /* 22 */ fsquare_times(t0, a, 1);
+  /* 2^5 - 2^0 = 31 */ fmul(b, t0, b);
+  /* 2^10 - 2^5 */ fsquare_times(t0, b, 5);
+  /* 2^10 - 2^0 */ fmul(b, t0, b);
+  /* 2^20 - 2^10 */ fsquare_times(t0, b, 10);
+  /* 2^20 - 2^0 */ fmul(c, t0, b);
+  /* 2^40 - 2^20 */ fsquare_times(t0, c, 20);
+  /* 2^40 - 2^0 */ fmul(t0, t0, c);
+  /* 2^50 - 2^10 */ fsquare_times(t0, t0, 10);
+  /* 2^50 - 2^0 */ fmul(b, t0, b);
+  /* 2^100 - 2^50 */ fsquare_times(t0, b, 50);
+  /* 2^100 - 2^0 */ fmul(c, t0, b);
+  /* 2^200 - 2^100 */ fsquare_times(t0, c, 100);
+  /* 2^200 - 2^0 */ fmul(t0, t0, c);
+  /* 2^250 - 2^50 */ fsquare_times(t0, t0, 50);
+  /* 2^250 - 2^0 */ fmul(t0, t0, b);
+  /* 2^252 - 2^2 */ fsquare_times(t0, t0, 2);
+  /* 2^252 - 3 */ fmul(out, t0, z);
+}
+
+static void
+ge_p3_0(ge_p3 *h) {
+  memset(h, 0, sizeof(*h));
+  h->Y[0] = 1;
+  h->Z[0] = 1;
+}
+
+static void
+ge_p3_to_p2(ge_p2 *r, const ge_p3 *p) {
+  memcpy(r->X, p->X, sizeof(felem));
+  memcpy(r->Y, p->Y, sizeof(felem));
+  memcpy(r->Z, p->Z, sizeof(felem));
+}
+
+static void
+ge_p3_to_cached(ge_cached *r, const ge_p3 *p) {
+  fadd(r->YplusX, p->Y, p->X);
+  fsub(r->YminusX, p->Y, p->X);
+  memcpy(r->Z, p->Z, sizeof(felem));
+  fmul(r->T2d, p->T, fe_d2);
+}
+
+static void
+ge_p1p1_to_p2(ge_p2 *r, const ge_p1p1 *p) {
+  fmul(r->X, p->X, p->T);
+  fmul(r->Y, p->Y, p->Z);
+  fmul(r->Z, p->Z, p->T);
+}
+
+static void
+ge_p1p1_to_p3(ge_p3 *r, const ge_p1p1 *p) {
+  fmul(r->X, p->X, p->T);
+  fmul(r->Y, p->Y, p->Z);
+  fmul(r->Z, p->Z, p->T);
+  fmul(r->T, p->X, p->Y);
+}
+
+/* r = 2p, with the signs of the intermediate values of dbl-2008-hwcd flipped
+ * so that fsub only ever subtracts carried values. */
+static void
+ge_p2_dbl(ge_p1p1 *r, const ge_p2 *p) {
+  felem a, b, c, t;
+
+  fsquare_times(a, p->X, 1);
+  fsquare_times(b, p->Y, 1);
+  fsquare_times(c, p->Z, 1);
+  fadd(c, c, c);
+  fadd(t, p->X, p->Y);
+  fsquare_times(t, t, 1);
+
+  fadd(r->Y, a, b);           /* -H = A + B */
+  fsub(r->X, r->Y, t);        /* -E = A + B - (X + Y)^2 */
+  fsub(r->Z, a, b);           /* -G = A - B */
+  fadd(t, a, c);
+  fsub(r->T, t, b);           /* -F = A + C - B */
+}
+
+/* r = p + q */
+static void
+ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q) {
+  felem a, b, c, d, t;
+
+  fsub(t, p->Y, p->X);
+  fmul(a, t, q->YminusX);
+  fadd(t, p->Y, p->X);
+  fmul(b, t, q->YplusX);
+  fmul(c, p->T, q->T2d);
+  fmul(d, p->Z, q->Z);
+  fadd(d, d, d);
+
+  fsub(r->X, b, a);
+  fadd(r->Y, b, a);
+  fadd(r->Z, d, c);
+  fsub(r->T, d, c);
+}
+
+/* r = p - q */
+static void
+ge_sub(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q) {
+  felem a, b, c, d, t;
+
+  fsub(t, p->Y, p->X);
+  fmul(a, t, q->YplusX);
+  fadd(t, p->Y, p->X);
+  fmul(b, t, q->YminusX);
+  fmul(c, p->T, q->T2d);
+  fmul(d, p->Z, q->Z);
+  fadd(d, d, d);
+
+  fsub(r->X, b, a);
+  fadd(r->Y, b, a);
+  fsub(r->Z, d, c);
+  fadd(r->T, d, c);
+}
+
+/* r = p + q for an affine q */
+static void
+ge_madd(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q) {
+  felem a, b, c, d, t;
+
+  fsub(t, p->Y, p->X);
+  fmul(a, t, q->yminusx);
+  fadd(t, p->Y, p->X);
+  fmul(b, t, q->yplusx);
+  fmul(c, p->T, q->xy2d);
+  fadd(d, p->Z, p->Z);
+
+  fsub(r->X, b, a);
+  fadd(r->Y, b, a);
+  fadd(r->Z, d, c);
+  fsub(r->T, d, c);
+}
+
+/* r = p - q for an affine q */
+static void
+ge_msub(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q) {
+  felem a, b, c, d, t;
+
+  fsub(t, p->Y, p->X);
+  fmul(a, t, q->yplusx);
+  fadd(t, p->Y, p->X);
+  fmul(b, t, q->yminusx);
+  fmul(c, p->T, q->xy2d);
+  fadd(d, p->Z, p->Z);
+
+  fsub(r->X, b, a);
+  fadd(r->Y, b, a);
+  fsub(r->Z, d, c);
+  fadd(r->T, d, c);
+}
+
+/* Returns 1 if the low 255 bits of s, little endian, are less than p. */
+static int
+fcanonical(const u8 *s) {
+  unsigned i;
+
+  if ((s[31] & 0x7f) != 0x7f) return 1;
+  for (i = 30; i > 0; --i) {
+    if (s[i] != 0xff) return 1;
+  }
+  return s[0] < 0xed;
+}
+
+/* Decodes a point as described in RFC 8032, section 5.1.3. Returns 0 on
+ * success or -1 if s is not the encoding of a point. */
+static int
+ge_frombytes(ge_p3 *h, const u8 *s) {
+  static const felem one = {1};
+  felem u, v, v3, vxx, t;
+
+  if (!fcanonical(s)) return -1;
+
+  fexpand(h->Y, s);
+  memcpy(h->Z, one, sizeof(felem));
+  fsquare_times(u, h->Y, 1);
+  fmul(v, u, fe_d);
+  fsub(u, u, one);
+  fcarry(u);                      /* u = y^2 - 1 */
+  fadd(v, v, one);                /* v = d·y^2 + 1 */
+
+  /* x = u·v^3·(u·v^7)^((p-5)/8) */
+  fsquare_times(v3, v, 1);
+  fmul(v3, v3, v);
+  fsquare_times(h->X, v3, 1);
+  fmul(h->X, h->X, v);
+  fmul(h->X, h->X, u);
+  fpow22523(h->X, h->X);
+  fmul(h->X, h->X, v3);
+  fmul(h->X, h->X, u);
+
+  fsquare_times(vxx, h->X, 1);
+  fmul(vxx, vxx, v);
+  fsub(t, vxx, u);
+  if (!fiszero(t)) {
+    fadd(t, vxx, u);
+    if (!fiszero(t)) return -1;
+    fmul(h->X, h->X, fe_sqrtm1);
+  }
+
+  if (fisnegative(h->X) != (s[31] >> 7)) {
+    if (fiszero(h->X)) return -1;
+    fneg(h->X, h->X);
+  }
+
+  fmul(h->T, h->X, h->Y);
+  return 0;
+}
+
+/* Returns 1 if [8]p is the neutral element. */
+static int
+ge_cofactor_is_neutral(const ge_p3 *p) {
+  ge_p1p1 t;
+  ge_p2 q;
+  felem d;
+
+  ge_p3_to_p2(&q, p);
+  ge_p2_dbl(&t, &q);
+  ge_p1p1_to_p2(&q, &t);
+  ge_p2_dbl(&t, &q);
+  ge_p1p1_to_p2(&q, &t);
+  ge_p2_dbl(&t, &q);
+  ge_p1p1_to_p2(&q, &t);
+
+  fsub(d, q.Y, q.Z);
+  return fiszero(q.X) && fiszero(d);
+}
+
+/* Scalars modulo the group order L = 2^252 + 27742317777372353535851937790883648493
+ * are kept as four 64-bit little-endian words. */
+static const uint64_t sc_order[4] = {
+  0x5812631a5cf5d3ed, 0x14def9dea2f79cd6, 0, 0x1000000000000000
+};
+
+/* out (na + nb words) = a · b */
+static void
+mp_mul(uint64_t *out, const uint64_t *a, unsigned na, const uint64_t *b,
+       unsigned nb) {
+  unsigned i, j;
+
+  memset(out, 0, (na + nb) * sizeof(uint64_t));
+  for (i = 0; i < na; ++i) {
+    uint128_t t = 0;
+    for (j = 0; j < nb; ++j) {
+      t += ((uint128_t) a[i]) * b[j] + out[i + j];
+      out[i + j] = (uint64_t) t;
+      t >>= 64;
+    }
+    out[i + nb] = (uint64_t) t;
+  }
+}
+
+/* Returns 1 if the n-word a (n >= 4) is at least L. */
+static int
+sc_geq_order(const uint64_t *a, unsigned n) {
+  int i;
+
+  while (n > 4) {
+    if (a[--n]) return 1;
+  }
+  for (i = 3; i >= 0; --i) {
+    if (a[i] != sc_order[i]) return a[i] > sc_order[i];
+  }
+  return 1;
+}
+
+/* Returns 1 if the 32-byte little-endian s is less than L. */
+static int
+sc_canonical(const u8 *s) {
+  uint64_t a[4];
+  unsigned i;
+
+  for (i = 0; i < 4; ++i) a[i] = load_limb(s + 8 * i);
+  return !sc_geq_order(a, 4);
+}
+
+/* out = in mod L for a 512-bit in, by Barrett reduction (HAC 14.42) with
+ * mu = floor(2^512 / L). */
+static void
+sc_reduce(uint64_t out[4], const uint64_t in[8]) {
+  static const uint64_t mu[5] = {
+    0xed9ce5a30a2c131b, 0x2106215d086329a7, 0xffffffffffffffeb,
+    0xffffffffffffffff, 0xf
+  };
+  uint64_t q[10], ql[9], r[5];
+  uint128_t borrow = 0;
+  unsigned i;
+
+  /* q = floor(floor(in / 2^192) · mu / 2^320), which is floor(in / L) or at
+   * most two less. */
+  mp_mul(q, in + 3, 5, mu, 5);
+  mp_mul(ql, q + 5, 5, sc_order, 4);
+
+  /* r = in - q·L mod 2^320 */
+  for (i = 0; i < 5; ++i) {
+    const uint128_t t = ((uint128_t) in[i]) - ql[i] - borrow;
+    r[i] = (uint64_t) t;
+    borrow = (t >> 64) & 1;
+  }
+
+  while (sc_geq_order(r, 5)) {
+    borrow = 0;
+    for (i = 0; i < 5; ++i) {
+      const uint128_t t =
+          ((uint128_t) r[i]) - (i < 4 ? sc_order[i] : 0) - borrow;
+      r[i] = (uint64_t) t;
+      borrow = (t >> 64) & 1;
+    }
+  }
+
+  memcpy(out, r, 4 * sizeof(uint64_t));
+}
+
+/* out = a · b mod L */
+static void
+sc_mul(uint64_t out[4], const uint64_t a[4], const uint64_t b[4]) {
+  uint64_t t[8];
+
+  mp_mul(t, a, 4, b, 4);
+  sc_reduce(out, t);
+}
+
+/* out = a + b mod L, for a and b less than L */
+static void
+sc_add(uint64_t out[4], const uint64_t a[4], const uint64_t b[4]) {
+  uint64_t t[8] = {0};
+  uint128_t carry = 0;
+  unsigned i;
+
+  for (i = 0; i < 4; ++i) {
+    carry += ((uint128_t) a[i]) + b[i];
+    t[i] = (uint64_t) carry;
+    carry >>= 64;
+  }
+  t[4] = (uint64_t) carry;
+  sc_reduce(out, t);
+}
+
+static void
+sc_store(u8 *out, const uint64_t a[4]) {
+  unsigned i;
+
+  for (i = 0; i < 4; ++i) store_limb(out + 8 * i, a[i]);
+}
+
+/* Recodes a into 256 signed digits, each zero or odd and in [-15, 15], such
+ * that a = sum(r[i]·2^i) and any two non-zero digits are at least five places
+ * apart. */
+static void
+slide(signed char *r, const u8 *a) {
+  int i, b, k;
+
+  for (i = 0; i < 256; ++i) r[i] = 1 & (a[i >> 3] >> (i & 7));
+
+  for (i = 0; i < 256; ++i) {
+    if (!r[i]) continue;
+    for (b = 1; b <= 6 && i + b < 256; ++b) {
+      if (!r[i + b]) continue;
+      if (r[i] + (r[i + b] << b) <= 15) {
+        r[i] += r[i + b] << b;
+        r[i + b] = 0;
+      } else if (r[i] - (r[i + b] << b) >= -15) {
+        r[i] -= r[i + b] << b;
+        for (k = i + b; k < 256; ++k) {
+          if (!r[k]) {
+            r[k] = 1;
+            break;
+          }
+          r[k] = 0;
+        }
+      } else {
+        break;
+      }
+    }
+  }
+}
+
+/* r = a·A + b·B, where B is the base point, using a joint sliding window. */
+static void
+ge_double_scalarmult_vartime(ge_p3 *r, const u8 *a, const ge_p3 *A,
+                             const u8 *b) {
+  signed char aslide[256], bslide[256];
+  ge_cached Ai[8];   /* A, 3A, 5A, ..., 15A */
+  ge_p1p1 t;
+  ge_p3 u, A2;
+  ge_p2 q;
+  int i;
+
+  slide(aslide, a);
+  slide(bslide, b);
+
+  ge_p3_to_cached(&Ai[0], A);
+  ge_p3_to_p2(&q, A);
+  ge_p2_dbl(&t, &q);
+  ge_p1p1_to_p3(&A2, &t);
+  for (i = 1; i < 8; ++i) {
+    ge_add(&t, &A2, &Ai[i - 1]);
+    ge_p1p1_to_p3(&u, &t);
+    ge_p3_to_cached(&Ai[i], &u);
+  }
+
+  ge_p3_0(r);
+  for (i = 255; i >= 0 && !aslide[i] && !bslide[i]; --i) {
+  }
+
+  for (; i >= 0; --i) {
+    ge_p3_to_p2(&q, r);
+    ge_p2_dbl(&t, &q);
+
+    if (aslide[i] > 0) {
+      ge_p1p1_to_p3(&u, &t);
+      ge_add(&t, &u, &Ai[aslide[i] / 2]);
+    } else if (aslide[i] < 0) {
+      ge_p1p1_to_p3(&u, &t);
+      ge_sub(&t, &u, &Ai[(-aslide[i]) / 2]);
+    }
+
+    if (bslide[i] > 0) {
+      ge_p1p1_to_p3(&u, &t);
+      ge_madd(&t, &u, &ge_base_odd[bslide[i] / 2]);
+    } else if (bslide[i] < 0) {
+      ge_p1p1_to_p3(&u, &t);
+      ge_msub(&t, &u, &ge_base_odd[(-bslide[i]) / 2]);
+    }
+
+    ge_p1p1_to_p3(r, &t);
+  }
+}
+
+/* Recodes a scalar into windows signed digits in radix 2^c, each in
+ * [-2^(c-1), 2^(c-1)). The top digit must not carry out, which holds if the
+ * scalar is below 2^(windows·c - 2): for scalars below 2^253, windows = 253/c
+ * + 1 suffices for every c used here. The digits do not depend on the scalar
+ * through any branch or memory access. */
+static void
+sc_signed_digits(signed char *digits, const u8 *s, unsigned c,
+                 unsigned windows) {
+  limb w[5], carry = 0;
+  unsigned i;
+
+  for (i = 0; i < 4; ++i) w[i] = load_limb(s + 8 * i);
+  w[4] = 0;
+
+  for (i = 0; i < windows; ++i) {
+    const unsigned bit = i * c, word = bit / 64, shift = bit % 64;
+    limb v = w[word] >> shift;
+
+    if (shift + c > 64) v |= w[word + 1] << (64 - shift);
+    v = (v & ((((limb)1) << c) - 1)) + carry;
+    carry = (v + (((limb)1) << (c - 1))) >> c;
+    digits[i] = (signed char) (v - (carry << c));
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Computes r = sum(scalars[i]·points[i]) with Pippenger's bucket method.
+//
+// The scalars (little endian, below 2^253) are cut into signed c-bit digits.
+// Working from the top window down, each point is added to or subtracted from
+// the bucket for the magnitude of its digit, and the buckets are then summed,
+// weighted by their magnitude, with the usual running sum. A window costs
+// about n + 2^c additions, so c is chosen to minimise (253/c + 1)·(n + 2^c).
+// Points whose digit is zero, such as those of the 128-bit scalars of the
+// batch verifier in the upper windows, cost nothing.
+// -----------------------------------------------------------------------------
+static void
+ge_multi_scalarmult_vartime(ge_p3 *r, const ge_cached *points,
+                            const u8 (*scalars)[32], unsigned n) {
+  signed char digits[2 * ED25519_BATCH + 1][253 / ED25519_WINDOW_MIN + 1];
+  ge_p3 buckets[1 << (ED25519_WINDOW_MAX - 1)], sum, acc;
+  int used[1 << (ED25519_WINDOW_MAX - 1)], have_sum, have_acc;
+  ge_cached cached;
+  ge_p1p1 t;
+  ge_p2 q;
+  unsigned c = ED25519_WINDOW_MIN, windows, nbuckets, i, j, w;
+
+  for (i = ED25519_WINDOW_MIN + 1; i <= ED25519_WINDOW_MAX; ++i) {
+    if ((253 / i + 1) * (n + (1u << i)) < (253 / c + 1) * (n + (1u << c))) {
+      c = i;
+    }
+  }
+  windows = 253 / c + 1;
+  nbuckets = 1u << (c - 1);
+
+  for (i = 0; i < n; ++i) sc_signed_digits(digits[i], scalars[i], c, windows);
+
+  ge_p3_0(r);
+  for (w = windows; w-- > 0;) {
+    if (w != windows - 1) {
+      ge_p3_to_p2(&q, r);
+      for (i = 1; i < c; ++i) {
+        ge_p2_dbl(&t, &q);
+        ge_p1p1_to_p2(&q, &t);
+      }
+      ge_p2_dbl(&t, &q);
+      ge_p1p1_to_p3(r, &t);
+    }
+
+    for (j = 0; j < nbuckets; ++j) {
+      ge_p3_0(&buckets[j]);
+      used[j] = 0;
+    }
+    for (i = 0; i < n; ++i) {
+      const int d = digits[i][w];
+      if (d > 0) {
+        ge_add(&t, &buckets[d - 1], &points[i]);
+        ge_p1p1_to_p3(&buckets[d - 1], &t);
+        used[d - 1] = 1;
+      } else if (d < 0) {
+        ge_sub(&t, &buckets[-d - 1], &points[i]);
+        ge_p1p1_to_p3(&buckets[-d - 1], &t);
+        used[-d - 1] = 1;
+      }
+    }
+
+    /* acc = sum((j+1)·buckets[j]) */
+    have_sum = have_acc = 0;
+    for (j = nbuckets; j-- > 0;) {
+      if (used[j]) {
+        if (have_sum) {
+          ge_p3_to_cached(&cached, &buckets[j]);
+          ge_add(&t, &sum, &cached);
+          ge_p1p1_to_p3(&sum, &t);
+        } else {
+          sum = buckets[j];
+          have_sum = 1;
+        }
+      }
+      if (!have_sum) continue;
+      if (have_acc) {
+        ge_p3_to_cached(&cached, &sum);
+        ge_add(&t, &acc, &cached);
+        ge_p1p1_to_p3(&acc, &t);
+      } else {
+        acc = sum;
+        have_acc = 1;
+      }
+    }
+
+    if (have_acc) {
+      ge_p3_to_cached(&cached, &acc);
+      ge_add(&t, r, &cached);
+      ge_p1p1_to_p3(r, &t);
+    }
+  }
+}
+
+/* Decodes A and R and computes k = SHA-512(R || A || m) mod L for one
+ * signature. Returns -1 if S is not below L or if either point fails to
+ * decode. */
+static int
+ed25519_prepare(ge_p3 *A, ge_p3 *R, uint64_t k[4], const u8 *sig,
+                const u8 *m, size_t mlen, const u8 *pk) {
+  struct curve25519_donna_sha512_ctx ctx;
+  u8 h[64];
+  uint64_t hw[8];
+  unsigned i;
+
+  if (!sc_canonical(sig + 32)) return -1;
+  if (ge_frombytes(A, pk) || ge_frombytes(R, sig)) return -1;
+
+  curve25519_donna_sha512_init(&ctx);
+  curve25519_donna_sha512_update(&ctx, sig, 32);
+  curve25519_donna_sha512_update(&ctx, pk, 32);
+  curve25519_donna_sha512_update(&ctx, m, mlen);
+  curve25519_donna_sha512_final(&ctx, h);
+  for (i = 0; i < 8; ++i) hw[i] = load_limb(h + 8 * i);
+  sc_reduce(k, hw);
+  return 0;
+}
+
+int curve25519_donna_ed25519_verify(const u8 *, const u8 *, size_t,
+                                    const u8 *);
+
+/* Returns 0 if sig is a valid signature of the mlen-byte message m under the
+ * public key pk, and -1 otherwise. The check is [8]([S]B - [k]A - R) = 0, with
+ * [S]B - [k]A computed by a joint sliding-window double scalar multiplication.
+ */
+int
+curve25519_donna_ed25519_verify(const u8 *sig, const u8 *m, size_t mlen,
+                                const u8 *pk) {
+  ge_p3 A, R, P;
+  ge_cached c;
+  ge_p1p1 t;
+  uint64_t k[4];
+  u8 kbytes[32];
+  int ret;
+  TELEMETRY_START;
+
+  if (ed25519_prepare(&A, &R, k, sig, m, mlen, pk)) {
+    TELEMETRY_END(CURVE25519_PROBE_ED25519_VERIFY);
+    return -1;
+  }
+  sc_store(kbytes, k);
+
+  fneg(A.X, A.X);
+  fneg(A.T, A.T);
+  ge_double_scalarmult_vartime(&P, kbytes, &A, sig + 32);
+  ge_p3_to_cached(&c, &R);
+  ge_sub(&t, &P, &c);
+  ge_p1p1_to_p3(&P, &t);
+
+  ret = ge_cofactor_is_neutral(&P) ? 0 : -1;
+  TELEMETRY_END(CURVE25519_PROBE_ED25519_VERIFY);
+  return ret;
+}
+
+int curve25519_donna_ed25519_verify_batch(const u8 *const *,
+                                          const size_t *,
+                                          const u8 *const *,
+                                          const u8 *const *,
+                                          size_t, int *);
+
+/* Verifies n signatures: sig[i] of the mlen[i]-byte message m[i] under pk[i].
+ * If valid is not NULL, valid[i] is set to 1 if the signature is valid and to
+ * 0 otherwise. Returns 0 if every signature is valid and -1 otherwise.
+ *
+ * Up to ED25519_BATCH signatures at a time are checked together: with random
+ * 128-bit z[i], the verifier checks
+ *
+ *   [8](-(sum z[i]·S[i])·B + sum z[i]·R[i] + sum (z[i]·k[i])·A[i]) = 0
+ *
+ * with one multi-scalar multiplication. If any signature is invalid this
+ * fails except with probability about 2^-128, and the signatures in the group
+ * are then checked one by one to find the culprits.
+ *
+ * The z[i] are derived by hashing the k[i] and S[i] of the whole group, which
+ * bind every R, A, S and message, so a forger cannot choose signatures after
+ * seeing the coefficients they will be combined with.
+ */
+int
+curve25519_donna_ed25519_verify_batch(const u8 *const *m, const size_t *mlen,
+                                      const u8 *const *pk,
+                                      const u8 *const *sig, size_t n,
+                                      int *valid) {
+  static const u8 domain[] = "curve25519-donna ed25519 batch";
+  ge_cached points[2 * ED25519_BATCH + 1];
+  u8 scalars[2 * ED25519_BATCH + 1][32];
+  unsigned idx[ED25519_BATCH];
+  uint64_t k[ED25519_BATCH][4], s[4], z[4], b[4], t[4];
+  struct curve25519_donna_sha512_ctx ctx;
+  u8 seed[64], block[72], zbytes[64];
+  ge_p3 A, R, P;
+  size_t done;
+  unsigned i, j, chunk, count;
+  int ret = 0;
+  TELEMETRY_START;
+
+  for (done = 0; done < n; done += chunk) {
+    chunk = n - done < ED25519_BATCH ? n - done : ED25519_BATCH;
+
+    count = 0;
+    curve25519_donna_sha512_init(&ctx);
+    curve25519_donna_sha512_update(&ctx, domain, sizeof(domain));
+    for (i = 0; i < chunk; ++i) {
+      const size_t e = done + i;
+      if (ed25519_prepare(&A, &R, k[count], sig[e], m[e], mlen[e], pk[e])) {
+        if (valid) valid[e] = 0;
+        ret = -1;
+        continue;
+      }
+      if (valid) valid[e] = 1;
+      ge_p3_to_cached(&points[1 + 2 * count], &R);
+      ge_p3_to_cached(&points[2 + 2 * count], &A);
+      sc_store(block, k[count]);
+      curve25519_donna_sha512_update(&ctx, block, 32);
+      curve25519_donna_sha512_update(&ctx, sig[e] + 32, 32);
+      idx[count++] = i;
+    }
+    curve25519_donna_sha512_final(&ctx, seed);
+    if (count == 0) continue;
+
+    /* z[i] are the 16-byte pieces of SHA-512(seed || counter). */
+    memcpy(block, seed, 64);
+    memset(b, 0, sizeof(b));
+    memset(z, 0, sizeof(z));
+    for (i = 0; i < count; ++i) {
+      if (i % 4 == 0) {
+        store_limb(block + 64, i / 4);
+        curve25519_donna_sha512(zbytes, block, sizeof(block));
+      }
+      z[0] = load_limb(zbytes + 16 * (i % 4));
+      z[1] = load_limb(zbytes + 16 * (i % 4) + 8);
+
+      for (j = 0; j < 4; ++j) s[j] = load_limb(sig[done + idx[i]] + 32 + 8 * j);
+      sc_mul(t, z, s);
+      sc_add(b, b, t);
+
+      sc_store(scalars[1 + 2 * i], z);
+      sc_mul(t, z, k[i]);
+      sc_store(scalars[2 + 2 * i], t);
+    }
+
+    /* The base point's coefficient is -b mod L. */
+    if (b[0] | b[1] | b[2] | b[3]) {
+      uint128_t borrow = 0;
+      for (j = 0; j < 4; ++j) {
+        const uint128_t d = ((uint128_t) sc_order[j]) - b[j] - borrow;
+        b[j] = (uint64_t) d;
+        borrow = (d >> 64) & 1;
+      }
+    }
+    sc_store(scalars[0], b);
+    memcpy(points[0].YplusX, ge_base_odd[0].yplusx, sizeof(felem));
+    memcpy(points[0].YminusX, ge_base_odd[0].yminusx, sizeof(felem));
+    memset(points[0].Z, 0, sizeof(felem));
+    points[0].Z[0] = 1;
+    memcpy(points[0].T2d, ge_base_odd[0].xy2d, sizeof(felem));
+
+    ge_multi_scalarmult_vartime(&P, points, (const u8 (*)[32]) scalars,
+                                1 + 2 * count);
+    if (ge_cofactor_is_neutral(&P)) continue;
+
+    for (i = 0; i < count; ++i) {
+      const size_t e = done + idx[i];
+      if (curve25519_donna_ed25519_verify(sig[e], m[e], mlen[e], pk[e])) {
+        if (valid) valid[e] = 0;
+        ret = -1;
+      }
+    }
+  }
+
+  TELEMETRY_END(CURVE25519_PROBE_ED25519_VERIFY_BATCH);
+  return ret;
+}
+
+// -----------------------------------------------------------------------------
+// Tables for one long-lived peer.
+//
+// A peer's u-coordinate is mapped to the Edwards point with y = (u-1)/(u+1),
+// taking either square root for x: the two roots are P and -P, and [e]P and
+// [e](-P) have the same u-coordinate. For each position i the table holds the
+// multiples 1..2^(w-1) of 2^(w·i)·P in the affine form of ge_precomp, so that
+// with the scalar recoded into signed w-bit digits, [e]P is one ge_madd per
+// digit of an entry chosen in constant time, and the result is mapped back
+// with u = (Z+Y)/(Z-Y). Edwards addition is complete on this curve, so points
+// with a small-order component need no special cases.
+//
+// Public keys on the twist have no Edwards point. For them, and for u = -1,
+// which has no y, the table just records the key and falls back to the ladder.
+// -----------------------------------------------------------------------------
+
+/* The range of window sizes, in bits, that tables can be built with. */
+#define CURVE25519_TABLE_WINDOW_MIN 2
+#define CURVE25519_TABLE_WINDOW_MAX 8
+
+/* The number of positions of a table with w-bit windows: enough digits for a
+ * clamped scalar, below 2^255, with sc_signed_digits. */
+#define CURVE25519_TABLE_POSITIONS(w) ((257 + (w) - 1) / (w))
+
+struct curve25519_donna_table {
+  unsigned window;
+  unsigned positions;
+  int ladder;               /* the peer has no Edwards point */
+  u8 peer[32];
+  ge_precomp entries[];     /* positions rows of 2^(window-1) multiples */
+};
+
+/* f = g if b is 1 and f is unchanged if b is 0, in constant time. */
+static inline void force_inline
+fcmov(felem f, const felem g, limb b) {
+  const limb mask = -b;
+  unsigned i;
+
+  for (i = 0; i < 5; ++i) f[i] ^= mask & (f[i] ^ g[i]);
+}
+
+/* Converts n points, at most CURVE25519_BATCH, to affine form with a single
+ * inversion. */
+static void
+ge_p3_to_precomp_batch(ge_precomp *out, const ge_p3 *p, unsigned n) {
+  felem zinv[CURVE25519_BATCH], scratch[CURVE25519_BATCH], x, y;
+  unsigned i;
+
+  for (i = 0; i < n; ++i) memcpy(zinv[i], p[i].Z, sizeof(felem));
+  crecip_batch(zinv, zinv, scratch, n);
+
+  for (i = 0; i < n; ++i) {
+    fmul(x, p[i].X, zinv[i]);
+    fmul(y, p[i].Y, zinv[i]);
+    fadd(out[i].yplusx, y, x);
+    fcarry(out[i].yplusx);
+    fsub(out[i].yminusx, y, x);
+    fcarry(out[i].yminusx);
+    fmul(out[i].xy2d, x, y);
+    fmul(out[i].xy2d, out[i].xy2d, fe_d2);
+  }
+}
+
+/* Sets t to d times the base of row, which holds its multiples 1..entries,
+ * touching every entry whatever the value of the secret digit d. */
+static void
+table_select(ge_precomp *t, const ge_precomp *row, unsigned entries, int d) {
+  const limb sd = (limb) (int64_t) d, negative = sd >> 63;
+  const limb magnitude = (sd ^ -negative) + negative;
+  felem minus;
+  unsigned j;
+
+  memset(t, 0, sizeof(*t));
+  t->yplusx[0] = 1;
+  t->yminusx[0] = 1;
+  for (j = 0; j < entries; ++j) {
+    const limb equal = (((magnitude ^ (j + 1)) - 1) >> 63);
+    fcmov(t->yplusx, row[j].yplusx, equal);
+    fcmov(t->yminusx, row[j].yminusx, equal);
+    fcmov(t->xy2d, row[j].xy2d, equal);
+  }
+
+  /* -(x, y) = (-x, y): swap y+x with y-x and negate 2dxy. */
+  swap_conditional(t->yplusx, t->yminusx, negative);
+  fneg(minus, t->xy2d);
+  fcmov(t->xy2d, minus, negative);
+}
+
+/* Computes h = [e]P for the peer P of a table that is not marked for the
+ * ladder. e must be clamped. */
+static void
+table_scalarmult(ge_p3 *h, const struct curve25519_donna_table *table,
+                 const u8 *e) {
+  signed char digits[CURVE25519_TABLE_POSITIONS(CURVE25519_TABLE_WINDOW_MIN)];
+  const unsigned entries = 1u << (table->window - 1);
+  ge_precomp p;
+  ge_p1p1 t;
+  unsigned i;
+
+  sc_signed_digits(digits, e, table->window, table->positions);
+
+  ge_p3_0(h);
+  for (i = 0; i < table->positions; ++i) {
+    table_select(&p, table->entries + i * entries, entries, digits[i]);
+    ge_madd(&t, h, &p);
+    ge_p1p1_to_p3(h, &t);
+  }
+}
+
+/* Computes the u-coordinate of [e]P, for the peer P of a table that is not
+ * marked for the ladder, as num/den. e must be clamped. */
+static void
+table_mult(felem num, felem den, const struct curve25519_donna_table *table,
+           const u8 *e) {
+  ge_p3 h;
+
+  table_scalarmult(&h, table, e);
+  fadd(num, h.Z, h.Y);
+  fsub(den, h.Z, h.Y);
+}
+
+/* Maps the u-coordinate u to the Edwards point with y = (u-1)/(u+1) and
+ * either x. Returns 0, or -1 if u is on the twist or is -1, which have no
+ * such point. u is public: this is not constant time. */
+static int
+ge_from_montgomery(ge_p3 *h, const felem u) {
+  static const felem one = {1};
+  felem num, den;
+  u8 y[32];
+
+  fadd(den, u, one);
+  fsub(num, u, one);
+  if (fiszero(den)) return -1;
+  crecip(den, den);
+  fmul(num, num, den);
+  fcontract(y, num);
+  return ge_frombytes(h, y);
+}
+
+size_t curve25519_donna_table_size(unsigned);
+
+size_t
+curve25519_donna_table_size(unsigned window) {
+  if (window < CURVE25519_TABLE_WINDOW_MIN ||
+      window > CURVE25519_TABLE_WINDOW_MAX) return 0;
+  return sizeof(struct curve25519_donna_table) +
+         sizeof(ge_precomp) * CURVE25519_TABLE_POSITIONS(window) *
+         (1u << (window - 1));
+}
+
+struct curve25519_donna_table *curve25519_donna_table_new(const u8 *, unsigned);
+
+/* Builds the table of the peer public key. This costs about
+ * positions·2^(window-1) point additions and positions·2^(window-1)/32 field
+ * inversions; the peer is public, so the decoding need not be constant time.
+ */
+struct curve25519_donna_table *
+curve25519_donna_table_new(const u8 *peer, unsigned window) {
+  const size_t size = curve25519_donna_table_size(window);
+  struct curve25519_donna_table *table;
+  ge_p3 buf[CURVE25519_BATCH], base, cur;
+  ge_cached cached;
+  ge_p1p1 t;
+  ge_p2 q;
+  felem u;
+  unsigned entries, i, k, pending = 0;
+  size_t done = 0;
+
+  if (!size) return NULL;
+  table = malloc(size);
+  if (!table) return NULL;
+  table->window = window;
+  table->positions = CURVE25519_TABLE_POSITIONS(window);
+  memcpy(table->peer, peer, 32);
+
+  fexpand(u, peer);
+  table->ladder = ge_from_montgomery(&base, u) != 0;
+  if (table->ladder) return table;
+
+  entries = 1u << (window - 1);
+  for (i = 0; i < table->positions; ++i) {
+    ge_p3_to_cached(&cached, &base);
+    cur = base;
+    for (k = 0; k < entries; ++k) {
+      if (k) {
+        ge_add(&t, &cur, &cached);
+        ge_p1p1_to_p3(&cur, &t);
+      }
+      buf[pending++] = cur;
+      if (pending == CURVE25519_BATCH) {
+        ge_p3_to_precomp_batch(table->entries + done, buf, pending);
+        done += pending;
+        pending = 0;
+      }
+    }
+    /* The next base is 2^w·base = 2·(2^(w-1)·base). */
+    ge_p3_to_p2(&q, &cur);
+    ge_p2_dbl(&t, &q);
+    ge_p1p1_to_p3(&base, &t);
+  }
+  if (pending) ge_p3_to_precomp_batch(table->entries + done, buf, pending);
+
+  return table;
+}
+
+void curve25519_donna_table_free(struct curve25519_donna_table *);
+
+void
+curve25519_donna_table_free(struct curve25519_donna_table *table) {
+  free(table);
+}
+
+int curve25519_donna_table_mult(u8 *, const struct curve25519_donna_table *,
+                                const u8 *);
+
+/* Computes shared = curve25519_donna(secret, peer) for the peer of table, in
+ * constant time with respect to the secret. */
+int
+curve25519_donna_table_mult(u8 *shared,
+                            const struct curve25519_donna_table *table,
+                            const u8 *secret) {
+  felem num, den;
+  u8 e[32];
+  TELEMETRY_START;
+
+  /* This is recorded as a call of curve25519_donna. */
+  if (table->ladder) return curve25519_donna(shared, secret, table->peer);
+
+  memcpy(e, secret, 32);
+  e[0] &= 248;
+  e[31] &= 127;
+  e[31] |= 64;
+
+  table_mult(num, den, table, e);
+  crecip(den, den);
+  fmul(num, num, den);
+  fcontract(shared, num);
+  TELEMETRY_END(CURVE25519_PROBE_TABLE_MULT);
+  return 0;
+}
+
+/* The window of the base point's table. */
+#define CURVE25519_BASE_WINDOW 4
+
+/* The table of the base point, built on first use. Threads that race to build
+ * it each build one, and all but the first to publish theirs free it again. */
+static struct curve25519_donna_table *base_table;
+
+/* Returns the table of the base point, or NULL if it cannot be allocated. */
+static const struct curve25519_donna_table *
+base_table_get(void) {
+  static const u8 basepoint[32] = {9};
+  struct curve25519_donna_table *table, *expected = NULL;
+
+  table = __atomic_load_n(&base_table, __ATOMIC_ACQUIRE);
+  if (table) return table;
+  table = curve25519_donna_table_new(basepoint, CURVE25519_BASE_WINDOW);
+  if (!table) return NULL;
+  if (!__atomic_compare_exchange_n(&base_table, &expected, table, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    curve25519_donna_table_free(table);
+    table = expected;
+  }
+  return table;
+}
+
+// -----------------------------------------------------------------------------
+// Windowed Edwards multiplication.
+//
+// An alternative to the ladder for one variable point, on the same lines as
+// the tables above but built per call: the point is mapped to the Edwards
+// curve with ge_from_montgomery, its multiples 1..2^(w-1) are kept in the
+// projective form of ge_cached, and the scalar, recoded into signed w-bit
+// digits, is worked through from the top with w doublings and the addition
+// of an entry chosen in constant time per digit. Points on the twist, and
+// u = -1, go to the ladder instead.
+// -----------------------------------------------------------------------------
+
+/* The window, in bits. Five needs a fifth fewer additions than four but reads
+ * twice as many entries for each, and comes out no faster. */
+#define CURVE25519_EDWARDS_WINDOW 4
+#define CURVE25519_EDWARDS_ENTRIES (1u << (CURVE25519_EDWARDS_WINDOW - 1))
+#define CURVE25519_EDWARDS_POSITIONS \
+  CURVE25519_TABLE_POSITIONS(CURVE25519_EDWARDS_WINDOW)
+
+/* Sets t to d times the point whose multiples 1..entries are in row, touching
+ * every entry whatever the value of the secret digit d. */
+static void
+cached_select(ge_cached *t, const ge_cached *row, unsigned entries, int d) {
+  const limb sd = (limb) (int64_t) d, negative = sd >> 63;
+  const limb magnitude = (sd ^ -negative) + negative;
+  felem minus;
+  unsigned j;
+
+  memset(t, 0, sizeof(*t));
+  t->YplusX[0] = 1;
+  t->YminusX[0] = 1;
+  t->Z[0] = 1;
+  for (j = 0; j < entries; ++j) {
+    const limb equal = (((magnitude ^ (j + 1)) - 1) >> 63);
+    fcmov(t->YplusX, row[j].YplusX, equal);
+    fcmov(t->YminusX, row[j].YminusX, equal);
+    fcmov(t->Z, row[j].Z, equal);
+    fcmov(t->T2d, row[j].T2d, equal);
+  }
+
+  swap_conditional(t->YplusX, t->YminusX, negative);
+  fneg(minus, t->T2d);
+  fcmov(t->T2d, minus, negative);
+}
+
+/* Calculates n·q like cmult, with the point on the Edwards curve. */
+static void
+cmult_windowed(felem resultx, felem resultz, const u8 *n, const felem q) {
+  signed char digits[CURVE25519_EDWARDS_POSITIONS];
+  ge_cached row[CURVE25519_EDWARDS_ENTRIES], c;
+  ge_p3 p, h;
+  ge_p1p1 t;
+  ge_p2 r;
+  unsigned i, j;
+  TELEMETRY_START;
+
+  if (ge_from_montgomery(&p, q)) {
+    cmult(resultx, resultz, n, q);
+    return;
+  }
+
+  ge_p3_to_cached(&row[0], &p);
+  h = p;
+  for (j = 1; j < CURVE25519_EDWARDS_ENTRIES; ++j) {
+    ge_add(&t, &h, &row[0]);
+    ge_p1p1_to_p3(&h, &t);
+    ge_p3_to_cached(&row[j], &h);
+  }
+
+  sc_signed_digits(digits, n, CURVE25519_EDWARDS_WINDOW,
+                   CURVE25519_EDWARDS_POSITIONS);
+  ge_p3_0(&h);
+  for (i = CURVE25519_EDWARDS_POSITIONS; i-- > 0;) {
+    if (i != CURVE25519_EDWARDS_POSITIONS - 1) {
+      ge_p3_to_p2(&r, &h);
+      for (j = 1; j < CURVE25519_EDWARDS_WINDOW; ++j) {
+        ge_p2_dbl(&t, &r);
+        ge_p1p1_to_p2(&r, &t);
+      }
+      ge_p2_dbl(&t, &r);
+      ge_p1p1_to_p3(&h, &t);
+    }
+    cached_select(&c, row, CURVE25519_EDWARDS_ENTRIES, digits[i]);
+    ge_add(&t, &h, &c);
+    ge_p1p1_to_p3(&h, &t);
+  }
+
+  fadd(resultx, h.Z, h.Y);
+  fcarry(resultx);
+  fsub(resultz, h.Z, h.Y);
+  fcarry(resultz);
+  TELEMETRY_END(CURVE25519_PROBE_LADDER_EDWARDS);
+}
+
+int curve25519_donna_ephemeral(u8 *, u8 *, const u8 *, const u8 *);
+
+/* Computes mypublic = curve25519_donna(secret, {9}) and shared =
+ * curve25519_donna(secret, peer). The public key is a fixed-base
+ * multiplication with the base point's table, the shared key is a ladder, and
+ * the two results are finished with a single inversion. */
+int
+curve25519_donna_ephemeral(u8 *mypublic, u8 *shared, const u8 *secret,
+                           const u8 *peer) {
+  static const u8 basepoint[32] = {9};
+  const struct curve25519_donna_table *base = base_table_get();
+  felem q, x[2], z[2], scratch[2], t;
+  u8 e[32];
+  unsigned i;
+  TELEMETRY_START;
+
+  for (i = 0; i < 32; ++i) e[i] = secret[i];
+  e[0] &= 248;
+  e[31] &= 127;
+  e[31] |= 64;
+
+  fexpand(q, peer);
+  cmult(x[1], z[1], e, q);
+  if (base) {
+    table_mult(x[0], z[0], base, e);
+  } else {
+    fexpand(q, basepoint);
+    cmult(x[0], z[0], e, q);
+  }
+  crecip_batch(z, z, scratch, 2);
+
+  fmul(t, x[0], z[0]);
+  fcontract(mypublic, t);
+  fmul(t, x[1], z[1]);
+  fcontract(shared, t);
+  TELEMETRY_END(CURVE25519_PROBE_EPHEMERAL);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Elligator 2.
+//
+// A representative is a 254-bit string r that decodes to the u-coordinate
+//
+//   v = -A/(1 + 2r^2)   if v^3 + A·v^2 + v is a square,
+//   u = -v - A          otherwise,
+//
+// where A = 486662. About half of the points of the curve have
+// representatives, and those that do have two, up to sign: r^2 = -u/(2(u+A))
+// and r^2 = -(u+A)/(2u). Of r and -r, the one below (p-1)/2 is used, and the
+// top two bits, which the decoder ignores, are filled in from a random tweak,
+// so that representatives of random points are uniform 256-bit strings.
+//
+// The points of [e]B for clamped e all lie in the subgroup of prime order,
+// which an observer can test for. The generator below therefore adds a random
+// point of small order to each public key. Clamping makes e a multiple of 8,
+// so the shared keys that anyone computes with it are unchanged.
+// -----------------------------------------------------------------------------
+
+/* A point of order 8 of the Edwards curve. */
+static const felem fe_torsion_x = {
+  0x6b9b93aba2ea3, 0x1fd8343b8e42b, 0x486d5128f9b0e, 0x2eb8b663366e3,
+  0x602a465ff9c6b
+};
+static const felem fe_torsion_y = {
+  0x7b2c28f95e826, 0x6513e9868b604, 0x6b37f57c263bf, 0x4589c99e36982,
+  0x5fc536d88023
+};
+
+/* Sets r to a square root of n/d and returns 1 if n/d is a square, or
+ * returns 0 and leaves r unspecified. n must be carried. When d is zero, only
+ * 0/0 is a square. Runs in constant time. */
+static limb
+fsqrt_ratio(felem r, const felem n, const felem d) {
+  felem d3, dxx, t;
+  limb correct, flipped;
+
+  /* r = n·d^3·(n·d^7)^((p-5)/8), as in ge_frombytes. */
+  fsquare_times(d3, d, 1);
+  fmul(d3, d3, d);
+  fsquare_times(r, d3, 1);
+  fmul(r, r, d);
+  fmul(r, r, n);
+  fpow22523(r, r);
+  fmul(r, r, d3);
+  fmul(r, r, n);
+
+  fsquare_times(dxx, r, 1);
+  fmul(dxx, dxx, d);
+  fsub(t, dxx, n);
+  correct = fiszero(t);
+  fadd(t, dxx, n);
+  flipped = fiszero(t);
+  fmul(t, r, fe_sqrtm1);
+  fcmov(r, t, flipped);
+  return correct | flipped;
+}
+
+/* Computes the representative of the point with u-coordinate num/den, using
+ * the root chosen by the low bit of tweak and taking the top two bits from
+ * those of tweak. num and den must be carried and the point must be on the
+ * curve, not the twist. Returns 1, or 0 if the point has no representative,
+ * in constant time. */
+static limb
+elligator_encode(u8 *out, const felem num, const felem den, u8 tweak) {
+  felem sum, n, d, r, t;
+  limb branch, ok;
+
+  /* sum = num + A·den, so that sum/den = u + A. */
+  fscalar_product(t, den, 486662);
+  fadd(sum, num, t);
+  fcarry(sum);
+
+  /* u = 0 only has the root r = 0 of the first form. */
+  branch = (tweak & 1) & (fiszero(num) ^ 1);
+  memcpy(n, num, sizeof(felem));
+  memcpy(d, sum, sizeof(felem));
+  fcmov(n, sum, branch);
+  fcmov(d, num, branch);
+  fneg(n, n);
+  fadd(d, d, d);
+
+  /* u = -A is not on the curve, and would decode as 0. */
+  ok = fsqrt_ratio(r, n, d) & (fiszero(sum) ^ 1);
+
+  /* r is above (p-1)/2 exactly when 2r mod p is odd. */
+  fadd(t, r, r);
+  branch = fisnegative(t);
+  fneg(t, r);
+  fcmov(r, t, branch);
+  fcontract(out, r);
+  out[31] |= tweak & 0xc0;
+  return ok;
+}
+
+int curve25519_donna_elligator_decode(u8 *, const u8 *);
+
+int
+curve25519_donna_elligator_decode(u8 *mypublic, const u8 *representative) {
+  static const felem one = {1}, a = {486662};
+  felem r, w, f, t, chi, num, alt;
+  limb nonsquare;
+  u8 bytes[32];
+
+  memcpy(bytes, representative, 32);
+  bytes[31] &= 63;
+  fexpand(r, bytes);
+
+  fsquare_times(w, r, 1);
+  fadd(w, w, w);
+  fadd(w, w, one);
+  fcarry(w);                        /* w = 1 + 2r^2, never zero */
+
+  /* With v = -A/w, v^3 + A·v^2 + v = -A·w·(A^2·(1 - w) + w^2)/w^4, and -1
+   * is a square, so its quadratic character is that of f. */
+  fsub(alt, one, w);
+  fcarry(alt);                      /* alt = 1 - w */
+  fscalar_product(t, alt, 486662ull * 486662);
+  fsquare_times(f, w, 1);
+  fadd(t, t, f);
+  fmul(f, t, w);
+  fscalar_product(f, f, 486662);
+
+  /* chi = f^((p-1)/2) = (f^((p-5)/8))^4 · f^2 */
+  fpow22523(t, f);
+  fsquare_times(t, t, 2);
+  fsquare_times(chi, f, 1);
+  fmul(chi, chi, t);
+  fadd(t, chi, one);
+  nonsquare = fiszero(t);
+
+  /* u·w is -A, or A·(1 - w) for u = -v - A. */
+  fneg(num, a);
+  fscalar_product(alt, alt, 486662);
+  fcmov(num, alt, nonsquare);
+  crecip(w, w);
+  fmul(t, num, w);
+  fcontract(mypublic, t);
+  return 0;
+}
+
+int curve25519_donna_elligator_encode(u8 *, const u8 *, u8);
+
+int
+curve25519_donna_elligator_encode(u8 *representative, const u8 *mypublic,
+                                  u8 tweak) {
+  static const felem one = {1};
+  u8 expected[32], decoded[32];
+  felem u;
+
+  fexpand(u, mypublic);
+  if (!elligator_encode(representative, u, one, tweak)) return -1;
+
+  /* Points of the twist encode to representatives of other points. */
+  fcontract(expected, u);
+  curve25519_donna_elligator_decode(decoded, representative);
+  if (memcmp(expected, decoded, 32) != 0) return -1;
+  return 0;
+}
+
+int
+curve25519_donna_random_bytes(u8 *out, size_t len) {
+  while (len > 0) {
+    const ssize_t n = getrandom(out, len, 0);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    out += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/* Sets row to the multiples 1..4 of the point of order 8, for table_select. */
+static void
+elligator_torsion(ge_precomp row[4]) {
+  static const felem one = {1};
+  ge_p3 p[4];
+  ge_cached c;
+  ge_p1p1 t;
+  unsigned i;
+
+  memcpy(p[0].X, fe_torsion_x, sizeof(felem));
+  memcpy(p[0].Y, fe_torsion_y, sizeof(felem));
+  memcpy(p[0].Z, one, sizeof(felem));
+  fmul(p[0].T, fe_torsion_x, fe_torsion_y);
+  ge_p3_to_cached(&c, &p[0]);
+  for (i = 1; i < 4; ++i) {
+    ge_add(&t, &p[i - 1], &c);
+    ge_p1p1_to_p3(&p[i], &t);
+  }
+  ge_p3_to_precomp_batch(row, p, 4);
+}
+
+int curve25519_donna_elligator_keypairs(u8 *, u8 *, u8 *, size_t);
+
+/* Candidates are drawn CURVE25519_BATCH at a time: each costs a fixed-base
+ * multiplication with the base point's table, the addition of a small-order
+ * point and one square root for its representative, which is computed from
+ * the projective point so that only the kept candidates need u in affine
+ * form, and those share one inversion. About half of the candidates have no
+ * representative and are dropped. Which ones is public, since they are never
+ * used; everything done with the kept ones is constant time. */
+int
+curve25519_donna_elligator_keypairs(u8 *secrets, u8 *publics,
+                                    u8 *representatives, size_t n) {
+  const struct curve25519_donna_table *base = base_table_get();
+  u8 random[CURVE25519_BATCH * 33], e[32];
+  felem num[CURVE25519_BATCH], den[CURVE25519_BATCH];
+  felem scratch[CURVE25519_BATCH], t;
+  ge_precomp torsion[4], p;
+  ge_p1p1 r;
+  ge_p3 h;
+  size_t done = 0;
+  unsigned i, j, found;
+  int ret = 0;
+
+  if (!base) {
+    errno = ENOMEM;
+    return -1;
+  }
+  elligator_torsion(torsion);
+
+  while (done < n) {
+    if (curve25519_donna_random_bytes(random, sizeof(random))) {
+      ret = -1;
+      break;
+    }
+
+    found = 0;
+    for (i = 0; i < CURVE25519_BATCH && done + found < n; ++i) {
+      const u8 *const secret = random + 32 * i;
+      const u8 tweak = random[32 * CURVE25519_BATCH + i];
+      u8 *const out = representatives + 32 * (done + found);
+
+      for (j = 0; j < 32; ++j) e[j] = secret[j];
+      e[0] &= 248;
+      e[31] &= 127;
+      e[31] |= 64;
+
+      /* Bits 1 to 3 of the tweak pick the small-order point. */
+      table_scalarmult(&h, base, e);
+      table_select(&p, torsion, 4, (int) ((tweak >> 1) & 7) - 4);
+      ge_madd(&r, &h, &p);
+      ge_p1p1_to_p3(&h, &r);
+
+      fadd(num[found], h.Z, h.Y);
+      fcarry(num[found]);
+      fsub(den[found], h.Z, h.Y);
+      fcarry(den[found]);
+      if (!elligator_encode(out, num[found], den[found], tweak)) continue;
+
+      memcpy(secrets + 32 * (done + found), secret, 32);
+      found++;
+    }
+    if (!found) continue;
+
+    crecip_batch(den, den, scratch, found);
+    for (i = 0; i < found; ++i) {
+      fmul(t, num[i], den[i]);
+      fcontract(publics + 32 * (done + i), t);
+    }
+    done += found;
+  }
+
+  /* random holds the dropped candidates too, which the caller never sees. */
+  donna_memset(random, 0, sizeof(random));
+  donna_memset(e, 0, sizeof(e));
+  donna_memset(&h, 0, sizeof(h));
+  donna_memset(&r, 0, sizeof(r));
+  donna_memset(num, 0, sizeof(num));
+  donna_memset(den, 0, sizeof(den));
+  donna_memset(t, 0, sizeof(t));
+  return ret;
+}
+
+// -----------------------------------------------------------------------------
+// Key enumeration.
+//
+// The public keys of the secrets s, s + 8, s + 16, ... are the u-coordinates
+// of [s]B, [s]B + [8]B, [s]B + 2·[8]B, ... on the Edwards curve. So after one
+// fixed-base multiplication with the base point's table, each key costs one
+// mixed addition of [8]B, which the table holds as the eighth multiple in its
+// first row, and its share of an inversion: the points are mapped to
+// u = (Z+Y)/(Z-Y) CURVE25519_BATCH at a time.
+// -----------------------------------------------------------------------------
+
+/* Adds 8 to the 32-byte little endian s. */
+static void
+secret_add8(u8 *s) {
+  unsigned carry = 8, i;
+
+  for (i = 0; i < 32 && carry; ++i) {
+    carry += s[i];
+    s[i] = carry;
+    carry >>= 8;
+  }
+}
+
+/* Returns 1 if the clamped s plus 8·k is still below 2^255, i.e. clamped. */
+static int
+secret_fits(const u8 *s, size_t k) {
+  uint128_t sum = (uint128_t) k << 3;
+  unsigned i;
+
+  for (i = 0; i < 31; ++i) {
+    sum += s[i];
+    sum >>= 8;
+  }
+  return s[31] + sum < 128;
+}
+
+int curve25519_donna_enumerate(const u8 *, size_t, curve25519_donna_match,
+                               void *);
+
+int
+curve25519_donna_enumerate(const u8 *secret, size_t n,
+                           curve25519_donna_match match, void *arg) {
+  const struct curve25519_donna_table *base = base_table_get();
+  felem num[CURVE25519_BATCH], den[CURVE25519_BATCH];
+  felem scratch[CURVE25519_BATCH], t;
+  u8 e[32], mypublic[32];
+  ge_p1p1 r;
+  ge_p3 h;
+  size_t done;
+  unsigned i, chunk;
+  int ret = 0;
+  TELEMETRY_START;
+
+  if (!base) {
+    errno = ENOMEM;
+    return -1;
+  }
+  for (i = 0; i < 32; ++i) e[i] = secret[i];
+  e[0] &= 248;
+  e[31] &= 127;
+  e[31] |= 64;
+  if (n && !secret_fits(e, n - 1)) {
+    errno = ERANGE;
+    return -1;
+  }
+
+  table_scalarmult(&h, base, e);
+  for (done = 0; done < n && !ret; done += chunk) {
+    chunk = n - done < CURVE25519_BATCH ? n - done : CURVE25519_BATCH;
+
+    for (i = 0; i < chunk; ++i) {
+      fadd(num[i], h.Z, h.Y);
+      fcarry(num[i]);
+      fsub(den[i], h.Z, h.Y);
+      fcarry(den[i]);
+      ge_madd(&r, &h, &base->entries[7]);
+      ge_p1p1_to_p3(&h, &r);
+    }
+    crecip_batch(den, den, scratch, chunk);
+
+    for (i = 0; i < chunk && !ret; ++i) {
+      fmul(t, num[i], den[i]);
+      fcontract(mypublic, t);
+      ret = match(e, mypublic, arg);
+      secret_add8(e);
+    }
+  }
+
+  donna_memset(e, 0, sizeof(e));
+  donna_memset(&h, 0, sizeof(h));
+  TELEMETRY_END(CURVE25519_PROBE_ENUMERATE);
+  return ret;
+}
+
+int curve25519_donna_match_prefix(const u8 *, const u8 *, void *);
+
+int
+curve25519_donna_match_prefix(const u8 *secret, const u8 *mypublic,
+                              void *arg) {
+  struct curve25519_donna_prefix *const p = arg;
+  const unsigned bytes = p->bits / 8, rest = p->bits % 8;
+
+  if (memcmp(mypublic, p->prefix, bytes) != 0) return 0;
+  if (rest && ((mypublic[bytes] ^ p->prefix[bytes]) >> (8 - rest)) != 0) {
+    return 0;
+  }
+  memcpy(p->secret, secret, 32);
+  memcpy(p->mypublic, mypublic, 32);
+  return 1;
+}
+
+// -----------------------------------------------------------------------------
+// Hierarchical key derivation.
+//
+// A child of the master key pair (a, A) under a label is the key pair whose
+// point is
+//
+//   C = P + [h]B,  h = SHA-512(domain || u(A) || label) mod L
+//
+// where P is whichever of A and -A has an even x-coordinate, as ge_frombytes
+// decodes u(A), so that anyone with the master public key can compute u(C)
+// with one fixed-base multiplication and an addition. The child secret is
+// c ≡ ±(σa + h) (mod L), with σ = ±1 the sign that makes [σa]B = P, chosen
+// among its residues to be a multiple of 8 in [2^254, 2^255): an ordinary
+// clamped secret, which curve25519_donna leaves as it is. Negating c does not
+// change u([c]B), and one of s/8 and -s/8 mod L lies in [2^251, 2^252) unless
+// s/8 is within 2^125 of 0 or of L.
+// -----------------------------------------------------------------------------
+
+static const u8 derive_domain[] = "curve25519-donna derive";
+
+/* h = SHA-512(domain || master || label) mod L, as 32 bytes. */
+static void
+derive_tweak(u8 *out, const u8 *master, const u8 *label, size_t labellen) {
+  struct curve25519_donna_sha512_ctx ctx;
+  uint64_t wide[8], h[4];
+  u8 digest[64];
+  unsigned i;
+
+  curve25519_donna_sha512_init(&ctx);
+  curve25519_donna_sha512_update(&ctx, derive_domain, sizeof(derive_domain));
+  curve25519_donna_sha512_update(&ctx, master, 32);
+  curve25519_donna_sha512_update(&ctx, label, labellen);
+  curve25519_donna_sha512_final(&ctx, digest);
+  for (i = 0; i < 8; ++i) wide[i] = load_limb(digest + 8 * i);
+  sc_reduce(h, wide);
+  sc_store(out, h);
+}
+
+/* out = L - a, for a less than L, or L for zero. */
+static void
+sc_negate(uint64_t out[4], const uint64_t a[4]) {
+  uint128_t borrow = 0;
+  unsigned i;
+
+  for (i = 0; i < 4; ++i) {
+    const uint128_t t = ((uint128_t) sc_order[i]) - a[i] - borrow;
+    out[i] = (uint64_t) t;
+    borrow = (t >> 64) & 1;
+  }
+}
+
+/* Sets a to b where mask is all ones and leaves it where mask is zero. */
+static void
+sc_cmov(uint64_t a[4], const uint64_t b[4], uint64_t mask) {
+  unsigned i;
+
+  for (i = 0; i < 4; ++i) a[i] ^= mask & (a[i] ^ b[i]);
+}
+
+int curve25519_donna_derive_public_batch(u8 *, const u8 *,
+                                         const u8 *const *, const size_t *,
+                                         size_t);
+
+/* The children of one master public key, the points P + [h_i]B mapped to u
+ * CURVE25519_BATCH at a time as in curve25519_donna_enumerate. */
+int
+curve25519_donna_derive_public_batch(u8 *children, const u8 *master,
+                                     const u8 *const *labels,
+                                     const size_t *labellens, size_t n) {
+  const struct curve25519_donna_table *base = base_table_get();
+  felem num[CURVE25519_BATCH], den[CURVE25519_BATCH];
+  felem scratch[CURVE25519_BATCH], u, t;
+  ge_cached p;
+  ge_p3 point, h;
+  ge_p1p1 r;
+  u8 canonical[32], tweak[32];
+  size_t done;
+  unsigned i, chunk;
+  int ret = 0;
+  TELEMETRY_START;
+
+  if (!base) {
+    memset(children, 0, 32 * n);
+    errno = ENOMEM;
+    return -1;
+  }
+  fexpand(u, master);
+  if (ge_from_montgomery(&point, u)) {
+    memset(children, 0, 32 * n);
+    return -1;
+  }
+  ge_p3_to_cached(&p, &point);
+  /* The tweak covers the u that was decoded, not the bytes it came from, so
+   * that the encodings curve25519_donna treats as one key, with the top bit
+   * set or u not reduced mod p, give one child as derive_secret does. */
+  fcontract(canonical, u);
+
+  for (done = 0; done < n; done += chunk) {
+    chunk = n - done < CURVE25519_BATCH ? n - done : CURVE25519_BATCH;
+
+    for (i = 0; i < chunk; ++i) {
+      derive_tweak(tweak, canonical, labels[done + i], labellens[done + i]);
+      table_scalarmult(&h, base, tweak);
+      ge_add(&r, &h, &p);
+      ge_p1p1_to_p3(&h, &r);
+      fadd(num[i], h.Z, h.Y);
+      fcarry(num[i]);
+      fsub(den[i], h.Z, h.Y);
+      fcarry(den[i]);
+      /* The neutral point has no u-coordinate. */
+      if (fiszero(den[i])) ret = -1;
+    }
+    crecip_batch(den, den, scratch, chunk);
+
+    for (i = 0; i < chunk; ++i) {
+      fmul(t, num[i], den[i]);
+      fcontract(children + 32 * (done + i), t);
+    }
+  }
+  TELEMETRY_END(CURVE25519_PROBE_DERIVE);
+  return ret;
+}
+
+int curve25519_donna_derive_public(u8 *, const u8 *, const u8 *, size_t);
+
+int
+curve25519_donna_derive_public(u8 *child, const u8 *master, const u8 *label,
+                               size_t labellen) {
+  return curve25519_donna_derive_public_batch(child, master, &label,
+                                              &labellen, 1);
+}
+
+int curve25519_donna_derive_secret(u8 *, const u8 *, const u8 *, size_t);
+
+int
+curve25519_donna_derive_secret(u8 *child, const u8 *master, const u8 *label,
+                               size_t labellen) {
+  /* 8^-1 mod L = (3L + 1)/8 */
+  static const uint64_t inv8[4] = {
+    0x6106e529e2dc2f79, 0x07d39db37d1cdad0, 0, 0x0600000000000000
+  };
+  const struct curve25519_donna_table *base = base_table_get();
+  felem z[2], scratch[2], x;
+  uint64_t wide[8] = {0}, a[4], s[4], m[4];
+  u8 e[32], mypublic[32], tweak[32];
+  ge_p3 h;
+  unsigned i;
+  int ret = 0;
+
+  if (!base) {
+    memset(child, 0, 32);
+    errno = ENOMEM;
+    return -1;
+  }
+  for (i = 0; i < 32; ++i) e[i] = master[i];
+  e[0] &= 248;
+  e[31] &= 127;
+  e[31] |= 64;
+
+  /* A = [a]B, its u-coordinate (Z+Y)/(Z-Y) and its x-coordinate X/Z. */
+  table_scalarmult(&h, base, e);
+  fsub(z[0], h.Z, h.Y);
+  fcarry(z[0]);
+  memcpy(z[1], h.Z, sizeof(felem));
+  crecip_batch(z, z, scratch, 2);
+  fadd(x, h.Z, h.Y);
+  fmul(x, x, z[0]);
+  fcontract(mypublic, x);
+  fmul(x, h.X, z[1]);
+
+  /* s = σa + h, with σ = -1 where x is odd. */
+  for (i = 0; i < 4; ++i) wide[i] = load_limb(e + 8 * i);
+  sc_reduce(a, wide);
+  sc_negate(m, a);
+  sc_cmov(a, m, -(uint64_t) fisnegative(x));
+  derive_tweak(tweak, mypublic, label, labellen);
+  for (i = 0; i < 4; ++i) s[i] = load_limb(tweak + 8 * i);
+  sc_add(s, a, s);
+
+  /* c = 8·(s/8 mod L), or 8·(-s/8 mod L) where that is below 2^254. */
+  sc_mul(s, s, inv8);
+  sc_negate(m, s);
+  sc_cmov(s, m, ((s[3] >> 59) & 1) - 1);
+  if ((s[3] >> 59) != 1) ret = -1;
+  for (i = 3; i > 0; --i) s[i] = (s[i] << 3) | (s[i - 1] >> 61);
+  s[0] <<= 3;
+  sc_store(child, s);
+  if (ret) memset(child, 0, 32);
+
+  donna_memset(e, 0, sizeof(e));
+  donna_memset(a, 0, sizeof(a));
+  donna_memset(s, 0, sizeof(s));
+  donna_memset(m, 0, sizeof(m));
+  donna_memset(wide, 0, sizeof(wide));
+  donna_memset(&h, 0, sizeof(h));
+  return ret;
 }
@@ -0,0 +1,264 @@
+/* curve25519-donna: compile-time evaluation
+ *
+ * Code released into the public domain.
+ *
+ * A constexpr copy of the field arithmetic and ladder of
+ * curve25519-donna-c64.c, so that fixed keys and known answers can be
+ * computed by the compiler and emitted as constants:
+ *
+ *   constexpr auto secret = curve25519::compile_time::from_hex(
+ *       "77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a");
+ *   constexpr auto mine = curve25519::compile_time::public_key(secret);
+ *   static_assert(mine[0] == 0x85);
+ *
+ * The representation (five 51-bit limbs), the carry chains and the inversion
+ * chain are those of the C file, with products in unsigned __int128, which
+ * GCC and Clang evaluate in constant expressions. The functions can also be
+ * called at run time, where they give the same results as curve25519_donna,
+ * but they are much slower than the library and are meant for constants.
+ *
+ * Each scalar multiplication takes GCC a couple of seconds, and a few million
+ * of the operations that -fconstexpr-ops-limit counts per constant, so a
+ * constant should be built from no more than a handful of them.
+ */
+
+#ifndef CURVE25519_DONNA_CONSTEXPR_HPP
+#define CURVE25519_DONNA_CONSTEXPR_HPP
+
+#include <array>
+#include <cstdint>
+
+namespace curve25519 {
+namespace compile_time {
+
+using bytes = std::array<std::uint8_t, 32>;
+
+namespace detail {
+
+using limb = std::uint64_t;
+using uint128_t = unsigned __int128;
+using felem = std::array<limb, 5>;
+
+inline constexpr limb mask51 = 0x7ffffffffffff;
+
+constexpr felem fadd(const felem &a, const felem &b) {
+  felem out{};
+  for (int i = 0; i < 5; ++i) out[i] = a[i] + b[i];
+  return out;
+}
+
+/* a + 2p - b, for carried b, as fsub. */
+constexpr felem fsub(const felem &a, const felem &b) {
+  felem out{};
+  out[0] = a[0] + ((limb{1} << 52) - 38) - b[0];
+  for (int i = 1; i < 5; ++i) out[i] = a[i] + ((limb{1} << 52) - 2) - b[i];
+  return out;
+}
+
+/* Carries t into five limbs, leaving the last carry in limb 1, as fmul and
+ * fsquare_times do. */
+constexpr felem freduce(uint128_t *t) {
+  felem out{};
+  limb c;
+
+  out[0] = static_cast<limb>(t[0]) & mask51;
+  c = static_cast<limb>(t[0] >> 51);
+  t[1] += c; out[1] = static_cast<limb>(t[1]) & mask51;
+  c = static_cast<limb>(t[1] >> 51);
+  t[2] += c; out[2] = static_cast<limb>(t[2]) & mask51;
+  c = static_cast<limb>(t[2] >> 51);
+  t[3] += c; out[3] = static_cast<limb>(t[3]) & mask51;
+  c = static_cast<limb>(t[3] >> 51);
+  t[4] += c; out[4] = static_cast<limb>(t[4]) & mask51;
+  c = static_cast<limb>(t[4] >> 51);
+  out[0] += c * 19;
+  out[1] += out[0] >> 51;
+  out[0] &= mask51;
+  return out;
+}
+
+/* Carried output, as fmul. */
+constexpr felem fmul(const felem &s, const felem &r) {
+  const limb r1 = r[1] * 19, r2 = r[2] * 19, r3 = r[3] * 19, r4 = r[4] * 19;
+  uint128_t t[5] = {
+      uint128_t{r[0]} * s[0] + uint128_t{r4} * s[1] + uint128_t{r1} * s[4] +
+          uint128_t{r2} * s[3] + uint128_t{r3} * s[2],
+      uint128_t{r[0]} * s[1] + uint128_t{r[1]} * s[0] + uint128_t{r4} * s[2] +
+          uint128_t{r2} * s[4] + uint128_t{r3} * s[3],
+      uint128_t{r[0]} * s[2] + uint128_t{r[2]} * s[0] + uint128_t{r[1]} * s[1] +
+          uint128_t{r4} * s[3] + uint128_t{r3} * s[4],
+      uint128_t{r[0]} * s[3] + uint128_t{r[3]} * s[0] + uint128_t{r[1]} * s[2] +
+          uint128_t{r[2]} * s[1] + uint128_t{r4} * s[4],
+      uint128_t{r[0]} * s[4] + uint128_t{r[4]} * s[0] + uint128_t{r[3]} * s[1] +
+          uint128_t{r[1]} * s[3] + uint128_t{r[2]} * s[2]};
+  return freduce(t);
+}
+
+/* in^(2^count), carried, as fsquare_times. */
+constexpr felem fsquare_times(felem r, int count) {
+  while (count--) {
+    const limb d0 = r[0] * 2, d1 = r[1] * 2, d2 = r[2] * 2 * 19;
+    const limb d419 = r[4] * 19, d4 = d419 * 2;
+    uint128_t t[5] = {
+        uint128_t{r[0]} * r[0] + uint128_t{d4} * r[1] + uint128_t{d2} * r[3],
+        uint128_t{d0} * r[1] + uint128_t{d4} * r[2] +
+            uint128_t{r[3]} * (r[3] * 19),
+        uint128_t{d0} * r[2] + uint128_t{r[1]} * r[1] + uint128_t{d4} * r[3],
+        uint128_t{d0} * r[3] + uint128_t{d1} * r[2] + uint128_t{r[4]} * d419,
+        uint128_t{d0} * r[4] + uint128_t{d1} * r[3] + uint128_t{r[2]} * r[2]};
+    r = freduce(t);
+  }
+  return r;
+}
+
+constexpr limb load_limb(const bytes &in, int offset) {
+  limb r = 0;
+  for (int i = 7; i >= 0; --i) r = (r << 8) | in[offset + i];
+  return r;
+}
+
+constexpr felem fexpand(const bytes &in) {
+  return {load_limb(in, 0) & mask51, (load_limb(in, 6) >> 3) & mask51,
+          (load_limb(in, 12) >> 6) & mask51, (load_limb(in, 19) >> 1) & mask51,
+          (load_limb(in, 24) >> 12) & mask51};
+}
+
+/* Carries t once around, as the steps of fcontract. */
+constexpr void fcarry(uint128_t *t) {
+  for (int i = 0; i < 4; ++i) {
+    t[i + 1] += t[i] >> 51;
+    t[i] &= mask51;
+  }
+  t[0] += 19 * (t[4] >> 51);
+  t[4] &= mask51;
+}
+
+constexpr bytes fcontract(const felem &input) {
+  uint128_t t[5] = {input[0], input[1], input[2], input[3], input[4]};
+  bytes out{};
+
+  fcarry(t);
+  fcarry(t);
+  /* Between 0 and 2^255-1; offset by 19 to catch 2^255-19 and above. */
+  t[0] += 19;
+  fcarry(t);
+  t[0] += 0x8000000000000 - 19;
+  for (int i = 1; i < 5; ++i) t[i] += 0x8000000000000 - 1;
+  /* Between 2^255 and 2^256-20, offset by 2^255, which is dropped. */
+  for (int i = 0; i < 4; ++i) {
+    t[i + 1] += t[i] >> 51;
+    t[i] &= mask51;
+  }
+  t[4] &= mask51;
+
+  const limb l[4] = {
+      static_cast<limb>(t[0] | (t[1] << 51)),
+      static_cast<limb>((t[1] >> 13) | (t[2] << 38)),
+      static_cast<limb>((t[2] >> 26) | (t[3] << 25)),
+      static_cast<limb>((t[3] >> 39) | (t[4] << 12))};
+  for (int i = 0; i < 32; ++i) out[i] = (l[i / 8] >> (8 * (i % 8))) & 0xff;
+  return out;
+}
+
+/* z^(p-2), with crecip's chain. */
+constexpr felem crecip(const felem &z) {
+  felem a, t0, b, c;
+
+  a = fsquare_times(z, 1);
+  t0 = fsquare_times(a, 2);
+  b = fmul(t0, z);
+  a = fmul(b, a);
+  t0 = fsquare_times(a, 1);
+  b = fmul(t0, b);
+  t0 = fsquare_times(b, 5);
+  b = fmul(t0, b);
+  t0 = fsquare_times(b, 10);
+  c = fmul(t0, b);
+  t0 = fsquare_times(c, 20);
+  t0 = fmul(t0, c);
+  t0 = fsquare_times(t0, 10);
+  b = fmul(t0, b);
+  t0 = fsquare_times(b, 50);
+  c = fmul(t0, b);
+  t0 = fsquare_times(c, 100);
+  t0 = fmul(t0, c);
+  t0 = fsquare_times(t0, 50);
+  t0 = fmul(t0, b);
+  t0 = fsquare_times(t0, 5);
+  return fmul(t0, a);
+}
+
+constexpr void swap_conditional(felem &a, felem &b, limb iswap) {
+  const limb swap = -iswap;
+  for (int i = 0; i < 5; ++i) {
+    const limb x = swap & (a[i] ^ b[i]);
+    a[i] ^= x;
+    b[i] ^= x;
+  }
+}
+
+/* The ladder of cmult and fmonty, returning the affine result. */
+constexpr felem cmult(const bytes &n, const felem &q) {
+  const felem a24 = {121665, 0, 0, 0, 0};
+  felem x = {1}, z{}, xp = q, zp = {1};
+
+  for (int i = 255; i >= 0; --i) {
+    const limb bit = (n[i >> 3] >> (i & 7)) & 1;
+    swap_conditional(x, xp, bit);
+    swap_conditional(z, zp, bit);
+
+    const felem a = fadd(x, z), b = fsub(x, z);
+    const felem c = fadd(xp, zp), d = fsub(xp, zp);
+    const felem da = fmul(d, a), cb = fmul(c, b);
+    const felem aa = fsquare_times(a, 1), bb = fsquare_times(b, 1);
+    const felem e = fsub(aa, bb);
+
+    xp = fsquare_times(fadd(da, cb), 1);
+    zp = fmul(fsquare_times(fsub(da, cb), 1), q);
+    x = fmul(aa, bb);
+    z = fmul(e, fadd(fmul(e, a24), aa));
+
+    swap_conditional(x, xp, bit);
+    swap_conditional(z, zp, bit);
+  }
+  return fmul(x, crecip(z));
+}
+
+constexpr std::uint8_t hex_digit(char c) {
+  return c >= '0' && c <= '9' ? c - '0'
+       : c >= 'a' && c <= 'f' ? c - 'a' + 10
+       : c >= 'A' && c <= 'F' ? c - 'A' + 10
+       : throw "not a hex digit";
+}
+
+}  // namespace detail
+
+/* Returns curve25519_donna(secret, basepoint). */
+constexpr bytes x25519(const bytes &secret, const bytes &basepoint) {
+  bytes e = secret;
+  e[0] &= 248;
+  e[31] &= 127;
+  e[31] |= 64;
+  return detail::fcontract(detail::cmult(e, detail::fexpand(basepoint)));
+}
+
+/* Returns the public key of secret. */
+constexpr bytes public_key(const bytes &secret) {
+  return x25519(secret, bytes{9});
+}
+
+/* Parses 64 hex digits. A bad digit is a compile error in a constant
+ * expression. */
+consteval bytes from_hex(const char (&hex)[65]) {
+  bytes out{};
+  for (int i = 0; i < 32; ++i) {
+    out[i] = (detail::hex_digit(hex[2 * i]) << 4) |
+             detail::hex_digit(hex[2 * i + 1]);
+  }
+  return out;
+}
+
+}  // namespace compile_time
+}  // namespace curve25519
+
+#endif  // CURVE25519_DONNA_CONSTEXPR_HPP
@@ -0,0 +1,299 @@
+/* curve25519-donna: asynchronous submission/completion engine
+ *
+ * Code released into the public domain.
+ *
+ * Jobs travel through two lock-free rings (see curve25519-donna-ring.h) as
+ * pointers: callers push onto the submission ring, workers pop from it into a
+ * private batch, run the batch and push the jobs onto the completion ring.
+ *
+ * A worker with an empty batch sleeps until a job arrives. A worker with a
+ * partial batch sleeps until the oldest job in it reaches the deadline, or
+ * until enough jobs are queued to fill it. Before sleeping a worker lowers
+ * want to the queue depth it waits for, and a submitter that sees the queue
+ * reach want wakes the workers and resets it.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-engine.h"
+#include "curve25519-donna-ring.h"
+
+typedef uint8_t u8;
+
+/* Jobs handed to curve25519_donna_batch at once. This matches the number of
+ * elements that share an inversion there. */
+#define ENGINE_BATCH 32
+
+struct curve25519_engine {
+  struct ring submitted;  /* of struct curve25519_job * */
+  struct ring completed;  /* of struct curve25519_job * */
+  _Alignas(64) atomic_size_t in_flight;
+  atomic_uint_fast64_t ncompleted;
+  atomic_uint_fast64_t batches;
+  atomic_uint_fast64_t latency_nsec;
+  atomic_uint_fast64_t max_latency_nsec;
+  atomic_uint_fast64_t latency_log2[40];
+  atomic_size_t want;  /* least depth a sleeping worker waits for */
+  atomic_int stop;
+
+  uint64_t deadline_nsec;
+  int fd;
+
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  unsigned nworkers;
+  pthread_t *workers;
+};
+
+static uint64_t
+time_nsec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static void
+record_latency(struct curve25519_engine *engine, uint64_t latency) {
+  uint64_t max;
+  unsigned bucket = 0;
+
+  while (bucket < 39 && (latency >> (bucket + 1)) != 0) bucket++;
+  atomic_fetch_add_explicit(&engine->latency_log2[bucket], 1,
+                            memory_order_relaxed);
+  atomic_fetch_add_explicit(&engine->latency_nsec, latency,
+                            memory_order_relaxed);
+
+  max = atomic_load_explicit(&engine->max_latency_nsec, memory_order_relaxed);
+  while (latency > max &&
+         !atomic_compare_exchange_weak_explicit(&engine->max_latency_nsec,
+                                                &max, latency,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+}
+
+static void
+run_batch(struct curve25519_engine *engine, struct curve25519_job **batch,
+          unsigned n) {
+  static const u8 basepoint[32] = {9};
+  u8 secrets[ENGINE_BATCH * 32], points[ENGINE_BATCH * 32],
+     results[ENGINE_BATCH * 32];
+  uint64_t now;
+  unsigned i;
+
+  if (n == 0) return;
+  for (i = 0; i < n; ++i) {
+    memcpy(secrets + 32 * i, batch[i]->secret, 32);
+    memcpy(points + 32 * i,
+           batch[i]->op == CURVE25519_JOB_SHARED ? batch[i]->peer : basepoint,
+           32);
+  }
+  curve25519_donna_batch(results, secrets, points, n);
+  ring_wipe(secrets, sizeof(secrets));
+
+  now = time_nsec();
+  for (i = 0; i < n; ++i) {
+    memcpy(batch[i]->result, results + 32 * i, 32);
+    record_latency(engine, now - batch[i]->submit_nsec);
+    /* The completion ring is as large as the number of jobs that may be in
+     * flight, so this cannot fail. */
+    ring_push(&engine->completed, &batch[i]);
+  }
+  ring_wipe(results, sizeof(results));
+
+  atomic_fetch_add_explicit(&engine->ncompleted, n, memory_order_relaxed);
+  atomic_fetch_add_explicit(&engine->batches, 1, memory_order_relaxed);
+  {
+    const uint64_t count = n;
+    ssize_t ret;
+    do {
+      ret = write(engine->fd, &count, sizeof(count));
+    } while (ret < 0 && errno == EINTR);
+  }
+}
+
+static void *
+engine_worker(void *arg) {
+  struct curve25519_engine *engine = arg;
+  struct curve25519_job *batch[ENGINE_BATCH];
+  unsigned n = 0;
+
+  while (!atomic_load(&engine->stop)) {
+    while (n < ENGINE_BATCH && ring_pop(&engine->submitted, &batch[n]) == 0) {
+      n++;
+    }
+
+    if (n == ENGINE_BATCH ||
+        (n > 0 && time_nsec() - batch[0]->submit_nsec >=
+                  engine->deadline_nsec)) {
+      run_batch(engine, batch, n);
+      n = 0;
+      continue;
+    }
+
+    /* Sleep until the queue holds one job, which starts a deadline, or the
+     * jobs that fill the batch. want is lowered before the ring is checked
+     * and curve25519_engine_submit checks want after pushing, so however many
+     * submitters race, one of them sees the depth this worker waits for. Only
+     * holders of the lock write want. */
+    {
+      const size_t need = n == 0 ? 1 : ENGINE_BATCH - n;
+
+      pthread_mutex_lock(&engine->lock);
+      if (need < atomic_load(&engine->want)) atomic_store(&engine->want, need);
+      if (!atomic_load(&engine->stop) &&
+          ring_size(&engine->submitted) < need) {
+        if (n == 0) {
+          pthread_cond_wait(&engine->wake, &engine->lock);
+        } else {
+          const uint64_t deadline =
+              batch[0]->submit_nsec + engine->deadline_nsec;
+          struct timespec ts;
+          ts.tv_sec = deadline / 1000000000;
+          ts.tv_nsec = deadline % 1000000000;
+          pthread_cond_timedwait(&engine->wake, &engine->lock, &ts);
+        }
+      }
+      pthread_mutex_unlock(&engine->lock);
+    }
+  }
+
+  return NULL;
+}
+
+struct curve25519_engine *
+curve25519_engine_new(size_t capacity, unsigned workers,
+                      uint64_t deadline_nsec) {
+  struct curve25519_engine *engine;
+  pthread_condattr_t attr;
+
+  if (capacity == 0 || workers == 0) return NULL;
+
+  if (posix_memalign((void **) &engine, 64,
+                     sizeof(struct curve25519_engine))) {
+    return NULL;
+  }
+  memset(engine, 0, sizeof(struct curve25519_engine));
+  engine->deadline_nsec = deadline_nsec;
+  atomic_init(&engine->want, SIZE_MAX);
+  engine->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (engine->fd < 0) {
+    free(engine);
+    return NULL;
+  }
+  if (ring_init(&engine->submitted, capacity,
+                sizeof(struct curve25519_job *)) ||
+      ring_init(&engine->completed, capacity,
+                sizeof(struct curve25519_job *))) {
+    ring_destroy(&engine->submitted);
+    close(engine->fd);
+    free(engine);
+    return NULL;
+  }
+
+  pthread_mutex_init(&engine->lock, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&engine->wake, &attr);
+  pthread_condattr_destroy(&attr);
+
+  engine->workers = calloc(workers, sizeof(pthread_t));
+  if (!engine->workers) {
+    curve25519_engine_free(engine);
+    return NULL;
+  }
+  for (; engine->nworkers < workers; ++engine->nworkers) {
+    if (pthread_create(&engine->workers[engine->nworkers], NULL,
+                       engine_worker, engine)) {
+      curve25519_engine_free(engine);
+      return NULL;
+    }
+  }
+
+  return engine;
+}
+
+void
+curve25519_engine_free(struct curve25519_engine *engine) {
+  unsigned i;
+
+  if (!engine) return;
+  atomic_store(&engine->stop, 1);
+  pthread_mutex_lock(&engine->lock);
+  pthread_cond_broadcast(&engine->wake);
+  pthread_mutex_unlock(&engine->lock);
+  for (i = 0; i < engine->nworkers; ++i) {
+    pthread_join(engine->workers[i], NULL);
+  }
+
+  pthread_cond_destroy(&engine->wake);
+  pthread_mutex_destroy(&engine->lock);
+  ring_destroy(&engine->submitted);
+  ring_destroy(&engine->completed);
+  close(engine->fd);
+  free(engine->workers);
+  free(engine);
+}
+
+int
+curve25519_engine_submit(struct curve25519_engine *engine,
+                         struct curve25519_job *job) {
+  if (atomic_fetch_add(&engine->in_flight, 1) >=
+      ring_capacity(&engine->submitted)) {
+    atomic_fetch_sub(&engine->in_flight, 1);
+    return -1;
+  }
+
+  job->submit_nsec = time_nsec();
+  ring_push(&engine->submitted, &job);
+
+  /* Wake the workers once the queue is as deep as one of them waits for.
+   * Each goes back to sleep with a fresh want if it still lacks jobs. */
+  if (ring_size(&engine->submitted) >= atomic_load(&engine->want)) {
+    pthread_mutex_lock(&engine->lock);
+    atomic_store(&engine->want, SIZE_MAX);
+    pthread_cond_broadcast(&engine->wake);
+    pthread_mutex_unlock(&engine->lock);
+  }
+
+  return 0;
+}
+
+struct curve25519_job *
+curve25519_engine_poll(struct curve25519_engine *engine) {
+  struct curve25519_job *job;
+
+  if (ring_pop(&engine->completed, &job)) return NULL;
+  atomic_fetch_sub(&engine->in_flight, 1);
+  return job;
+}
+
+int
+curve25519_engine_fd(const struct curve25519_engine *engine) {
+  return engine->fd;
+}
+
+void
+curve25519_engine_stats(struct curve25519_engine *engine,
+                        struct curve25519_engine_stats *stats) {
+  unsigned i;
+
+  stats->queue_depth = ring_size(&engine->submitted);
+  stats->in_flight = atomic_load(&engine->in_flight);
+  stats->completed = atomic_load(&engine->ncompleted);
+  stats->batches = atomic_load(&engine->batches);
+  stats->batch_capacity = stats->batches * ENGINE_BATCH;
+  stats->latency_nsec = atomic_load(&engine->latency_nsec);
+  stats->max_latency_nsec = atomic_load(&engine->max_latency_nsec);
+  for (i = 0; i < 40; ++i) {
+    stats->latency_log2[i] = atomic_load(&engine->latency_log2[i]);
+  }
+}
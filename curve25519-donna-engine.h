@@ -0,0 +1,88 @@
+/* curve25519-donna: asynchronous submission/completion engine
+ *
+ * Code released into the public domain.
+ *
+ * The engine lets event-loop threads hand scalar multiplications to worker
+ * threads without blocking. Callers push jobs onto a submission ring and later
+ * collect them from a completion ring, either by polling or by waiting for the
+ * engine's eventfd to become readable. Workers coalesce pending jobs into
+ * batches for curve25519_donna_batch, and flush a partial batch once its
+ * oldest job has waited for the engine's deadline, so batching never adds
+ * more than that to a job's latency.
+ */
+
+#ifndef CURVE25519_DONNA_ENGINE_H
+#define CURVE25519_DONNA_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct curve25519_engine;
+
+enum curve25519_job_op {
+  CURVE25519_JOB_KEYGEN,  /* result = public key for secret */
+  CURVE25519_JOB_SHARED,  /* result = shared key for secret and peer */
+};
+
+/* A job is owned by the engine from curve25519_engine_submit until it is
+ * returned by curve25519_engine_poll, and must not be touched in between. */
+struct curve25519_job {
+  enum curve25519_job_op op;
+  uint8_t secret[32];
+  uint8_t peer[32];     /* CURVE25519_JOB_SHARED only */
+  uint8_t result[32];
+  void *user_data;      /* not used by the engine */
+  uint64_t submit_nsec; /* set by the engine */
+};
+
+struct curve25519_engine_stats {
+  size_t queue_depth;      /* jobs submitted but not yet picked up */
+  size_t in_flight;        /* jobs submitted but not yet polled */
+  uint64_t completed;      /* jobs completed */
+  uint64_t batches;        /* calls to curve25519_donna_batch */
+  uint64_t batch_capacity; /* jobs those batches could have held */
+  uint64_t latency_nsec;   /* total submit-to-completion time */
+  uint64_t max_latency_nsec;
+  /* latency_log2[i] counts jobs whose latency was in [2^i, 2^(i+1)) ns. */
+  uint64_t latency_log2[40];
+};
+
+/* Creates an engine that accepts up to capacity jobs in flight (rounded up to
+ * a power of two), served by the given number of worker threads. A partial
+ * batch is flushed once its oldest job is deadline_nsec old. Returns NULL on
+ * failure. */
+struct curve25519_engine *curve25519_engine_new(size_t capacity,
+                                                unsigned workers,
+                                                uint64_t deadline_nsec);
+
+/* Stops the workers and frees the engine. Jobs that are still in flight are
+ * abandoned. */
+void curve25519_engine_free(struct curve25519_engine *engine);
+
+/* Queues a job. Returns 0 on success or -1 if capacity jobs are in flight. */
+int curve25519_engine_submit(struct curve25519_engine *engine,
+                             struct curve25519_job *job);
+
+/* Returns a completed job, or NULL if there is none. */
+struct curve25519_job *curve25519_engine_poll(
+    struct curve25519_engine *engine);
+
+/* Returns an eventfd that is readable while completed jobs are waiting to be
+ * polled. Read it (8 bytes) to reset it before polling. */
+int curve25519_engine_fd(const struct curve25519_engine *engine);
+
+/* Fills in a snapshot of the engine's counters. The batch fill ratio is
+ * completed / batch_capacity and the mean latency is latency_nsec /
+ * completed. */
+void curve25519_engine_stats(struct curve25519_engine *engine,
+                             struct curve25519_engine_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* CURVE25519_DONNA_ENGINE_H */
@@ -0,0 +1,22 @@
+/* curve25519-donna: helpers shared by the library's .c files
+ *
+ * Code released into the public domain.
+ *
+ * This header is internal and is only included by the library's .c files.
+ */
+
+#ifndef CURVE25519_DONNA_INTERNAL_H
+#define CURVE25519_DONNA_INTERNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* A memset that the compiler cannot elide, for wiping secrets. */
+static void *(*const volatile donna_memset)(void *, int, size_t) = memset;
+
+/* Fills out with len bytes from the system's random number generator.
+ * Returns 0, or -1 with errno set. Defined in curve25519-donna-c64.c. */
+int curve25519_donna_random_bytes(uint8_t *out, size_t len);
+
+#endif  /* CURVE25519_DONNA_INTERNAL_H */
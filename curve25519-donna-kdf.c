@@ -0,0 +1,310 @@
+/* curve25519-donna: shared keys hashed where they are computed
+ *
+ * Code released into the public domain.
+ *
+ * HMAC (RFC 2104) and HKDF (RFC 5869) over the library's own SHA-256 and
+ * SHA-512.
+ */
+
+#include <string.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-internal.h"
+#include "curve25519-donna-kdf.h"
+#include "curve25519-donna-sha256.h"
+#include "curve25519-donna-sha512.h"
+
+typedef uint8_t u8;
+
+/* The number of shared secrets that curve25519_kdf_hkdf_batch computes at a
+ * time. */
+#define KDF_BATCH 32
+
+/* The number of chains that curve25519_kdf_path walks together. Each step
+ * takes two scalar multiplications per chain, which makes one full batch. */
+#define PATH_BATCH 16
+
+#define MAX_HASH_SIZE 64
+#define MAX_BLOCK_SIZE 128
+
+union hash_ctx {
+  struct curve25519_donna_sha256_ctx sha256;
+  struct curve25519_donna_sha512_ctx sha512;
+};
+
+struct hmac_ctx {
+  enum curve25519_kdf_hash hash;
+  union hash_ctx inner, outer;
+};
+
+size_t
+curve25519_kdf_hash_size(enum curve25519_kdf_hash hash) {
+  switch (hash) {
+    case CURVE25519_KDF_SHA256: return 32;
+    case CURVE25519_KDF_SHA512: return 64;
+  }
+  return 0;
+}
+
+static size_t
+hash_block_size(enum curve25519_kdf_hash hash) {
+  return hash == CURVE25519_KDF_SHA256 ? 64 : 128;
+}
+
+static void
+hash_init(union hash_ctx *ctx, enum curve25519_kdf_hash hash) {
+  if (hash == CURVE25519_KDF_SHA256) {
+    curve25519_donna_sha256_init(&ctx->sha256);
+  } else {
+    curve25519_donna_sha512_init(&ctx->sha512);
+  }
+}
+
+static void
+hash_update(union hash_ctx *ctx, enum curve25519_kdf_hash hash, const u8 *in,
+            size_t len) {
+  if (hash == CURVE25519_KDF_SHA256) {
+    curve25519_donna_sha256_update(&ctx->sha256, in, len);
+  } else {
+    curve25519_donna_sha512_update(&ctx->sha512, in, len);
+  }
+}
+
+/* Writes the digest and wipes ctx. */
+static void
+hash_final(union hash_ctx *ctx, enum curve25519_kdf_hash hash, u8 *out) {
+  if (hash == CURVE25519_KDF_SHA256) {
+    curve25519_donna_sha256_final(&ctx->sha256, out);
+  } else {
+    curve25519_donna_sha512_final(&ctx->sha512, out);
+  }
+}
+
+static void
+hmac_init(struct hmac_ctx *ctx, enum curve25519_kdf_hash hash, const u8 *key,
+          size_t keylen) {
+  const size_t block = hash_block_size(hash);
+  u8 pad[MAX_BLOCK_SIZE];
+  size_t i;
+
+  ctx->hash = hash;
+  memset(pad, 0, block);
+  if (keylen > block) {
+    hash_init(&ctx->inner, hash);
+    hash_update(&ctx->inner, hash, key, keylen);
+    hash_final(&ctx->inner, hash, pad);
+  } else if (keylen) {
+    memcpy(pad, key, keylen);
+  }
+
+  for (i = 0; i < block; ++i) pad[i] ^= 0x36;
+  hash_init(&ctx->inner, hash);
+  hash_update(&ctx->inner, hash, pad, block);
+  for (i = 0; i < block; ++i) pad[i] ^= 0x36 ^ 0x5c;
+  hash_init(&ctx->outer, hash);
+  hash_update(&ctx->outer, hash, pad, block);
+  donna_memset(pad, 0, sizeof(pad));
+}
+
+static void
+hmac_update(struct hmac_ctx *ctx, const u8 *in, size_t len) {
+  hash_update(&ctx->inner, ctx->hash, in, len);
+}
+
+/* Writes the MAC and wipes ctx. */
+static void
+hmac_final(struct hmac_ctx *ctx, u8 *out) {
+  u8 inner[MAX_HASH_SIZE];
+
+  hash_final(&ctx->inner, ctx->hash, inner);
+  hash_update(&ctx->outer, ctx->hash, inner,
+              curve25519_kdf_hash_size(ctx->hash));
+  hash_final(&ctx->outer, ctx->hash, out);
+  donna_memset(inner, 0, sizeof(inner));
+}
+
+/* Returns 1 if the 32 bytes of s are all zero, in constant time. */
+static int
+all_zero(const u8 *s) {
+  unsigned acc = 0, i;
+
+  for (i = 0; i < 32; ++i) acc |= s[i];
+  return (acc - 1) >> 8 & 1;
+}
+
+/* HKDF-Extract and HKDF-Expand of RFC 5869 with the 32-byte input key
+ * material ikm. The caller has checked hash and outlen. */
+static void
+hkdf(u8 *out, size_t outlen, enum curve25519_kdf_hash hash, const u8 *ikm,
+     const u8 *salt, size_t saltlen, const u8 *info, size_t infolen) {
+  static const u8 zeros[MAX_HASH_SIZE] = {0};
+  const size_t size = curve25519_kdf_hash_size(hash);
+  struct hmac_ctx ctx;
+  u8 prk[MAX_HASH_SIZE], t[MAX_HASH_SIZE], counter;
+  size_t done, n;
+
+  if (!salt || !saltlen) {
+    salt = zeros;
+    saltlen = size;
+  }
+  hmac_init(&ctx, hash, salt, saltlen);
+  hmac_update(&ctx, ikm, 32);
+  hmac_final(&ctx, prk);
+
+  for (done = 0, counter = 1; done < outlen; done += n, ++counter) {
+    hmac_init(&ctx, hash, prk, size);
+    if (done) hmac_update(&ctx, t, size);
+    hmac_update(&ctx, info, infolen);
+    hmac_update(&ctx, &counter, 1);
+    hmac_final(&ctx, t);
+    n = outlen - done < size ? outlen - done : size;
+    memcpy(out + done, t, n);
+  }
+
+  donna_memset(prk, 0, sizeof(prk));
+  donna_memset(t, 0, sizeof(t));
+  donna_memset(&ctx, 0, sizeof(ctx));
+}
+
+static int
+hkdf_valid(size_t outlen, enum curve25519_kdf_hash hash) {
+  const size_t size = curve25519_kdf_hash_size(hash);
+  return size && outlen <= 255 * size;
+}
+
+int
+curve25519_kdf_hkdf(u8 *out, size_t outlen, enum curve25519_kdf_hash hash,
+                    const u8 *secret, const u8 *peer, const u8 *salt,
+                    size_t saltlen, const u8 *info, size_t infolen) {
+  u8 shared[32];
+  int ret = -1;
+
+  if (hkdf_valid(outlen, hash)) {
+    curve25519_donna(shared, secret, peer);
+    if (!all_zero(shared)) {
+      hkdf(out, outlen, hash, shared, salt, saltlen, info, infolen);
+      ret = 0;
+    }
+    donna_memset(shared, 0, sizeof(shared));
+  }
+  if (ret) memset(out, 0, outlen);
+  return ret;
+}
+
+int
+curve25519_kdf_hkdf_batch(u8 *out, size_t outlen,
+                          enum curve25519_kdf_hash hash, const u8 *secrets,
+                          const u8 *peers, size_t n, const u8 *salt,
+                          size_t saltlen, const u8 *info, size_t infolen) {
+  u8 shared[KDF_BATCH * 32];
+  size_t i, j, chunk;
+  int ret = 0;
+
+  if (!hkdf_valid(outlen, hash)) {
+    memset(out, 0, outlen * n);
+    return -1;
+  }
+
+  for (i = 0; i < n; i += chunk) {
+    chunk = n - i < KDF_BATCH ? n - i : KDF_BATCH;
+    curve25519_donna_batch(shared, secrets + 32 * i, peers + 32 * i, chunk);
+    for (j = 0; j < chunk; ++j) {
+      u8 *const o = out + outlen * (i + j);
+      if (all_zero(shared + 32 * j)) {
+        memset(o, 0, outlen);
+        ret = -1;
+        continue;
+      }
+      hkdf(o, outlen, hash, shared + 32 * j, salt, saltlen, info, infolen);
+    }
+  }
+
+  donna_memset(shared, 0, sizeof(shared));
+  return ret;
+}
+
+int
+curve25519_kdf_hash_shared(u8 *out, enum curve25519_kdf_hash hash,
+                           const u8 *secret, const u8 *peer, const u8 *prefix,
+                           size_t prefixlen) {
+  union hash_ctx ctx;
+  u8 shared[32];
+
+  if (!curve25519_kdf_hash_size(hash)) return -1;
+
+  curve25519_donna(shared, secret, peer);
+  hash_init(&ctx, hash);
+  hash_update(&ctx, hash, prefix, prefixlen);
+  hash_update(&ctx, hash, shared, 32);
+  hash_final(&ctx, hash, out);
+  donna_memset(shared, 0, sizeof(shared));
+  return 0;
+}
+
+int
+curve25519_kdf_path(u8 *secrets, u8 *publics, const u8 *leaves,
+                    const u8 *peers, size_t depth, size_t n,
+                    enum curve25519_kdf_hash hash, const u8 *salt,
+                    size_t saltlen, const u8 *info, size_t infolen) {
+  static const u8 nine[32] = {9};
+  const size_t stride = 32 * (depth + 1);
+  u8 scalars[2 * PATH_BATCH * 32], points[2 * PATH_BATCH * 32];
+  u8 out[2 * PATH_BATCH * 32];
+  unsigned failed[PATH_BATCH];
+  size_t c, i, j, chunk;
+  int ret = 0;
+
+  if (!curve25519_kdf_hash_size(hash)) {
+    memset(secrets, 0, stride * n);
+    memset(publics, 0, stride * n);
+    return -1;
+  }
+
+  for (c = 0; c < n; c += chunk) {
+    chunk = n - c < PATH_BATCH ? n - c : PATH_BATCH;
+    for (j = 0; j < chunk; ++j) {
+      memcpy(secrets + stride * (c + j), leaves + 32 * (c + j), 32);
+      failed[j] = 0;
+    }
+
+    for (i = 0; i <= depth; ++i) {
+      /* Pairs of (secret * 9, secret * peer), or only the public keys at the
+       * end of the chains. */
+      const unsigned per = i < depth ? 2 : 1;
+
+      for (j = 0; j < chunk; ++j) {
+        const u8 *const secret = secrets + stride * (c + j) + 32 * i;
+        memcpy(scalars + 32 * per * j, secret, 32);
+        memcpy(points + 32 * per * j, nine, 32);
+        if (per == 2) {
+          memcpy(scalars + 32 * (2 * j + 1), secret, 32);
+          memcpy(points + 32 * (2 * j + 1),
+                 peers + 32 * (depth * (c + j) + i), 32);
+        }
+      }
+      curve25519_donna_batch(out, scalars, points, per * chunk);
+
+      for (j = 0; j < chunk; ++j) {
+        u8 *const s = secrets + stride * (c + j) + 32 * i;
+        memcpy(publics + stride * (c + j) + 32 * i, out + 32 * per * j, 32);
+        if (per == 2) {
+          failed[j] |= all_zero(out + 32 * (2 * j + 1));
+          hkdf(s + 32, 32, hash, out + 32 * (2 * j + 1), salt, saltlen, info,
+               infolen);
+        }
+      }
+    }
+
+    for (j = 0; j < chunk; ++j) {
+      if (failed[j]) {
+        memset(secrets + stride * (c + j), 0, stride);
+        memset(publics + stride * (c + j), 0, stride);
+        ret = -1;
+      }
+    }
+  }
+
+  donna_memset(scalars, 0, sizeof(scalars));
+  donna_memset(out, 0, sizeof(out));
+  return ret;
+}
@@ -0,0 +1,89 @@
+/* curve25519-donna: shared keys hashed where they are computed
+ *
+ * Code released into the public domain.
+ *
+ * The output of curve25519_donna is not a uniformly random key and must be
+ * hashed before use. These functions compute it and hash it in one call, so
+ * the raw shared secret only ever exists on the library's stack, which is
+ * wiped before they return.
+ */
+
+#ifndef CURVE25519_DONNA_KDF_H
+#define CURVE25519_DONNA_KDF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum curve25519_kdf_hash {
+  CURVE25519_KDF_SHA256,  /* 32-byte output */
+  CURVE25519_KDF_SHA512,  /* 64-byte output */
+};
+
+/* Returns the output size of hash in bytes, or 0 if hash is unknown. */
+size_t curve25519_kdf_hash_size(enum curve25519_kdf_hash hash);
+
+/* Computes out = HKDF(salt, shared, info), with HKDF as in RFC 5869 over the
+ * given hash, and shared = curve25519_donna(secret, peer). A NULL salt, with
+ * saltlen 0, is a string of zeros as long as the hash output. Returns 0, or
+ * -1 with out zeroed if outlen is over 255 times the hash output size, hash
+ * is unknown, or the shared secret is all zeros, which happens exactly when
+ * peer is a point of small order (RFC 7748, section 6.1). */
+int curve25519_kdf_hkdf(uint8_t *out, size_t outlen,
+                        enum curve25519_kdf_hash hash, const uint8_t *secret,
+                        const uint8_t *peer, const uint8_t *salt,
+                        size_t saltlen, const uint8_t *info, size_t infolen);
+
+/* Derives n keys of outlen bytes each, the i-th from secrets[i] and
+ * peers[i] (arrays of n 32-byte values) like curve25519_kdf_hkdf, with the
+ * scalar multiplications done by curve25519_donna_batch. Returns 0, or -1
+ * if any derivation failed, with the outputs of the failed ones zeroed. */
+int curve25519_kdf_hkdf_batch(uint8_t *out, size_t outlen,
+                              enum curve25519_kdf_hash hash,
+                              const uint8_t *secrets, const uint8_t *peers,
+                              size_t n, const uint8_t *salt, size_t saltlen,
+                              const uint8_t *info, size_t infolen);
+
+/* Computes out = hash(prefix || curve25519_donna(secret, peer)), which is
+ * what the Python binding does with the prefix "curve25519-shared:". Unlike
+ * the HKDF functions, this accepts peers of small order, to give the same
+ * results as hashing the shared secret by hand. Returns 0, or -1 if hash is
+ * unknown. */
+int curve25519_kdf_hash_shared(uint8_t *out, enum curve25519_kdf_hash hash,
+                               const uint8_t *secret, const uint8_t *peer,
+                               const uint8_t *prefix, size_t prefixlen);
+
+/* Walks n chains of Diffie-Hellman steps in which each shared key is hashed
+ * into the next step's secret, such as the path from a leaf to the root of an
+ * asynchronous ratcheting tree, where peers are the public keys of the
+ * copath, or the DH ratchet of a Double Ratchet session. For each chain,
+ *
+ *   secrets[0]   = leaf
+ *   secrets[i+1] = HKDF(salt, curve25519_donna(secrets[i], peers[i]), info)
+ *   publics[i]   = curve25519_donna(secrets[i], {9})
+ *
+ * for i < depth, with HKDF truncated to 32 bytes, and publics[depth] is the
+ * public key of the last secret. secrets and publics are arrays of n chains of
+ * depth + 1 32-byte values, leaves one of n 32-byte values and peers one of n
+ * chains of depth 32-byte values.
+ *
+ * The public key and the shared key of a step depend only on its secret, and
+ * different chains do not depend on each other, so all the scalar
+ * multiplications of one step of up to 16 chains are computed together, with
+ * one shared inversion, and hashed before the next step. Returns 0, or -1 if
+ * hash is unknown or some shared key is all zeros, in which case the secrets
+ * and public keys of the chains that failed are zeroed. */
+int curve25519_kdf_path(uint8_t *secrets, uint8_t *publics,
+                        const uint8_t *leaves, const uint8_t *peers,
+                        size_t depth, size_t n, enum curve25519_kdf_hash hash,
+                        const uint8_t *salt, size_t saltlen,
+                        const uint8_t *info, size_t infolen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* CURVE25519_DONNA_KDF_H */
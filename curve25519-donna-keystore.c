@@ -0,0 +1,336 @@
+/* curve25519-donna: memory-mapped store of static keys
+ *
+ * Code released into the public domain.
+ *
+ * File layout, all integers little endian:
+ *
+ *   header, 64 bytes:
+ *     0   magic "c25519ks"
+ *     8   version (u32, 1)
+ *     12  record size (u32, 72)
+ *     16  number of keys (u64)
+ *     24  offset of the records (u64)
+ *     32  offset of the public key index (u64)
+ *     40  file size (u64)
+ *     48  reserved, zero
+ *
+ *   records, sorted by ID, 72 bytes each:
+ *     0   ID (u64)
+ *     8   clamped secret
+ *     40  public key
+ *
+ *   public key index, sorted by public key, 16 bytes per key:
+ *     0   first eight bytes of the public key
+ *     8   record number (u64)
+ *
+ * The index entries carry a prefix of the public key so that the binary
+ * search only touches records to settle ties, which are rare.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-internal.h"
+#include "curve25519-donna-keystore.h"
+
+typedef uint8_t u8;
+
+#define KEYSTORE_MAGIC "c25519ks"
+#define KEYSTORE_VERSION 1
+#define HEADER_SIZE 64
+#define RECORD_SIZE 72
+#define INDEX_SIZE 16
+
+struct curve25519_keystore {
+  const u8 *map;
+  size_t size;
+  uint64_t count;
+  const u8 *records;
+  const u8 *index;
+};
+
+static uint64_t
+load_le64(const u8 *in) {
+  uint64_t r = 0;
+  int i;
+
+  for (i = 7; i >= 0; --i) r = (r << 8) | in[i];
+  return r;
+}
+
+static void
+store_le64(u8 *out, uint64_t in) {
+  unsigned i;
+
+  for (i = 0; i < 8; ++i) out[i] = in >> (8 * i);
+}
+
+static int
+compare_records(const void *a, const void *b) {
+  const uint64_t x = load_le64(a), y = load_le64(b);
+  return x < y ? -1 : x > y;
+}
+
+/* Index entries are sorted by public key, and only hold a prefix of it, so
+ * the comparison needs the records to break ties. */
+static int
+compare_index(const void *a, const void *b, void *records) {
+  const u8 *const r = records;
+  const int c = memcmp(a, b, 8);
+  if (c) return c;
+  return memcmp(r + RECORD_SIZE * load_le64((const u8 *) a + 8) + 40,
+                r + RECORD_SIZE * load_le64((const u8 *) b + 8) + 40, 32);
+}
+
+static int
+write_all(int fd, const u8 *buf, size_t len) {
+  while (len > 0) {
+    const ssize_t n = write(fd, buf, len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+int
+curve25519_keystore_write(const char *path, const uint64_t *ids,
+                          const u8 *secrets, size_t n) {
+  const size_t records_size = RECORD_SIZE * n, index_size = INDEX_SIZE * n;
+  u8 header[HEADER_SIZE], *records, *index;
+  char *tmp_path;
+  u8 publics[32 * 32];
+  size_t i, j, chunk;
+  int fd, saved_errno;
+
+  if (n > SIZE_MAX / (RECORD_SIZE + INDEX_SIZE)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  records = malloc(records_size + index_size + 1);
+  tmp_path = malloc(strlen(path) + 8);
+  if (!records || !tmp_path) {
+    free(records);
+    free(tmp_path);
+    errno = ENOMEM;
+    return -1;
+  }
+  index = records + records_size;
+
+  for (i = 0; i < n; i += chunk) {
+    chunk = n - i < 32 ? n - i : 32;
+    curve25519_donna_batch(publics, secrets + 32 * i, NULL, chunk);
+    for (j = 0; j < chunk; ++j) {
+      u8 *const r = records + RECORD_SIZE * (i + j);
+      store_le64(r, ids[i + j]);
+      memcpy(r + 8, secrets + 32 * (i + j), 32);
+      r[8] &= 248;
+      r[8 + 31] &= 127;
+      r[8 + 31] |= 64;
+      memcpy(r + 40, publics + 32 * j, 32);
+    }
+  }
+  donna_memset(publics, 0, sizeof(publics));
+
+  qsort(records, n, RECORD_SIZE, compare_records);
+  for (i = 0; i + 1 < n; ++i) {
+    if (load_le64(records + RECORD_SIZE * i) ==
+        load_le64(records + RECORD_SIZE * (i + 1))) {
+      saved_errno = EINVAL;
+      goto err;
+    }
+  }
+
+  for (i = 0; i < n; ++i) {
+    memcpy(index + INDEX_SIZE * i, records + RECORD_SIZE * i + 40, 8);
+    store_le64(index + INDEX_SIZE * i + 8, i);
+  }
+  qsort_r(index, n, INDEX_SIZE, compare_index, records);
+
+  memset(header, 0, sizeof(header));
+  memcpy(header, KEYSTORE_MAGIC, 8);
+  header[8] = KEYSTORE_VERSION;
+  header[12] = RECORD_SIZE;
+  store_le64(header + 16, n);
+  store_le64(header + 24, HEADER_SIZE);
+  store_le64(header + 32, HEADER_SIZE + records_size);
+  store_le64(header + 40, HEADER_SIZE + records_size + index_size);
+
+  /* Write to a temporary file and rename it into place, so that readers see
+   * either the old store or the new one. mkostemp creates a fresh file with
+   * O_EXCL, so a symlink planted at the temporary name is never followed. */
+  sprintf(tmp_path, "%s.XXXXXX", path);
+  fd = mkostemp(tmp_path, O_CLOEXEC);
+  if (fd < 0) {
+    saved_errno = errno;
+    goto err;
+  }
+  if (write_all(fd, header, sizeof(header)) ||
+      write_all(fd, records, records_size + index_size) || fsync(fd)) {
+    saved_errno = errno;
+    close(fd);
+    unlink(tmp_path);
+    goto err;
+  }
+  close(fd);
+  if (rename(tmp_path, path)) {
+    saved_errno = errno;
+    unlink(tmp_path);
+    goto err;
+  }
+
+  donna_memset(records, 0, records_size);
+  free(records);
+  free(tmp_path);
+  return 0;
+
+err:
+  donna_memset(records, 0, records_size);
+  free(records);
+  free(tmp_path);
+  errno = saved_errno;
+  return -1;
+}
+
+struct curve25519_keystore *
+curve25519_keystore_open(const char *path) {
+  struct curve25519_keystore *ks;
+  struct stat st;
+  uint64_t count, records_off, index_off, size;
+  const u8 *map;
+  int fd, saved_errno;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return NULL;
+  if (fstat(fd, &st)) {
+    saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return NULL;
+  }
+  if (st.st_size < HEADER_SIZE) {
+    close(fd);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  saved_errno = errno;
+  close(fd);
+  if (map == MAP_FAILED) {
+    errno = saved_errno;
+    return NULL;
+  }
+
+  count = load_le64(map + 16);
+  records_off = load_le64(map + 24);
+  index_off = load_le64(map + 32);
+  size = load_le64(map + 40);
+  if (memcmp(map, KEYSTORE_MAGIC, 8) != 0 ||
+      map[8] != KEYSTORE_VERSION || map[9] || map[10] || map[11] ||
+      map[12] != RECORD_SIZE || map[13] || map[14] || map[15] ||
+      size != (uint64_t) st.st_size ||
+      count > size / (RECORD_SIZE + INDEX_SIZE) ||
+      records_off != HEADER_SIZE ||
+      index_off != records_off + RECORD_SIZE * count ||
+      size != index_off + INDEX_SIZE * count) {
+    munmap((void *) map, st.st_size);
+    errno = EINVAL;
+    return NULL;
+  }
+
+  ks = malloc(sizeof(struct curve25519_keystore));
+  if (!ks) {
+    munmap((void *) map, st.st_size);
+    errno = ENOMEM;
+    return NULL;
+  }
+  ks->map = map;
+  ks->size = st.st_size;
+  ks->count = count;
+  ks->records = map + records_off;
+  ks->index = map + index_off;
+  /* Lookups are binary searches, so readahead would be wasted. */
+  madvise((void *) map, st.st_size, MADV_RANDOM);
+  return ks;
+}
+
+void
+curve25519_keystore_close(struct curve25519_keystore *ks) {
+  if (!ks) return;
+  munmap((void *) ks->map, ks->size);
+  free(ks);
+}
+
+size_t
+curve25519_keystore_count(const struct curve25519_keystore *ks) {
+  return ks->count;
+}
+
+const u8 *
+curve25519_keystore_find(const struct curve25519_keystore *ks, uint64_t id,
+                         const u8 **public_key) {
+  uint64_t lo = 0, hi = ks->count;
+
+  while (lo < hi) {
+    const uint64_t mid = lo + (hi - lo) / 2;
+    const u8 *const r = ks->records + RECORD_SIZE * mid;
+    const uint64_t rid = load_le64(r);
+
+    if (rid == id) {
+      if (public_key) *public_key = r + 40;
+      return r + 8;
+    }
+    if (rid < id) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return NULL;
+}
+
+const u8 *
+curve25519_keystore_find_public(const struct curve25519_keystore *ks,
+                                const u8 *public_key, uint64_t *id) {
+  uint64_t lo = 0, hi = ks->count;
+
+  while (lo < hi) {
+    const uint64_t mid = lo + (hi - lo) / 2;
+    const u8 *const e = ks->index + INDEX_SIZE * mid;
+    int c = memcmp(e, public_key, 8);
+
+    if (c == 0) {
+      const uint64_t record = load_le64(e + 8);
+      const u8 *r;
+
+      /* A corrupt index must not send us outside the mapping. */
+      if (record >= ks->count) return NULL;
+      r = ks->records + RECORD_SIZE * record;
+      c = memcmp(r + 40, public_key, 32);
+      if (c == 0) {
+        if (id) *id = load_le64(r);
+        return r + 8;
+      }
+    }
+    if (c < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return NULL;
+}
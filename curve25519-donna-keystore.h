@@ -0,0 +1,68 @@
+/* curve25519-donna: memory-mapped store of static keys
+ *
+ * Code released into the public domain.
+ *
+ * A key store is a file of (key ID, secret, public key) records that any
+ * number of processes can map read-only, so that loading it costs a few
+ * system calls and its pages are shared through the page cache rather than
+ * copied into every worker. Secrets are stored already clamped, and the
+ * public keys already computed, so that a lookup returns values that can be
+ * handed straight to curve25519_donna or curve25519_donna_fanout.
+ *
+ * The records are sorted by key ID and are followed by an index sorted by
+ * public key, so both kinds of lookup are binary searches over the mapping.
+ * See curve25519-donna-keystore.c for the layout.
+ *
+ * The file holds secrets: it is created with mode 0600, and its pages should
+ * be kept out of swap and core dumps by the usual means if that matters.
+ */
+
+#ifndef CURVE25519_DONNA_KEYSTORE_H
+#define CURVE25519_DONNA_KEYSTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct curve25519_keystore;
+
+/* Writes a key store holding n keys to path, replacing any existing file
+ * atomically. ids[i] is the ID of the key whose secret is the 32 bytes at
+ * secrets + 32*i. The secrets are clamped and their public keys computed
+ * here. Returns 0 on success or -1 with errno set; IDs must be unique
+ * (EINVAL otherwise). */
+int curve25519_keystore_write(const char *path, const uint64_t *ids,
+                              const uint8_t *secrets, size_t n);
+
+/* Maps the key store at path read-only. Returns NULL with errno set on
+ * failure, including EINVAL if the file is not a valid key store. */
+struct curve25519_keystore *curve25519_keystore_open(const char *path);
+
+/* Unmaps the key store. Pointers returned by lookups become invalid. */
+void curve25519_keystore_close(struct curve25519_keystore *ks);
+
+/* Returns the number of keys in the store. */
+size_t curve25519_keystore_count(const struct curve25519_keystore *ks);
+
+/* Returns the clamped secret (32 bytes) of the key with the given ID, or NULL
+ * if there is none. If public_key is not NULL, *public_key is set to its
+ * public key. Both point into the mapping. */
+const uint8_t *curve25519_keystore_find(const struct curve25519_keystore *ks,
+                                        uint64_t id,
+                                        const uint8_t **public_key);
+
+/* Returns the clamped secret (32 bytes) of the key whose public key is
+ * public_key, or NULL if there is none. If id is not NULL, *id is set to the
+ * key's ID. */
+const uint8_t *curve25519_keystore_find_public(
+    const struct curve25519_keystore *ks, const uint8_t *public_key,
+    uint64_t *id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* CURVE25519_DONNA_KEYSTORE_H */
@@ -0,0 +1,112 @@
+/* curve25519-donna: time-sliced scalar multiplication for C++20 coroutines
+ *
+ * Code released into the public domain.
+ *
+ * curve25519_donna runs its whole ladder in one call, which holds up every
+ * other task of a cooperative scheduler for that long. Awaiting
+ *
+ *   co_await curve25519::sliced(mypublic, secret, basepoint, steps, post);
+ *
+ * instead computes the same result steps ladder steps at a time, and between
+ * slices hands the awaiting coroutine back to the scheduler. post is any
+ * callable that takes a std::coroutine_handle<> and arranges for it to be
+ * resumed later, such as a function that pushes it onto the run queue. Many
+ * handshakes can then share one thread, each holding it for no more than a
+ * slice at a time.
+ *
+ * The pointers and post are held until the result is stored, so what they
+ * point to must outlive the co_await.
+ */
+
+#ifndef CURVE25519_DONNA_LADDER_HPP
+#define CURVE25519_DONNA_LADDER_HPP
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <utility>
+
+#include "curve25519-donna.h"
+
+namespace curve25519 {
+
+namespace detail {
+
+/* The coroutine that runs the slices. It starts when it is awaited and, when
+ * it finishes, resumes its awaiter directly. */
+class sliced_task {
+ public:
+  struct promise_type {
+    std::coroutine_handle<> continuation;
+
+    sliced_task get_return_object() {
+      return sliced_task(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct final_awaiter {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(
+          std::coroutine_handle<promise_type> h) noexcept {
+        return h.promise().continuation;
+      }
+      void await_resume() noexcept {}
+    };
+    final_awaiter final_suspend() noexcept { return {}; }
+
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+
+  sliced_task(sliced_task &&other) noexcept
+      : handle_(std::exchange(other.handle_, {})) {}
+  sliced_task &operator=(sliced_task &&) = delete;
+  ~sliced_task() {
+    if (handle_) handle_.destroy();
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept {
+    handle_.promise().continuation = h;
+    return handle_;
+  }
+  void await_resume() const noexcept {}
+
+ private:
+  explicit sliced_task(std::coroutine_handle<promise_type> h) : handle_(h) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+/* Suspends the current coroutine and hands it to post. */
+template <typename Post>
+struct reschedule {
+  Post &post;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> h) { post(h); }
+  void await_resume() const noexcept {}
+};
+
+}  // namespace detail
+
+/* Computes mypublic = curve25519_donna(secret, basepoint), steps ladder steps
+ * (at least one) at a time, handing the awaiting coroutine to post between
+ * slices. The state lives in the coroutine frame, and is wiped at the end. */
+template <typename Post>
+detail::sliced_task sliced(uint8_t *mypublic, const uint8_t *secret,
+                           const uint8_t *basepoint, unsigned steps,
+                           Post post) {
+  curve25519_donna_ladder ladder;
+
+  curve25519_donna_ladder_init(&ladder, secret, basepoint);
+  while (curve25519_donna_ladder_step(&ladder, steps ? steps : 1)) {
+    co_await detail::reschedule<Post>{post};
+  }
+  curve25519_donna_ladder_finish(&ladder, mypublic);
+}
+
+}  // namespace curve25519
+
+#endif  // CURVE25519_DONNA_LADDER_HPP
@@ -0,0 +1,659 @@
+/* curve25519-donna: local offload daemon for multi-process servers
+ *
+ * Code released into the public domain.
+ *
+ * A client's memfd holds a struct offload_shared: a header and a ring of
+ * slots. The client writes jobs into the slots at submitted, submitted+1, ...
+ * and publishes submitted; the daemon writes each result into the job's own
+ * slot and publishes completed. A slot is reused only once the client has
+ * collected its result, so the daemon only ever touches the slots between
+ * completed and submitted, which the client leaves alone.
+ *
+ * The daemon copies the pending jobs of every client into one batch for
+ * curve25519_donna_batch, writes the results back and rings each client's
+ * completion eventfd. When it finds no work it sets daemon_idle in every
+ * ring, looks once more, and sleeps in epoll_wait; a client that sees
+ * daemon_idle after publishing a job clears it and rings the daemon's
+ * eventfd. Both sides use sequentially consistent accesses for this, so either
+ * the daemon sees the job or the client sees the flag.
+ *
+ * The daemon trusts nothing in the shared memory: the ring's size is taken
+ * when the client connects, the memfd must be sealed against shrinking, and a
+ * client that claims more jobs than its ring holds is disconnected.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-internal.h"
+#include "curve25519-donna-offload.h"
+
+typedef uint8_t u8;
+
+#define OFFLOAD_MAGIC 0x64616f6c66666f63ull  /* "coffload" */
+#define OFFLOAD_VERSION 1
+#define OFFLOAD_MAX_SLOTS 4096
+#define OFFLOAD_MAX_CLIENTS 1024
+
+/* Jobs handed to curve25519_donna_batch at once by the daemon. */
+#define OFFLOAD_BATCH 128
+
+struct offload_slot {
+  u8 secret[32];
+  u8 point[32];
+  u8 result[32];
+};
+
+struct offload_shared {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t slots;
+  _Alignas(64) atomic_uint_fast64_t submitted;  /* written by the client */
+  _Alignas(64) atomic_uint_fast64_t completed;  /* written by the daemon */
+  atomic_uint daemon_idle;
+  _Alignas(64) struct offload_slot slot[];
+};
+
+struct curve25519_offload {
+  struct offload_shared *shared;
+  size_t map_size;
+  uint64_t submitted, collected;
+  uint32_t mask;
+  int sock, doorbell, done;
+  int events;  /* epoll on done and sock, for curve25519_offload_fd */
+  int gone;    /* the daemon has closed the socket */
+};
+
+static size_t
+offload_size(uint32_t slots) {
+  return sizeof(struct offload_shared) + slots * sizeof(struct offload_slot);
+}
+
+static void
+ring_eventfd(int fd) {
+  const uint64_t one = 1;
+  ssize_t ret;
+
+  do {
+    ret = write(fd, &one, sizeof(one));
+  } while (ret < 0 && errno == EINTR);
+}
+
+static void
+drain_eventfd(int fd) {
+  uint64_t count;
+
+  while (read(fd, &count, sizeof(count)) < 0 && errno == EINTR) {}
+}
+
+// -----------------------------------------------------------------------------
+// Client
+// -----------------------------------------------------------------------------
+
+struct curve25519_offload *
+curve25519_offload_connect(const char *path, size_t slots) {
+  struct curve25519_offload *c;
+  struct sockaddr_un addr;
+  struct msghdr msg;
+  struct iovec iov;
+  union {
+    struct cmsghdr hdr;
+    char buf[CMSG_SPACE(3 * sizeof(int))];
+  } control;
+  struct cmsghdr *cmsg;
+  struct epoll_event ev;
+  int fds[3], memfd = -1, saved_errno;
+  u8 byte = 0;
+  uint32_t size = 1;
+  ssize_t ret;
+
+  if (slots == 0 || slots > OFFLOAD_MAX_SLOTS ||
+      strlen(path) >= sizeof(addr.sun_path)) {
+    errno = EINVAL;
+    return NULL;
+  }
+  while (size < slots) size <<= 1;
+
+  c = calloc(1, sizeof(struct curve25519_offload));
+  if (!c) return NULL;
+  c->sock = c->doorbell = c->done = c->events = -1;
+  c->mask = size - 1;
+  c->map_size = offload_size(size);
+
+  memfd = memfd_create("curve25519-offload", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (memfd < 0 || ftruncate(memfd, c->map_size) ||
+      fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+    goto err;
+  }
+  c->shared = mmap(NULL, c->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   memfd, 0);
+  if (c->shared == MAP_FAILED) {
+    c->shared = NULL;
+    goto err;
+  }
+  c->shared->magic = OFFLOAD_MAGIC;
+  c->shared->version = OFFLOAD_VERSION;
+  c->shared->slots = size;
+
+  c->doorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  c->done = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  c->sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (c->doorbell < 0 || c->done < 0 || c->sock < 0) goto err;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  if (connect(c->sock, (struct sockaddr *) &addr, sizeof(addr))) goto err;
+
+  fds[0] = memfd;
+  fds[1] = c->doorbell;
+  fds[2] = c->done;
+  memset(&msg, 0, sizeof(msg));
+  memset(&control, 0, sizeof(control));
+  iov.iov_base = &byte;
+  iov.iov_len = 1;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  do {
+    ret = sendmsg(c->sock, &msg, MSG_NOSIGNAL);
+  } while (ret < 0 && errno == EINTR);
+  if (ret != 1) goto err;
+
+  /* The daemon answers with a zero byte once it has mapped the ring. */
+  do {
+    ret = recv(c->sock, &byte, 1, 0);
+  } while (ret < 0 && errno == EINTR);
+  if (ret != 1 || byte != 0) {
+    if (ret >= 0) errno = ECONNREFUSED;
+    goto err;
+  }
+
+  /* The daemon never writes to the socket after the handshake, so it only
+   * becomes readable once the daemon has gone. */
+  c->events = epoll_create1(EPOLL_CLOEXEC);
+  if (c->events < 0) goto err;
+  ev.events = EPOLLIN;
+  ev.data.fd = c->done;
+  if (epoll_ctl(c->events, EPOLL_CTL_ADD, c->done, &ev)) goto err;
+  ev.events = EPOLLIN | EPOLLRDHUP;
+  ev.data.fd = c->sock;
+  if (epoll_ctl(c->events, EPOLL_CTL_ADD, c->sock, &ev)) goto err;
+
+  close(memfd);
+  return c;
+
+err:
+  saved_errno = errno;
+  if (memfd >= 0) close(memfd);
+  curve25519_offload_close(c);
+  errno = saved_errno;
+  return NULL;
+}
+
+void
+curve25519_offload_close(struct curve25519_offload *c) {
+  if (!c) return;
+  if (c->shared) {
+    donna_memset(c->shared->slot, 0,
+                   (c->mask + 1) * sizeof(struct offload_slot));
+    munmap(c->shared, c->map_size);
+  }
+  if (c->sock >= 0) close(c->sock);
+  if (c->doorbell >= 0) close(c->doorbell);
+  if (c->done >= 0) close(c->done);
+  if (c->events >= 0) close(c->events);
+  free(c);
+}
+
+/* Returns 1 if the daemon has closed its end of the socket. Costs a system
+ * call until it has. */
+static int
+daemon_gone(struct curve25519_offload *c) {
+  ssize_t ret;
+  u8 byte;
+
+  if (c->gone) return 1;
+  do {
+    ret = recv(c->sock, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+  } while (ret < 0 && errno == EINTR);
+  if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+    c->gone = 1;
+  }
+  return c->gone;
+}
+
+int
+curve25519_offload_submit(struct curve25519_offload *c, const u8 *secret,
+                          const u8 *basepoint) {
+  struct offload_slot *slot;
+
+  if (c->gone) {
+    errno = EPIPE;
+    return -1;
+  }
+  if (c->submitted - c->collected > c->mask) {
+    errno = daemon_gone(c) ? EPIPE : EAGAIN;
+    return -1;
+  }
+  slot = &c->shared->slot[c->submitted & c->mask];
+  memcpy(slot->secret, secret, 32);
+  if (basepoint) {
+    memcpy(slot->point, basepoint, 32);
+  } else {
+    memset(slot->point, 0, 32);
+    slot->point[0] = 9;
+  }
+
+  atomic_store(&c->shared->submitted, ++c->submitted);
+  if (atomic_exchange(&c->shared->daemon_idle, 0)) {
+    /* A daemon that has gone leaves daemon_idle set, so this is where a
+     * client that only submits finds out. */
+    if (daemon_gone(c)) {
+      atomic_store(&c->shared->submitted, --c->submitted);
+      donna_memset(slot->secret, 0, 32);
+      errno = EPIPE;
+      return -1;
+    }
+    ring_eventfd(c->doorbell);
+  }
+  return 0;
+}
+
+ssize_t
+curve25519_offload_complete(struct curve25519_offload *c, u8 *out,
+                            size_t max) {
+  uint64_t completed;
+  size_t n = 0;
+
+  drain_eventfd(c->done);
+  completed = atomic_load_explicit(&c->shared->completed,
+                                   memory_order_acquire);
+  /* A broken daemon must not make us read past the jobs we submitted. */
+  if (completed - c->collected > c->submitted - c->collected) {
+    completed = c->collected;
+  }
+
+  for (; c->collected < completed && n < max; ++c->collected, ++n) {
+    struct offload_slot *slot = &c->shared->slot[c->collected & c->mask];
+    memcpy(out + 32 * n, slot->result, 32);
+    donna_memset(slot->secret, 0, 32);
+  }
+  if (n == 0 && max && daemon_gone(c)) {
+    errno = EPIPE;
+    return -1;
+  }
+  return n;
+}
+
+int
+curve25519_offload_fd(const struct curve25519_offload *c) {
+  return c->events;
+}
+
+int
+curve25519_offload_batch(struct curve25519_offload *c, u8 *mypublic,
+                         const u8 *secret, const u8 *basepoint, size_t n) {
+  size_t submitted = 0, done = 0;
+  ssize_t got;
+
+  if (c->submitted != c->collected) {
+    errno = EBUSY;
+    return -1;
+  }
+
+  while (done < n) {
+    while (submitted < n &&
+           curve25519_offload_submit(c, secret + 32 * submitted,
+                                     basepoint ? basepoint + 32 * submitted
+                                               : NULL) == 0) {
+      ++submitted;
+    }
+
+    if (submitted < n && errno == EPIPE) return -1;
+
+    got = curve25519_offload_complete(c, mypublic + 32 * done, n - done);
+    if (got < 0) return -1;
+    done += got;
+    if (got == 0) {
+      struct pollfd pfd;
+
+      pfd.fd = c->events;
+      pfd.events = POLLIN;
+      if (poll(&pfd, 1, -1) < 0 && errno != EINTR) return -1;
+    }
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// Daemon
+// -----------------------------------------------------------------------------
+
+struct offload_client {
+  struct offload_shared *shared;  /* NULL until the handshake is done */
+  size_t map_size;
+  uint64_t completed;
+  uint32_t mask;
+  int sock, doorbell, done;
+};
+
+struct offload_daemon {
+  int epfd, listen_fd;
+  struct offload_client *clients[OFFLOAD_MAX_CLIENTS];
+  unsigned next;  /* the client whose jobs go first in the next batch */
+  u8 secrets[OFFLOAD_BATCH * 32], points[OFFLOAD_BATCH * 32];
+  u8 results[OFFLOAD_BATCH * 32];
+  /* The batch holds taken[i] jobs of client i, in client order from next. */
+  unsigned taken[OFFLOAD_MAX_CLIENTS];
+};
+
+/* epoll data: the listening socket, or a client's index times two, plus one
+ * for its doorbell. */
+#define EVENT_LISTEN UINT64_MAX
+
+static void
+client_drop(struct offload_daemon *d, unsigned i) {
+  struct offload_client *cl = d->clients[i];
+
+  epoll_ctl(d->epfd, EPOLL_CTL_DEL, cl->sock, NULL);
+  close(cl->sock);
+  if (cl->shared) {
+    epoll_ctl(d->epfd, EPOLL_CTL_DEL, cl->doorbell, NULL);
+    close(cl->doorbell);
+    close(cl->done);
+    munmap(cl->shared, cl->map_size);
+  }
+  free(cl);
+  d->clients[i] = NULL;
+}
+
+static void
+client_accept(struct offload_daemon *d) {
+  struct epoll_event ev;
+  struct offload_client *cl;
+  unsigned i;
+  int fd;
+
+  fd = accept4(d->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0) return;
+  for (i = 0; i < OFFLOAD_MAX_CLIENTS && d->clients[i]; ++i) {}
+  cl = i < OFFLOAD_MAX_CLIENTS ? calloc(1, sizeof(*cl)) : NULL;
+  if (!cl) {
+    close(fd);
+    return;
+  }
+  cl->sock = fd;
+  cl->doorbell = cl->done = -1;
+  ev.events = EPOLLIN | EPOLLRDHUP;
+  ev.data.u64 = 2 * (uint64_t) i;
+  if (epoll_ctl(d->epfd, EPOLL_CTL_ADD, fd, &ev)) {
+    close(fd);
+    free(cl);
+    return;
+  }
+  d->clients[i] = cl;
+}
+
+/* Receives a client's memfd and eventfds and maps its ring. Returns -1 if the
+ * client should be dropped. */
+static int
+client_handshake(struct offload_daemon *d, unsigned i) {
+  struct offload_client *cl = d->clients[i];
+  struct msghdr msg;
+  struct iovec iov;
+  union {
+    struct cmsghdr hdr;
+    char buf[CMSG_SPACE(3 * sizeof(int))];
+  } control;
+  struct cmsghdr *cmsg;
+  struct epoll_event ev;
+  struct offload_shared *shared;
+  struct stat st;
+  int fds[3] = {-1, -1, -1}, seals;
+  size_t nfds, k;
+  uint32_t slots;
+  u8 byte;
+  ssize_t ret;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = &byte;
+  iov.iov_len = 1;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+  ret = recvmsg(cl->sock, &msg, MSG_CMSG_CLOEXEC);
+  if (ret < 0 && (errno == EAGAIN || errno == EINTR)) return 0;
+  if (ret != 1) return -1;
+
+  cmsg = CMSG_FIRSTHDR(&msg);
+  if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS) {
+    return -1;
+  }
+  /* Take whatever descriptors did arrive, so that they are closed on error. */
+  nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+  memcpy(fds, CMSG_DATA(cmsg), (nfds < 3 ? nfds : 3) * sizeof(int));
+  if ((msg.msg_flags & MSG_CTRUNC) || nfds != 3) goto err;
+
+  /* Sealing keeps the client from truncating the memfd under our mapping. */
+  seals = fcntl(fds[0], F_GET_SEALS);
+  if (seals < 0 || !(seals & F_SEAL_SHRINK) || fstat(fds[0], &st) ||
+      st.st_size < (off_t) offload_size(1)) {
+    goto err;
+  }
+  shared = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0],
+                0);
+  if (shared == MAP_FAILED) goto err;
+  /* The client can change the header at any time, so read it once. */
+  slots = shared->slots;
+  if (shared->magic != OFFLOAD_MAGIC || shared->version != OFFLOAD_VERSION ||
+      slots == 0 || slots > OFFLOAD_MAX_SLOTS || (slots & (slots - 1)) ||
+      (size_t) st.st_size != offload_size(slots)) {
+    munmap(shared, st.st_size);
+    goto err;
+  }
+  cl->mask = slots - 1;
+  cl->map_size = st.st_size;
+  cl->completed = atomic_load(&shared->submitted);
+  atomic_store(&shared->completed, cl->completed);
+  close(fds[0]);
+  cl->doorbell = fds[1];
+  cl->done = fds[2];
+
+  ev.events = EPOLLIN;
+  ev.data.u64 = 2 * (uint64_t) i + 1;
+  if (epoll_ctl(d->epfd, EPOLL_CTL_ADD, cl->doorbell, &ev)) {
+    munmap(shared, cl->map_size);
+    close(cl->doorbell);
+    close(cl->done);
+    return -1;
+  }
+  cl->shared = shared;
+
+  byte = 0;
+  return send(cl->sock, &byte, 1, MSG_NOSIGNAL) == 1 ? 0 : -1;
+
+err:
+  for (k = 0; k < 3; ++k) {
+    if (fds[k] >= 0) close(fds[k]);
+  }
+  return -1;
+}
+
+static void
+handle_events(struct offload_daemon *d, int timeout) {
+  struct epoll_event events[64];
+  int n, k;
+
+  n = epoll_wait(d->epfd, events, 64, timeout);
+  for (k = 0; k < n; ++k) {
+    const uint64_t data = events[k].data.u64;
+    unsigned i;
+
+    if (data == EVENT_LISTEN) {
+      client_accept(d);
+      continue;
+    }
+    i = data / 2;
+    if (!d->clients[i]) continue;
+    if (data & 1) {
+      drain_eventfd(d->clients[i]->doorbell);
+    } else if (events[k].events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) {
+      client_drop(d, i);
+    } else if (!d->clients[i]->shared) {
+      if (client_handshake(d, i)) client_drop(d, i);
+    } else {
+      /* Clients send nothing after the handshake. */
+      client_drop(d, i);
+    }
+  }
+}
+
+/* Copies up to OFFLOAD_BATCH pending jobs into the batch and returns how many
+ * there were. */
+static unsigned
+collect(struct offload_daemon *d) {
+  unsigned n = 0, k, i;
+
+  for (k = 0; k < OFFLOAD_MAX_CLIENTS; ++k) {
+    struct offload_client *cl;
+    uint64_t submitted;
+    unsigned take, j;
+
+    i = (d->next + k) % OFFLOAD_MAX_CLIENTS;
+    d->taken[i] = 0;
+    cl = d->clients[i];
+    if (!cl || !cl->shared || n == OFFLOAD_BATCH) continue;
+
+    submitted = atomic_load(&cl->shared->submitted);
+    if (submitted - cl->completed > (uint64_t) cl->mask + 1) {
+      client_drop(d, i);
+      continue;
+    }
+    take = submitted - cl->completed < OFFLOAD_BATCH - n
+           ? (unsigned) (submitted - cl->completed) : OFFLOAD_BATCH - n;
+    for (j = 0; j < take; ++j) {
+      const struct offload_slot *slot =
+          &cl->shared->slot[(cl->completed + j) & cl->mask];
+      memcpy(d->secrets + 32 * (n + j), slot->secret, 32);
+      memcpy(d->points + 32 * (n + j), slot->point, 32);
+    }
+    d->taken[i] = take;
+    n += take;
+  }
+  return n;
+}
+
+/* Runs the collected batch and hands the results back. */
+static void
+run_batch(struct offload_daemon *d, unsigned n) {
+  unsigned k, i, j, pos = 0;
+
+  curve25519_donna_batch(d->results, d->secrets, d->points, n);
+  donna_memset(d->secrets, 0, 32 * n);
+
+  for (k = 0; k < OFFLOAD_MAX_CLIENTS && pos < n; ++k) {
+    struct offload_client *cl;
+
+    i = (d->next + k) % OFFLOAD_MAX_CLIENTS;
+    cl = d->clients[i];
+    if (!d->taken[i]) continue;
+    for (j = 0; j < d->taken[i]; ++j) {
+      memcpy(cl->shared->slot[(cl->completed + j) & cl->mask].result,
+             d->results + 32 * (pos + j), 32);
+    }
+    pos += d->taken[i];
+    cl->completed += d->taken[i];
+    atomic_store_explicit(&cl->shared->completed, cl->completed,
+                          memory_order_release);
+    ring_eventfd(cl->done);
+  }
+  donna_memset(d->results, 0, 32 * n);
+  d->next = (d->next + 1) % OFFLOAD_MAX_CLIENTS;
+}
+
+static void
+set_idle(struct offload_daemon *d, unsigned idle) {
+  unsigned i;
+
+  for (i = 0; i < OFFLOAD_MAX_CLIENTS; ++i) {
+    if (d->clients[i] && d->clients[i]->shared) {
+      atomic_store(&d->clients[i]->shared->daemon_idle, idle);
+    }
+  }
+}
+
+int
+curve25519_offload_serve(const char *path) {
+  struct offload_daemon *d;
+  struct sockaddr_un addr;
+  struct epoll_event ev;
+  unsigned n;
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = EINVAL;
+    return -1;
+  }
+  d = calloc(1, sizeof(struct offload_daemon));
+  if (!d) return -1;
+
+  d->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  d->epfd = epoll_create1(EPOLL_CLOEXEC);
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  ev.events = EPOLLIN;
+  ev.data.u64 = EVENT_LISTEN;
+  if (d->listen_fd < 0 || d->epfd < 0 ||
+      bind(d->listen_fd, (struct sockaddr *) &addr, sizeof(addr)) ||
+      listen(d->listen_fd, 64) ||
+      epoll_ctl(d->epfd, EPOLL_CTL_ADD, d->listen_fd, &ev)) {
+    const int saved_errno = errno;
+    if (d->listen_fd >= 0) close(d->listen_fd);
+    if (d->epfd >= 0) close(d->epfd);
+    free(d);
+    errno = saved_errno;
+    return -1;
+  }
+
+  for (;;) {
+    n = collect(d);
+    if (n) {
+      run_batch(d, n);
+      handle_events(d, 0);
+      continue;
+    }
+
+    set_idle(d, 1);
+    n = collect(d);
+    if (n) {
+      set_idle(d, 0);
+      run_batch(d, n);
+    } else {
+      handle_events(d, -1);
+      set_idle(d, 0);
+    }
+  }
+}
@@ -0,0 +1,79 @@
+/* curve25519-donna: local offload daemon for multi-process servers
+ *
+ * Code released into the public domain.
+ *
+ * A pre-fork server's worker processes each produce too little work to fill
+ * a batch for curve25519_donna_batch. The offload daemon collects jobs from
+ * all of them and runs them as shared batches.
+ *
+ * Each client process creates a memfd holding a ring of job slots, and passes
+ * it, with two eventfds, to the daemon over a unix socket. Jobs are written
+ * into the ring and answered in place, in order, so submitting and collecting
+ * need no system calls while the daemon is busy. The daemon rings the client's
+ * completion eventfd after each batch, and the client rings the daemon's
+ * eventfd only when the daemon has said it is about to sleep.
+ *
+ * Everything stays on the local machine. The socket's permissions decide who
+ * may connect: the daemon computes with whatever secrets it is given, and
+ * each client's jobs are only visible to that client and the daemon.
+ */
+
+#ifndef CURVE25519_DONNA_OFFLOAD_H
+#define CURVE25519_DONNA_OFFLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct curve25519_offload;
+
+/* Runs the daemon, listening on the unix socket at path, which must not
+ * exist. Only returns on failure, with -1 and errno set. */
+int curve25519_offload_serve(const char *path);
+
+/* Connects to the daemon listening at path, with room for slots jobs in
+ * flight (rounded up to a power of two). Returns NULL with errno set on
+ * failure. A connection must only be used by one thread at a time, and not
+ * across fork. */
+struct curve25519_offload *curve25519_offload_connect(const char *path,
+                                                      size_t slots);
+
+void curve25519_offload_close(struct curve25519_offload *c);
+
+/* Queues the job mypublic = curve25519_donna(secret, basepoint), where a NULL
+ * basepoint means the standard base point. Returns 0, or -1 with errno set to
+ * EAGAIN if every slot is in flight or to EPIPE if the daemon has gone. While
+ * the daemon is busy, submitting makes no system call, so a daemon that dies
+ * then is noticed once the ring is full or by curve25519_offload_complete. */
+int curve25519_offload_submit(struct curve25519_offload *c,
+                              const uint8_t *secret,
+                              const uint8_t *basepoint);
+
+/* Copies the results of up to max finished jobs, in the order in which they
+ * were submitted, to out (32 bytes each), and returns how many there were.
+ * Does not block. Returns -1 with errno set to EPIPE if there were none and
+ * the daemon has gone, in which case the jobs still in flight are lost. */
+ssize_t curve25519_offload_complete(struct curve25519_offload *c,
+                                    uint8_t *out, size_t max);
+
+/* Returns a descriptor that becomes readable when jobs finish or the daemon
+ * has gone, for use with poll or epoll. curve25519_offload_complete clears it
+ * while the daemon is there. */
+int curve25519_offload_fd(const struct curve25519_offload *c);
+
+/* Computes n scalar multiplications like curve25519_donna_batch, through the
+ * daemon, and waits for them. Jobs already in flight must have been collected
+ * first. Returns 0, or -1 with errno set if the daemon has gone. */
+int curve25519_offload_batch(struct curve25519_offload *c, uint8_t *mypublic,
+                             const uint8_t *secret, const uint8_t *basepoint,
+                             size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* CURVE25519_DONNA_OFFLOAD_H */
@@ -0,0 +1,26 @@
+/* curve25519-donna: the offload daemon
+ *
+ * Code released into the public domain.
+ *
+ * Usage: curve25519-donna-offloadd <socket path>
+ *
+ * Serves curve25519_offload clients on the given unix socket until killed.
+ * See curve25519-donna-offload.h.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+
+#include "curve25519-donna-offload.h"
+
+int
+main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <socket path>\n", argv[0]);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+  curve25519_offload_serve(argv[1]);
+  perror(argv[1]);
+  return 1;
+}
@@ -0,0 +1,271 @@
+/* curve25519-donna: pool of precomputed ephemeral keypairs
+ *
+ * Code released into the public domain.
+ *
+ * The keypairs live in a lock-free ring (see curve25519-donna-ring.h), so a
+ * take is a single compare-and-swap on the head plus a copy. Workers sleep on a
+ * condition variable while the pool is more than half full and are woken by
+ * the first take that drops it below that mark. A worker whose random number
+ * generator fails records the error and retries, backing off from 1ms to 1s.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-internal.h"
+#include "curve25519-donna-pool.h"
+#include "curve25519-donna-ring.h"
+
+typedef uint8_t u8;
+
+/* Keypairs generated, and inverted together, per worker iteration. */
+#define POOL_REFILL_BATCH 32
+
+/* Bounds of a worker's wait after its random number generator fails. */
+#define POOL_BACKOFF_MIN_NSEC 1000000
+#define POOL_BACKOFF_MAX_NSEC 1000000000
+
+struct curve25519_pool {
+  struct ring ring;  /* of 64-byte keypairs: public || secret */
+  _Alignas(64) atomic_size_t low_watermark;
+  atomic_uint_fast64_t taken;
+  atomic_uint_fast64_t misses;
+  atomic_uint_fast64_t generated;
+  atomic_uint_fast64_t generate_nsec;
+  atomic_uint_fast64_t rng_failures;
+  atomic_int rng_errno;
+  atomic_uint sleeping;
+  atomic_int stop;
+
+  size_t refill_below;
+
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  unsigned nworkers;
+  pthread_t *workers;
+};
+
+static uint64_t
+time_nsec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/* Generates n keypairs into keypairs (n * 64 bytes). */
+static int
+generate_keypairs(u8 *keypairs, unsigned n) {
+  u8 secrets[POOL_REFILL_BATCH * 32], publics[POOL_REFILL_BATCH * 32];
+  unsigned i;
+
+  if (curve25519_donna_random_bytes(secrets, 32 * n)) return -1;
+  for (i = 0; i < n; ++i) {
+    secrets[32 * i] &= 248;
+    secrets[32 * i + 31] &= 127;
+    secrets[32 * i + 31] |= 64;
+  }
+  curve25519_donna_batch(publics, secrets, NULL, n);
+
+  for (i = 0; i < n; ++i) {
+    memcpy(keypairs + 64 * i, publics + 32 * i, 32);
+    memcpy(keypairs + 64 * i + 32, secrets + 32 * i, 32);
+  }
+  ring_wipe(secrets, sizeof(secrets));
+  return 0;
+}
+
+/* Records a failure of the random number generator and waits for backoff
+ * nanoseconds, or until the pool is stopped. */
+static void
+pool_backoff(struct curve25519_pool *pool, uint64_t backoff) {
+  const uint64_t until = time_nsec() + backoff;
+  struct timespec ts;
+
+  atomic_fetch_add_explicit(&pool->rng_failures, 1, memory_order_relaxed);
+  atomic_store_explicit(&pool->rng_errno, errno, memory_order_relaxed);
+
+  ts.tv_sec = until / 1000000000;
+  ts.tv_nsec = until % 1000000000;
+  pthread_mutex_lock(&pool->lock);
+  while (!atomic_load(&pool->stop) &&
+         pthread_cond_timedwait(&pool->wake, &pool->lock, &ts) != ETIMEDOUT) {
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static void *
+pool_worker(void *arg) {
+  struct curve25519_pool *pool = arg;
+  u8 keypairs[POOL_REFILL_BATCH * 64];
+  uint64_t backoff = POOL_BACKOFF_MIN_NSEC;
+
+  while (!atomic_load(&pool->stop)) {
+    const size_t room = ring_capacity(&pool->ring) - ring_size(&pool->ring);
+
+    if (room > 0) {
+      const unsigned n = room < POOL_REFILL_BATCH ? room : POOL_REFILL_BATCH;
+      const uint64_t start = time_nsec();
+      unsigned i;
+
+      if (generate_keypairs(keypairs, n)) {
+        pool_backoff(pool, backoff);
+        if (backoff < POOL_BACKOFF_MAX_NSEC) backoff *= 2;
+        continue;
+      }
+      backoff = POOL_BACKOFF_MIN_NSEC;
+      atomic_fetch_add_explicit(&pool->generate_nsec, time_nsec() - start,
+                                memory_order_relaxed);
+
+      /* Another worker may have filled the ring meanwhile. The keypairs that
+       * did not fit are dropped and not counted. */
+      for (i = 0; i < n; ++i) {
+        if (ring_push(&pool->ring, keypairs + 64 * i)) break;
+      }
+      atomic_fetch_add_explicit(&pool->generated, i, memory_order_relaxed);
+      ring_wipe(keypairs, sizeof(keypairs));
+      continue;
+    }
+
+    /* The pool is full. Sleep until a take drops it below refill_below. The
+     * increment of sleeping and the check of the ring are both sequentially
+     * consistent, pairing with the opposite order in curve25519_pool_take, so
+     * either we see the take or the taker sees us sleeping. */
+    pthread_mutex_lock(&pool->lock);
+    atomic_fetch_add(&pool->sleeping, 1);
+    while (!atomic_load(&pool->stop) &&
+           ring_size(&pool->ring) >= pool->refill_below) {
+      pthread_cond_wait(&pool->wake, &pool->lock);
+    }
+    atomic_fetch_sub(&pool->sleeping, 1);
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  return NULL;
+}
+
+static void
+pool_wake_workers(struct curve25519_pool *pool) {
+  if (atomic_load(&pool->sleeping) == 0) return;
+  pthread_mutex_lock(&pool->lock);
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+struct curve25519_pool *
+curve25519_pool_new(size_t capacity, unsigned workers) {
+  struct curve25519_pool *pool;
+  pthread_condattr_t attr;
+
+  if (capacity < 2 || workers == 0) return NULL;
+
+  if (posix_memalign((void **) &pool, 64, sizeof(struct curve25519_pool))) {
+    return NULL;
+  }
+  memset(pool, 0, sizeof(struct curve25519_pool));
+  if (ring_init(&pool->ring, capacity, 64)) {
+    free(pool);
+    return NULL;
+  }
+  pool->refill_below = ring_capacity(&pool->ring) / 2;
+  atomic_init(&pool->low_watermark, ring_capacity(&pool->ring));
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&pool->wake, &attr);
+  pthread_condattr_destroy(&attr);
+  pool->workers = calloc(workers, sizeof(pthread_t));
+  if (!pool->workers) {
+    curve25519_pool_free(pool);
+    return NULL;
+  }
+  for (; pool->nworkers < workers; ++pool->nworkers) {
+    if (pthread_create(&pool->workers[pool->nworkers], NULL, pool_worker,
+                       pool)) {
+      curve25519_pool_free(pool);
+      return NULL;
+    }
+  }
+
+  return pool;
+}
+
+void
+curve25519_pool_free(struct curve25519_pool *pool) {
+  unsigned i;
+
+  if (!pool) return;
+  atomic_store(&pool->stop, 1);
+  pthread_mutex_lock(&pool->lock);
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->lock);
+  for (i = 0; i < pool->nworkers; ++i) pthread_join(pool->workers[i], NULL);
+
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->lock);
+  ring_destroy(&pool->ring);
+  free(pool->workers);
+  free(pool);
+}
+
+int
+curve25519_pool_take(struct curve25519_pool *pool, u8 *mypublic,
+                     u8 *mysecret) {
+  static const u8 basepoint[32] = {9};
+  u8 keypair[64];
+  size_t available, low;
+
+  if (ring_pop(&pool->ring, keypair)) {
+    atomic_fetch_add_explicit(&pool->misses, 1, memory_order_relaxed);
+    atomic_store_explicit(&pool->low_watermark, 0, memory_order_relaxed);
+    pool_wake_workers(pool);
+
+    if (curve25519_donna_random_bytes(mysecret, 32)) return -1;
+    mysecret[0] &= 248;
+    mysecret[31] &= 127;
+    mysecret[31] |= 64;
+    curve25519_donna(mypublic, mysecret, basepoint);
+    return 0;
+  }
+
+  memcpy(mypublic, keypair, 32);
+  memcpy(mysecret, keypair + 32, 32);
+  ring_wipe(keypair, sizeof(keypair));
+  atomic_fetch_add_explicit(&pool->taken, 1, memory_order_relaxed);
+
+  available = ring_size(&pool->ring);
+  low = atomic_load_explicit(&pool->low_watermark, memory_order_relaxed);
+  while (available < low &&
+         !atomic_compare_exchange_weak_explicit(&pool->low_watermark, &low,
+                                                available,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+  if (available < pool->refill_below) pool_wake_workers(pool);
+
+  return 0;
+}
+
+void
+curve25519_pool_stats(struct curve25519_pool *pool,
+                      struct curve25519_pool_stats *stats) {
+  stats->capacity = ring_capacity(&pool->ring);
+  stats->available = ring_size(&pool->ring);
+  stats->low_watermark = atomic_load(&pool->low_watermark);
+  stats->taken = atomic_load(&pool->taken);
+  stats->misses = atomic_load(&pool->misses);
+  stats->generated = atomic_load(&pool->generated);
+  stats->generate_nsec = atomic_load(&pool->generate_nsec);
+  stats->rng_failures = atomic_load(&pool->rng_failures);
+  stats->rng_errno = atomic_load(&pool->rng_errno);
+}
+
+void
+curve25519_pool_reset_watermark(struct curve25519_pool *pool) {
+  atomic_store(&pool->low_watermark, ring_size(&pool->ring));
+}
@@ -0,0 +1,67 @@
+/* curve25519-donna: pool of precomputed ephemeral keypairs
+ *
+ * Code released into the public domain.
+ *
+ * A pool keeps a ring of ready keypairs that background threads refill with
+ * curve25519_donna_batch. Taking a keypair is a lock-free dequeue, so the
+ * scalar multiplication is moved off the caller's critical path. Every
+ * keypair is handed out at most once and is wiped from the pool as it is
+ * taken. If the pool has run dry, the keypair is generated inline instead.
+ */
+
+#ifndef CURVE25519_DONNA_POOL_H
+#define CURVE25519_DONNA_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct curve25519_pool;
+
+struct curve25519_pool_stats {
+  size_t capacity;         /* keypairs the pool can hold */
+  size_t available;        /* keypairs ready right now */
+  size_t low_watermark;    /* fewest keypairs seen ready after a take */
+  uint64_t taken;          /* keypairs handed out from the pool */
+  uint64_t misses;         /* takes that found the pool empty */
+  uint64_t generated;      /* keypairs the workers added to the pool */
+  uint64_t generate_nsec;  /* time the workers spent generating keypairs */
+  uint64_t rng_failures;   /* refills lost to the random number generator */
+  int rng_errno;           /* errno of the latest of those failures */
+};
+
+/* Creates a pool holding up to capacity keypairs (rounded up to a power of
+ * two), refilled by the given number of worker threads. The workers start
+ * filling the pool immediately. A worker whose random number generator fails
+ * counts the failure in rng_failures and retries after a wait that doubles
+ * from 1ms up to 1s, so a pool that stops refilling shows why in its
+ * statistics while takes fall back to inline generation. Returns NULL on
+ * failure. */
+struct curve25519_pool *curve25519_pool_new(size_t capacity, unsigned workers);
+
+/* Stops the workers and wipes and frees the pool. */
+void curve25519_pool_free(struct curve25519_pool *pool);
+
+/* Writes a fresh keypair to mypublic and mysecret (32 bytes each). The secret
+ * is already clamped. Returns 0 on success and -1 if the pool was empty and
+ * the system random number generator failed. */
+int curve25519_pool_take(struct curve25519_pool *pool, uint8_t *mypublic,
+                         uint8_t *mysecret);
+
+/* Fills in a snapshot of the pool's counters. The refill rate in keypairs per
+ * second of worker time is generated * 1e9 / generate_nsec; keypairs that a
+ * worker generated but found no room for are not counted. */
+void curve25519_pool_stats(struct curve25519_pool *pool,
+                           struct curve25519_pool_stats *stats);
+
+/* Resets the low watermark to the current number of available keypairs. */
+void curve25519_pool_reset_watermark(struct curve25519_pool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* CURVE25519_DONNA_POOL_H */
@@ -0,0 +1,144 @@
+/* curve25519-donna: bounded lock-free queue shared by the pool and the engine
+ *
+ * Code released into the public domain.
+ *
+ * This is a bounded multi-producer, multi-consumer ring in the style of Dmitry
+ * Vyukov's queue: each cell carries a sequence number that tells producers and
+ * consumers whose turn it is, so a push or a pop is a single compare-and-swap
+ * plus a copy. Elements are copied into the cells and the cells are wiped as
+ * they are popped, so secrets do not linger in the ring.
+ *
+ * This header is internal and is only included by the library's .c files.
+ */
+
+#ifndef CURVE25519_DONNA_RING_H
+#define CURVE25519_DONNA_RING_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "curve25519-donna-internal.h"
+
+struct ring {
+  _Alignas(64) atomic_size_t head;
+  _Alignas(64) atomic_size_t tail;
+  _Alignas(64) size_t mask;
+  size_t stride;        /* bytes per cell: the sequence number, then the data */
+  size_t elem_size;
+  unsigned char *cells;
+};
+
+static inline void
+ring_wipe(void *p, size_t len) {
+  donna_memset(p, 0, len);
+}
+
+static inline atomic_size_t *
+ring_seq(const struct ring *r, size_t pos) {
+  return (atomic_size_t *) (r->cells + (pos & r->mask) * r->stride);
+}
+
+static inline unsigned char *
+ring_data(const struct ring *r, size_t pos) {
+  return r->cells + (pos & r->mask) * r->stride + 64;
+}
+
+/* Sets up a ring of at least capacity elements (rounded up to a power of two)
+ * of elem_size bytes each. Returns 0 on success or -1 on allocation failure. */
+static inline int
+ring_init(struct ring *r, size_t capacity, size_t elem_size) {
+  size_t size = 1, i;
+
+  while (size < capacity) size <<= 1;
+  r->mask = size - 1;
+  r->elem_size = elem_size;
+  /* Keep each cell's data on cache lines of its own. */
+  r->stride = 64 + ((elem_size + 63) & ~(size_t) 63);
+  if (posix_memalign((void **) &r->cells, 64, size * r->stride)) {
+    r->cells = NULL;
+    return -1;
+  }
+  memset(r->cells, 0, size * r->stride);
+  for (i = 0; i < size; ++i) atomic_init(ring_seq(r, i), i);
+  atomic_init(&r->head, 0);
+  atomic_init(&r->tail, 0);
+  return 0;
+}
+
+/* Wipes and frees the ring's cells. */
+static inline void
+ring_destroy(struct ring *r) {
+  if (!r->cells) return;
+  ring_wipe(r->cells, (r->mask + 1) * r->stride);
+  free(r->cells);
+  r->cells = NULL;
+}
+
+static inline size_t
+ring_capacity(const struct ring *r) {
+  return r->mask + 1;
+}
+
+/* Returns the number of elements in the ring. With concurrent pushes and pops
+ * this is only a snapshot. */
+static inline size_t
+ring_size(struct ring *r) {
+  const size_t head = atomic_load(&r->head);
+  const size_t tail = atomic_load(&r->tail);
+  return tail - head > r->mask ? r->mask + 1 : tail - head;
+}
+
+/* Appends an element. Returns 0 on success or -1 if the ring is full. */
+static inline int
+ring_push(struct ring *r, const void *elem) {
+  size_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+  for (;;) {
+    const size_t seq =
+        atomic_load_explicit(ring_seq(r, pos), memory_order_acquire);
+    const intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak(&r->tail, &pos, pos + 1)) break;
+    } else if (diff < 0) {
+      return -1;
+    } else {
+      pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    }
+  }
+
+  memcpy(ring_data(r, pos), elem, r->elem_size);
+  atomic_store_explicit(ring_seq(r, pos), pos + 1, memory_order_release);
+  return 0;
+}
+
+/* Removes the oldest element and wipes its cell. Returns 0 on success or -1 if
+ * the ring is empty. */
+static inline int
+ring_pop(struct ring *r, void *elem) {
+  size_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+  for (;;) {
+    const size_t seq =
+        atomic_load_explicit(ring_seq(r, pos), memory_order_acquire);
+    const intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak(&r->head, &pos, pos + 1)) break;
+    } else if (diff < 0) {
+      return -1;
+    } else {
+      pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    }
+  }
+
+  memcpy(elem, ring_data(r, pos), r->elem_size);
+  ring_wipe(ring_data(r, pos), r->elem_size);
+  atomic_store_explicit(ring_seq(r, pos), pos + r->mask + 1,
+                        memory_order_release);
+  return 0;
+}
+
+#endif  /* CURVE25519_DONNA_RING_H */
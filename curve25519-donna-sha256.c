@@ -0,0 +1,133 @@
+/* curve25519-donna: SHA-256
+ *
+ * Code released into the public domain.
+ *
+ * A straightforward implementation of SHA-256 from FIPS 180-4.
+ */
+
+#include <string.h>
+
+#include "curve25519-donna-sha256.h"
+
+typedef uint8_t u8;
+
+static const uint32_t K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+  0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+  0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+  0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static uint32_t
+load_be32(const u8 *in) {
+  return
+    (((uint32_t)in[0]) << 24) |
+    (((uint32_t)in[1]) << 16) |
+    (((uint32_t)in[2]) << 8) |
+    ((uint32_t)in[3]);
+}
+
+static void
+store_be32(u8 *out, uint32_t in) {
+  unsigned i;
+
+  for (i = 0; i < 4; ++i) out[i] = in >> (24 - 8 * i);
+}
+
+static void
+sha256_block(uint32_t *state, const u8 *block) {
+  uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+  unsigned i;
+
+  for (i = 0; i < 16; ++i) w[i] = load_be32(block + 4 * i);
+  for (; i < 64; ++i) {
+    const uint32_t s0 =
+        ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    const uint32_t s1 =
+        ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  a = state[0]; b = state[1]; c = state[2]; d = state[3];
+  e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+  for (i = 0; i < 64; ++i) {
+    t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) +
+         ((e & f) ^ (~e & g)) + K[i] + w[i];
+    t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) +
+         ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+
+  state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+  state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void
+curve25519_donna_sha256_init(struct curve25519_donna_sha256_ctx *ctx) {
+  static const uint32_t iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+
+  memcpy(ctx->state, iv, sizeof(iv));
+  ctx->count = 0;
+}
+
+void
+curve25519_donna_sha256_update(struct curve25519_donna_sha256_ctx *ctx,
+                               const u8 *in, size_t len) {
+  unsigned used = ctx->count % 64;
+
+  ctx->count += len;
+  if (used) {
+    const unsigned n = len < 64 - used ? len : 64 - used;
+    memcpy(ctx->buf + used, in, n);
+    in += n;
+    len -= n;
+    if (used + n < 64) return;
+    sha256_block(ctx->state, ctx->buf);
+  }
+  for (; len >= 64; in += 64, len -= 64) sha256_block(ctx->state, in);
+  memcpy(ctx->buf, in, len);
+}
+
+void
+curve25519_donna_sha256_final(struct curve25519_donna_sha256_ctx *ctx,
+                              u8 *out) {
+  const uint64_t bits = ctx->count * 8;
+  unsigned used = ctx->count % 64, i;
+
+  ctx->buf[used++] = 0x80;
+  if (used > 56) {
+    memset(ctx->buf + used, 0, 64 - used);
+    sha256_block(ctx->state, ctx->buf);
+    used = 0;
+  }
+  memset(ctx->buf + used, 0, 56 - used);
+  store_be32(ctx->buf + 56, bits >> 32);
+  store_be32(ctx->buf + 60, bits);
+  sha256_block(ctx->state, ctx->buf);
+
+  for (i = 0; i < 8; ++i) store_be32(out + 4 * i, ctx->state[i]);
+  memset(ctx, 0, sizeof(*ctx));
+}
+
+void
+curve25519_donna_sha256(u8 *out, const u8 *in, size_t len) {
+  struct curve25519_donna_sha256_ctx ctx;
+
+  curve25519_donna_sha256_init(&ctx);
+  curve25519_donna_sha256_update(&ctx, in, len);
+  curve25519_donna_sha256_final(&ctx, out);
+}
@@ -0,0 +1,30 @@
+/* curve25519-donna: SHA-256
+ *
+ * Code released into the public domain.
+ *
+ * SHA-256 (FIPS 180-4), as needed by HKDF-SHA256. This header is used by the
+ * library's .c files; it is not part of the public interface.
+ */
+
+#ifndef CURVE25519_DONNA_SHA256_H
+#define CURVE25519_DONNA_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct curve25519_donna_sha256_ctx {
+  uint32_t state[8];
+  uint64_t count;      /* bytes hashed so far */
+  uint8_t buf[64];
+};
+
+void curve25519_donna_sha256_init(struct curve25519_donna_sha256_ctx *ctx);
+void curve25519_donna_sha256_update(struct curve25519_donna_sha256_ctx *ctx,
+                                    const uint8_t *in, size_t len);
+void curve25519_donna_sha256_final(struct curve25519_donna_sha256_ctx *ctx,
+                                   uint8_t *out);
+
+/* Computes out (32 bytes) = SHA-256(in). */
+void curve25519_donna_sha256(uint8_t *out, const uint8_t *in, size_t len);
+
+#endif  /* CURVE25519_DONNA_SHA256_H */
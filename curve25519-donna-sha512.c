@@ -0,0 +1,156 @@
+/* curve25519-donna: SHA-512
+ *
+ * Code released into the public domain.
+ *
+ * A straightforward implementation of SHA-512 from FIPS 180-4.
+ */
+
+#include <string.h>
+
+#include "curve25519-donna-sha512.h"
+
+typedef uint8_t u8;
+
+static const uint64_t K[80] = {
+  0x428a2f98d728ae22ull, 0x7137449123ef65cdull, 0xb5c0fbcfec4d3b2full,
+  0xe9b5dba58189dbbcull, 0x3956c25bf348b538ull, 0x59f111f1b605d019ull,
+  0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull, 0xd807aa98a3030242ull,
+  0x12835b0145706fbeull, 0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+  0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull, 0x9bdc06a725c71235ull,
+  0xc19bf174cf692694ull, 0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull,
+  0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull, 0x2de92c6f592b0275ull,
+  0x4a7484aa6ea6e483ull, 0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+  0x983e5152ee66dfabull, 0xa831c66d2db43210ull, 0xb00327c898fb213full,
+  0xbf597fc7beef0ee4ull, 0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull,
+  0x06ca6351e003826full, 0x142929670a0e6e70ull, 0x27b70a8546d22ffcull,
+  0x2e1b21385c26c926ull, 0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+  0x650a73548baf63deull, 0x766a0abb3c77b2a8ull, 0x81c2c92e47edaee6ull,
+  0x92722c851482353bull, 0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull,
+  0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull, 0xd192e819d6ef5218ull,
+  0xd69906245565a910ull, 0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+  0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull, 0x2748774cdf8eeb99ull,
+  0x34b0bcb5e19b48a8ull, 0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull,
+  0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull, 0x748f82ee5defb2fcull,
+  0x78a5636f43172f60ull, 0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+  0x90befffa23631e28ull, 0xa4506cebde82bde9ull, 0xbef9a3f7b2c67915ull,
+  0xc67178f2e372532bull, 0xca273eceea26619cull, 0xd186b8c721c0c207ull,
+  0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull, 0x06f067aa72176fbaull,
+  0x0a637dc5a2c898a6ull, 0x113f9804bef90daeull, 0x1b710b35131c471bull,
+  0x28db77f523047d84ull, 0x32caab7b40c72493ull, 0x3c9ebe0a15c9bebcull,
+  0x431d67c49c100d4cull, 0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull,
+  0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+static uint64_t
+load_be64(const u8 *in) {
+  return
+    (((uint64_t)in[0]) << 56) |
+    (((uint64_t)in[1]) << 48) |
+    (((uint64_t)in[2]) << 40) |
+    (((uint64_t)in[3]) << 32) |
+    (((uint64_t)in[4]) << 24) |
+    (((uint64_t)in[5]) << 16) |
+    (((uint64_t)in[6]) << 8) |
+    ((uint64_t)in[7]);
+}
+
+static void
+store_be64(u8 *out, uint64_t in) {
+  unsigned i;
+
+  for (i = 0; i < 8; ++i) out[i] = in >> (56 - 8 * i);
+}
+
+static void
+sha512_block(uint64_t *state, const u8 *block) {
+  uint64_t w[80], a, b, c, d, e, f, g, h, t1, t2;
+  unsigned i;
+
+  for (i = 0; i < 16; ++i) w[i] = load_be64(block + 8 * i);
+  for (; i < 80; ++i) {
+    const uint64_t s0 =
+        ROTR(w[i - 15], 1) ^ ROTR(w[i - 15], 8) ^ (w[i - 15] >> 7);
+    const uint64_t s1 =
+        ROTR(w[i - 2], 19) ^ ROTR(w[i - 2], 61) ^ (w[i - 2] >> 6);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  a = state[0]; b = state[1]; c = state[2]; d = state[3];
+  e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+  for (i = 0; i < 80; ++i) {
+    t1 = h + (ROTR(e, 14) ^ ROTR(e, 18) ^ ROTR(e, 41)) +
+         ((e & f) ^ (~e & g)) + K[i] + w[i];
+    t2 = (ROTR(a, 28) ^ ROTR(a, 34) ^ ROTR(a, 39)) +
+         ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+
+  state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+  state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void
+curve25519_donna_sha512_init(struct curve25519_donna_sha512_ctx *ctx) {
+  static const uint64_t iv[8] = {
+    0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull,
+    0xa54ff53a5f1d36f1ull, 0x510e527fade682d1ull, 0x9b05688c2b3e6c1full,
+    0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull,
+  };
+
+  memcpy(ctx->state, iv, sizeof(iv));
+  ctx->count = 0;
+}
+
+void
+curve25519_donna_sha512_update(struct curve25519_donna_sha512_ctx *ctx,
+                               const u8 *in, size_t len) {
+  unsigned used = ctx->count % 128;
+
+  ctx->count += len;
+  if (used) {
+    const unsigned n = len < 128 - used ? len : 128 - used;
+    memcpy(ctx->buf + used, in, n);
+    in += n;
+    len -= n;
+    if (used + n < 128) return;
+    sha512_block(ctx->state, ctx->buf);
+  }
+  for (; len >= 128; in += 128, len -= 128) sha512_block(ctx->state, in);
+  memcpy(ctx->buf, in, len);
+}
+
+void
+curve25519_donna_sha512_final(struct curve25519_donna_sha512_ctx *ctx,
+                              u8 *out) {
+  const uint64_t bits = ctx->count * 8;
+  unsigned used = ctx->count % 128, i;
+
+  ctx->buf[used++] = 0x80;
+  if (used > 112) {
+    memset(ctx->buf + used, 0, 128 - used);
+    sha512_block(ctx->state, ctx->buf);
+    used = 0;
+  }
+  memset(ctx->buf + used, 0, 112 - used);
+  /* The count is in bytes, so the high 64 bits of the length are the top
+   * three bits of the count. */
+  store_be64(ctx->buf + 112, ctx->count >> 61);
+  store_be64(ctx->buf + 120, bits);
+  sha512_block(ctx->state, ctx->buf);
+
+  for (i = 0; i < 8; ++i) store_be64(out + 8 * i, ctx->state[i]);
+  memset(ctx, 0, sizeof(*ctx));
+}
+
+void
+curve25519_donna_sha512(u8 *out, const u8 *in, size_t len) {
+  struct curve25519_donna_sha512_ctx ctx;
+
+  curve25519_donna_sha512_init(&ctx);
+  curve25519_donna_sha512_update(&ctx, in, len);
+  curve25519_donna_sha512_final(&ctx, out);
+}
@@ -0,0 +1,30 @@
+/* curve25519-donna: SHA-512
+ *
+ * Code released into the public domain.
+ *
+ * SHA-512 (FIPS 180-4), as needed by Ed25519. This header is used by the
+ * library's .c files; it is not part of the public interface.
+ */
+
+#ifndef CURVE25519_DONNA_SHA512_H
+#define CURVE25519_DONNA_SHA512_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct curve25519_donna_sha512_ctx {
+  uint64_t state[8];
+  uint64_t count;      /* bytes hashed so far */
+  uint8_t buf[128];
+};
+
+void curve25519_donna_sha512_init(struct curve25519_donna_sha512_ctx *ctx);
+void curve25519_donna_sha512_update(struct curve25519_donna_sha512_ctx *ctx,
+                                    const uint8_t *in, size_t len);
+void curve25519_donna_sha512_final(struct curve25519_donna_sha512_ctx *ctx,
+                                   uint8_t *out);
+
+/* Computes out (64 bytes) = SHA-512(in). */
+void curve25519_donna_sha512(uint8_t *out, const uint8_t *in, size_t len);
+
+#endif  /* CURVE25519_DONNA_SHA512_H */
@@ -0,0 +1,191 @@
+/* curve25519-donna: call latency histograms
+ *
+ * Code released into the public domain.
+ *
+ * Each thread records into a block of its own, which it takes the first time
+ * it records. Blocks are pushed onto a lock-free list and never freed: when a
+ * thread exits its block is marked unowned, keeping its counts, and the next
+ * new thread takes it over. A snapshot walks the list and sums the blocks.
+ *
+ * Only the owner writes a block's counters, so a relaxed load and store is
+ * enough to bump one, and readers never see a torn value. Blocks start on a
+ * cache line and are padded to a whole number of them, with the list links on
+ * a line of their own, so that no two threads write to one line.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "curve25519-donna-telemetry.h"
+
+struct telemetry_block {
+  _Alignas(64) atomic_uint_fast64_t
+      counts[CURVE25519_PROBES][CURVE25519_TELEMETRY_BUCKETS];
+  atomic_uint_fast64_t calls[CURVE25519_PROBES];
+  atomic_uint_fast64_t ticks[CURVE25519_PROBES];
+  _Alignas(64) atomic_int owned;
+  struct telemetry_block *next;
+};
+
+static _Atomic(struct telemetry_block *) blocks;
+static __thread struct telemetry_block *thread_block;
+
+static pthread_key_t release_key;
+static pthread_once_t release_once = PTHREAD_ONCE_INIT;
+
+static void
+release_block(void *arg) {
+  struct telemetry_block *const b = arg;
+  atomic_store_explicit(&b->owned, 0, memory_order_release);
+}
+
+static void
+release_key_init(void) {
+  if (pthread_key_create(&release_key, release_block)) abort();
+}
+
+/* Takes an unowned block, or adds a new one. Returns NULL if there is no
+ * memory, in which case the thread records nothing. */
+static struct telemetry_block *
+acquire_block(void) {
+  struct telemetry_block *b;
+  int unowned;
+
+  pthread_once(&release_once, release_key_init);
+
+  for (b = atomic_load_explicit(&blocks, memory_order_acquire); b;
+       b = b->next) {
+    unowned = 0;
+    if (atomic_compare_exchange_strong(&b->owned, &unowned, 1)) break;
+  }
+  if (!b) {
+    if (posix_memalign((void **) &b, 64, sizeof(*b))) return NULL;
+    memset(b, 0, sizeof(*b));
+    atomic_init(&b->owned, 1);
+    b->next = atomic_load_explicit(&blocks, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&blocks, &b->next, b,
+                                                  memory_order_release,
+                                                  memory_order_relaxed)) {}
+  }
+
+  pthread_setspecific(release_key, b);
+  return b;
+}
+
+static unsigned
+bucket_of(uint64_t ticks) {
+  unsigned e, bucket;
+
+  if (ticks < 8) return ticks;
+  e = 63 - __builtin_clzll(ticks);
+  bucket = (e - 2) * 8 + ((ticks >> (e - 3)) & 7);
+  return bucket < CURVE25519_TELEMETRY_BUCKETS ?
+      bucket : CURVE25519_TELEMETRY_BUCKETS - 1;
+}
+
+static void
+bump(atomic_uint_fast64_t *counter, uint64_t n) {
+  atomic_store_explicit(
+      counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+      memory_order_relaxed);
+}
+
+void
+curve25519_telemetry_record(enum curve25519_probe probe, uint64_t ticks) {
+  struct telemetry_block *b = thread_block;
+
+  if (!b) {
+    b = thread_block = acquire_block();
+    if (!b) return;
+  }
+  bump(&b->counts[probe][bucket_of(ticks)], 1);
+  bump(&b->calls[probe], 1);
+  bump(&b->ticks[probe], ticks);
+}
+
+void
+curve25519_telemetry_snapshot(struct curve25519_telemetry *out) {
+  const struct telemetry_block *b;
+  unsigned p, i;
+
+  memset(out, 0, sizeof(*out));
+  for (b = atomic_load_explicit(&blocks, memory_order_acquire); b;
+       b = b->next) {
+    for (p = 0; p < CURVE25519_PROBES; ++p) {
+      for (i = 0; i < CURVE25519_TELEMETRY_BUCKETS; ++i) {
+        out->counts[p][i] +=
+            atomic_load_explicit(&b->counts[p][i], memory_order_relaxed);
+      }
+      out->calls[p] += atomic_load_explicit(&b->calls[p],
+                                            memory_order_relaxed);
+      out->ticks[p] += atomic_load_explicit(&b->ticks[p],
+                                            memory_order_relaxed);
+    }
+  }
+}
+
+uint64_t
+curve25519_telemetry_bucket_floor(unsigned bucket) {
+  if (bucket < 8) return bucket;
+  return (uint64_t) (8 + bucket % 8) << (bucket / 8 - 1);
+}
+
+uint64_t
+curve25519_telemetry_quantile(const struct curve25519_telemetry *snapshot,
+                              enum curve25519_probe probe, double q) {
+  uint64_t total = 0, seen = 0, rank;
+  unsigned i;
+
+  for (i = 0; i < CURVE25519_TELEMETRY_BUCKETS; ++i) {
+    total += snapshot->counts[probe][i];
+  }
+  if (!total) return 0;
+  rank = q <= 0 ? 1 : q >= 1 ? total : (uint64_t) (q * total + 0.5);
+  if (rank < 1) rank = 1;
+
+  for (i = 0; i < CURVE25519_TELEMETRY_BUCKETS; ++i) {
+    seen += snapshot->counts[probe][i];
+    if (seen >= rank) break;
+  }
+  return curve25519_telemetry_bucket_floor(i);
+}
+
+int
+curve25519_telemetry_export(const char *name) {
+  struct curve25519_telemetry_segment *seg;
+  const size_t size = sizeof(*seg);
+  uint64_t seq;
+  int fd, saved_errno;
+
+  fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) return -1;
+  if (ftruncate(fd, size)) goto fail;
+  seg = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (seg == MAP_FAILED) goto fail;
+  close(fd);
+
+  seq = __atomic_load_n(&seg->seq, __ATOMIC_RELAXED) | 1;
+  __atomic_store_n(&seg->seq, seq, __ATOMIC_RELAXED);
+  atomic_thread_fence(memory_order_release);
+  seg->magic = CURVE25519_TELEMETRY_MAGIC;
+  seg->probes = CURVE25519_PROBES;
+  seg->buckets = CURVE25519_TELEMETRY_BUCKETS;
+  curve25519_telemetry_snapshot(&seg->snapshot);
+  __atomic_store_n(&seg->seq, seq + 1, __ATOMIC_RELEASE);
+
+  munmap(seg, size);
+  return 0;
+
+fail:
+  saved_errno = errno;
+  close(fd);
+  errno = saved_errno;
+  return -1;
+}
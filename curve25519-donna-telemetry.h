@@ -0,0 +1,102 @@
+/* curve25519-donna: call latency histograms
+ *
+ * Code released into the public domain.
+ *
+ * When the 64-bit library is built with -DCURVE25519_DONNA_TELEMETRY, each
+ * of its entry points, and each ladder backend they run, records how long
+ * every call took in a histogram that belongs to the calling thread.
+ * Recording reads the time stamp counter twice and bumps three counters, a
+ * histogram bucket, a call count and a tick total, with no locks and in
+ * cache lines that no other thread writes. Without the flag nothing is recorded
+ * and the snapshots below are all zeros.
+ *
+ * Times are in time stamp counter ticks on x86-64 and in nanoseconds
+ * elsewhere. Histograms are log-linear, like HdrHistogram with three
+ * significant bits: bucket b holds the times from
+ * curve25519_telemetry_bucket_floor(b) up to the next bucket's floor, which
+ * is at most 12.5% higher.
+ */
+
+#ifndef CURVE25519_DONNA_TELEMETRY_H
+#define CURVE25519_DONNA_TELEMETRY_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum curve25519_probe {
+  /* Entry points. */
+  CURVE25519_PROBE_DONNA,
+  CURVE25519_PROBE_X2,
+  CURVE25519_PROBE_BATCH,
+  CURVE25519_PROBE_FANOUT,
+  CURVE25519_PROBE_EPHEMERAL,
+  CURVE25519_PROBE_TABLE_MULT,
+  CURVE25519_PROBE_ED25519_VERIFY,
+  CURVE25519_PROBE_ED25519_VERIFY_BATCH,
+  CURVE25519_PROBE_ENUMERATE,
+  CURVE25519_PROBE_HANDSHAKES,
+  CURVE25519_PROBE_DERIVE,
+  /* Ladder backends, one record per ladder or group of ladders. */
+  CURVE25519_PROBE_LADDER,       /* one ladder */
+  CURVE25519_PROBE_LADDER_X2,    /* two interleaved ladders */
+  CURVE25519_PROBE_LADDER_LANES, /* four ladders in AVX2 lanes */
+  CURVE25519_PROBE_LADDER_LANES8, /* eight ladders in AVX-512 lanes */
+  CURVE25519_PROBE_LADDER_FLANES, /* four ladders in double-precision lanes */
+  CURVE25519_PROBE_LADDER_EDWARDS, /* one windowed Edwards multiplication */
+  CURVE25519_PROBES
+};
+
+#define CURVE25519_TELEMETRY_BUCKETS 320
+
+struct curve25519_telemetry {
+  uint64_t counts[CURVE25519_PROBES][CURVE25519_TELEMETRY_BUCKETS];
+  uint64_t calls[CURVE25519_PROBES];
+  uint64_t ticks[CURVE25519_PROBES];  /* total over all calls */
+};
+
+/* What curve25519_telemetry_export writes. seq is odd while the snapshot is
+ * being written; a reader copies the snapshot between two reads of seq and
+ * retries unless both found the same even value. */
+struct curve25519_telemetry_segment {
+  uint32_t magic;  /* CURVE25519_TELEMETRY_MAGIC */
+  uint32_t probes;
+  uint32_t buckets;
+  uint32_t reserved;
+  uint64_t seq;
+  struct curve25519_telemetry snapshot;
+};
+
+#define CURVE25519_TELEMETRY_MAGIC 0x54353243u  /* "C25T" in memory */
+
+/* Records one call of probe that took ticks in the calling thread's
+ * histograms. The library calls this itself; it is only exported for it. */
+void curve25519_telemetry_record(enum curve25519_probe probe, uint64_t ticks);
+
+/* Sums the histograms of every thread that has called into the library, live
+ * or exited, into out. It takes no locks, so counts that are being recorded
+ * meanwhile may or may not be included. */
+void curve25519_telemetry_snapshot(struct curve25519_telemetry *out);
+
+/* Returns the smallest time that falls into bucket. */
+uint64_t curve25519_telemetry_bucket_floor(unsigned bucket);
+
+/* Returns the floor of the bucket that holds the q-th quantile (0 <= q <= 1)
+ * of the times of probe in snapshot, or 0 if there are none. */
+uint64_t curve25519_telemetry_quantile(
+    const struct curve25519_telemetry *snapshot, enum curve25519_probe probe,
+    double q);
+
+/* Takes a snapshot and writes it, as a struct curve25519_telemetry_segment, to
+ * the POSIX shared memory object name (as for shm_open), creating it with
+ * mode 0644 if needed. Call it periodically for a sidecar to read. Returns 0,
+ * or -1 with errno set. */
+int curve25519_telemetry_export(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* CURVE25519_DONNA_TELEMETRY_H */
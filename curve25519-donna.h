@@ -0,0 +1,297 @@
+/* curve25519-donna: Curve25519 elliptic curve, public key function
+ *
+ * http://code.google.com/p/curve25519-donna/
+ *
+ * Code released into the public domain.
+ *
+ * curve25519_donna is provided by both curve25519-donna.a and
+ * curve25519-donna-c64.a. The remaining functions are only provided by the
+ * 64-bit implementation.
+ */
+
+#ifndef CURVE25519_DONNA_H
+#define CURVE25519_DONNA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Computes mypublic = secret * basepoint. The secret is clamped internally.
+ * Use a basepoint of {9} to generate a public key. */
+int curve25519_donna(uint8_t *mypublic, const uint8_t *secret,
+                     const uint8_t *basepoint);
+
+/* Computes two independent scalar multiplications, so that mypublic[i] =
+ * curve25519_donna(secret[i], basepoint[i]) for i = 0, 1, where each argument
+ * is an array of two 32-byte values. The two ladders are interleaved, which
+ * keeps a 64-bit CPU's multiplier busier than one ladder at a time does,
+ * without needing any vector instructions. mypublic may alias secret. */
+int curve25519_donna_x2(uint8_t *mypublic, const uint8_t *secret,
+                        const uint8_t *basepoint);
+
+/* Computes n independent scalar multiplications. Each argument is an array of
+ * n 32-byte values and mypublic[i] = curve25519_donna(secret[i],
+ * basepoint[i]). If basepoint is NULL, the standard base point is used for
+ * every element. mypublic may alias secret. This is the entry point for bulk
+ * jobs: the ladders run several at a time on the backend of
+ * curve25519_donna_get_backend. */
+int curve25519_donna_batch(uint8_t *mypublic, const uint8_t *secret,
+                           const uint8_t *basepoint, size_t n);
+
+/* The ladder backends that curve25519_donna_batch and the other functions of
+ * many scalar multiplications choose from. */
+enum curve25519_donna_backend {
+  CURVE25519_BACKEND_AUTO,    /* the fastest ladder here, timed when first
+                                 needed */
+  CURVE25519_BACKEND_SCALAR,  /* 51-bit limbs, one or two ladders at a time */
+  CURVE25519_BACKEND_AVX2,    /* four ladders in 64-bit integer lanes */
+  CURVE25519_BACKEND_AVX512,  /* eight ladders in 64-bit integer lanes */
+  CURVE25519_BACKEND_FLOAT,   /* four ladders in doubles, with AVX2 and FMA */
+  CURVE25519_BACKEND_EDWARDS  /* one signed-window Edwards multiplication at a
+                                 time, for curve25519_donna too; only when
+                                 set */
+};
+
+/* Makes the library use backend, for benchmarks and tests. Returns 0, or -1,
+ * changing nothing, if this CPU cannot run it. Not to be called while other
+ * threads are using the library. */
+int curve25519_donna_set_backend(enum curve25519_donna_backend backend);
+
+/* Returns the backend in use, never CURVE25519_BACKEND_AUTO. Unless one was
+ * set, the first call times a group of ladders on each ladder backend the CPU
+ * supports, which takes a few milliseconds, and keeps the fastest. Only the
+ * functions of many multiplications call this; curve25519_donna runs the
+ * scalar ladder unless CURVE25519_BACKEND_EDWARDS was set. */
+enum curve25519_donna_backend curve25519_donna_get_backend(void);
+
+/* Computes the shared keys between one secret and n peers, so that shared[i]
+ * = curve25519_donna(secret, peers[i]). shared and peers are arrays of n
+ * 32-byte values and may alias. */
+int curve25519_donna_fanout(uint8_t *shared, const uint8_t *secret,
+                            const uint8_t *peers, size_t n);
+
+/* The most Diffie-Hellman operations that one handshake message has: es, ss,
+ * ee and se in Noise's terms. */
+#define CURVE25519_DONNA_HANDSHAKE_DH 4
+
+/* The Diffie-Hellman operations of one handshake message, such as a message
+ * of a Noise IK or XX handshake. secret[k] is a local private key, e or s, and
+ * peer[k] the remote public key, re or rs, of the k-th operation. The caller
+ * fills in count, secret and peer; curve25519_donna_handshakes fills in shared
+ * and result. */
+struct curve25519_donna_handshake {
+  unsigned count;
+  const uint8_t *secret[CURVE25519_DONNA_HANDSHAKE_DH];
+  const uint8_t *peer[CURVE25519_DONNA_HANDSHAKE_DH];
+  uint8_t shared[CURVE25519_DONNA_HANDSHAKE_DH][32];
+  int result;  /* 0, or -1 if the message is to be rejected */
+};
+
+/* Computes shared[k] = curve25519_donna(secret[k], peer[k]) for the count
+ * operations of each of the n messages at h, with the operations of all the
+ * messages run as one batch, like curve25519_donna_batch. A message's result
+ * is -1, and all its shared keys are zeroed, if count is over
+ * CURVE25519_DONNA_HANDSHAKE_DH or any of its shared keys is all zeros, which
+ * happens exactly when that peer is a point of small order (RFC 7748, section
+ * 6.1). Returns 0, or -1 if any message's result is -1.
+ *
+ * Only operations whose keys are all known can be batched. A Noise responder
+ * learns rs by decrypting it with a key mixed from es, so on that side es and
+ * ss of a message go in separate calls. */
+int curve25519_donna_handshakes(struct curve25519_donna_handshake *h,
+                                size_t n);
+
+/* The number of steps of the ladder of one scalar multiplication. */
+#define CURVE25519_DONNA_LADDER_STEPS 255
+
+/* The state of a scalar multiplication that is computed a few steps at a
+ * time, so that a cooperative scheduler can run other work in between. The
+ * caller owns it and may keep it anywhere, and it holds no pointers, so it
+ * may be moved or copied between steps. It contains the clamped secret; the
+ * members are otherwise private. */
+struct curve25519_donna_ladder {
+  uint64_t x[5], z[5], xp[5], zp[5], q[5];
+  uint8_t e[32];
+  unsigned remaining;
+} __attribute__((aligned(32)));
+
+/* Starts computing curve25519_donna(secret, basepoint) into l. */
+void curve25519_donna_ladder_init(struct curve25519_donna_ladder *l,
+                                  const uint8_t *secret,
+                                  const uint8_t *basepoint);
+
+/* Runs up to steps more steps of the ladder, each about 1/300 of the time of
+ * curve25519_donna, and returns the number of steps left. Every call with
+ * the same steps takes the same time, whatever the secret. */
+unsigned curve25519_donna_ladder_step(struct curve25519_donna_ladder *l,
+                                      unsigned steps);
+
+/* Runs any steps that are left, stores the result in mypublic and wipes l.
+ * The final inversion costs about as much as 30 steps. Returns 0. */
+int curve25519_donna_ladder_finish(struct curve25519_donna_ladder *l,
+                                   uint8_t *mypublic);
+
+/* Computes both halves of an ephemeral-static exchange with one fresh secret:
+ * mypublic = curve25519_donna(secret, {9}) and shared =
+ * curve25519_donna(secret, peer), in about two thirds of the time of the two
+ * calls. The public key is computed with a table of the base point, like
+ * curve25519_donna_table_mult; the table (61KB) is built by the first call
+ * and kept for the life of the process. The outputs may alias the inputs. */
+int curve25519_donna_ephemeral(uint8_t *mypublic, uint8_t *shared,
+                               const uint8_t *secret, const uint8_t *peer);
+
+/* Returns 0 if sig (64 bytes) is a valid Ed25519 signature of the mlen-byte
+ * message m under the public key pk (32 bytes), and -1 otherwise. Signatures
+ * are checked as in RFC 8032 with the cofactored equation [8][S]B = [8]R +
+ * [8][k]A, so that this and curve25519_donna_ed25519_verify_batch always
+ * agree. Verification only involves public values and is not constant time. */
+int curve25519_donna_ed25519_verify(const uint8_t *sig, const uint8_t *m,
+                                    size_t mlen, const uint8_t *pk);
+
+/* Verifies n signatures, sig[i] of the mlen[i]-byte message m[i] under
+ * pk[i], much faster per signature than one call each. If valid is not NULL,
+ * valid[i] is set to 1 or 0 for each signature. Returns 0 if every signature
+ * is valid and -1 otherwise. */
+int curve25519_donna_ed25519_verify_batch(const uint8_t *const *m,
+                                          const size_t *mlen,
+                                          const uint8_t *const *pk,
+                                          const uint8_t *const *sig,
+                                          size_t n, int *valid);
+
+struct curve25519_donna_table;
+
+/* Returns the size in bytes of a table built with the given window, or 0 if
+ * the window is outside [2, 8]. Wider windows need fewer point additions per
+ * multiplication but give bigger tables, and the constant-time lookups, which
+ * read a whole row of the table for each addition, soon cost more than they
+ * save: 4, with a table of 61KB, is usually fastest. */
+size_t curve25519_donna_table_size(unsigned window);
+
+/* Precomputes a table for computing shared keys with the peer public key
+ * peer (32 bytes), for when many secrets are used with the same peer. Returns
+ * NULL if allocation fails or window is out of range. Building the table
+ * costs about as much as five calls to curve25519_donna with a window of 4,
+ * and proportionally more with bigger tables. */
+struct curve25519_donna_table *curve25519_donna_table_new(const uint8_t *peer,
+                                                          unsigned window);
+
+void curve25519_donna_table_free(struct curve25519_donna_table *table);
+
+/* Computes shared = curve25519_donna(secret, peer), where peer is the public
+ * key the table was built for, in less than half the time of
+ * curve25519_donna and likewise in constant time. If peer is not a point of
+ * the curve itself but of its twist, this just calls curve25519_donna. The
+ * table is only read, so it can be shared between threads. */
+int curve25519_donna_table_mult(uint8_t *shared,
+                                const struct curve25519_donna_table *table,
+                                const uint8_t *secret);
+
+/* Computes mypublic, the public key (32 bytes) that the Elligator 2
+ * representative (32 bytes) stands for. Every string is a representative;
+ * its top two bits are ignored. Returns 0. */
+int curve25519_donna_elligator_decode(uint8_t *mypublic,
+                                      const uint8_t *representative);
+
+/* Computes a representative (32 bytes) of the public key mypublic. Each
+ * representable key has two, which the low bit of tweak chooses between, and
+ * the top two bits of the representative are those of tweak, so a random
+ * tweak gives a uniformly random string. Returns 0, or -1 if mypublic has no
+ * representative, which is so for about half of all public keys. Keys made
+ * by curve25519_donna lie in the prime-order subgroup, which gives their
+ * representatives away after decoding; use
+ * curve25519_donna_elligator_keypairs for keys that are to be hidden. */
+int curve25519_donna_elligator_encode(uint8_t *representative,
+                                      const uint8_t *mypublic,
+                                      uint8_t tweak);
+
+/* Generates n fresh key pairs whose public keys have representatives, and
+ * stores their secrets, public keys and representatives (32 bytes each) in
+ * the three arrays. The public keys carry a random point of small order, so
+ * that they and their representatives are indistinguishable from random;
+ * they differ from curve25519_donna(secret, {9}) but give the same shared
+ * keys with any peer. This takes less than half the time of drawing
+ * secrets until curve25519_donna gives a representable key. Returns 0, or -1
+ * with errno set if the system's random number generator fails or memory for
+ * the base point's table cannot be allocated. */
+int curve25519_donna_elligator_keypairs(uint8_t *secrets, uint8_t *publics,
+                                        uint8_t *representatives, size_t n);
+
+/* Called by curve25519_donna_enumerate with each secret (clamped) and its
+ * public key. A nonzero return value stops the enumeration. */
+typedef int (*curve25519_donna_match)(const uint8_t *secret,
+                                      const uint8_t *mypublic, void *arg);
+
+/* Computes the public keys of the n secrets s, s + 8, s + 16, ..., where s is
+ * secret clamped and the secrets are little endian, and passes each in turn
+ * to match with arg, for key grinding. After a fixed-base multiplication for
+ * s, a key costs one point addition and a share of an inversion, a few
+ * percent of a call to curve25519_donna_table_mult. Returns the first nonzero
+ * value that match returned, 0 if there was none, or -1 with errno set if
+ * memory for the base point's table cannot be allocated or s + 8(n-1) is not
+ * below 2^255. The secrets are consecutive, so s must be fresh and random. */
+int curve25519_donna_enumerate(const uint8_t *secret, size_t n,
+                               curve25519_donna_match match, void *arg);
+
+/* What curve25519_donna_match_prefix looks for and what it found. */
+struct curve25519_donna_prefix {
+  const uint8_t *prefix;  /* compared from the top bit of its first byte */
+  unsigned bits;          /* at most 256 */
+  uint8_t secret[32];     /* set on a match */
+  uint8_t mypublic[32];   /* set on a match */
+};
+
+/* A curve25519_donna_match that takes a struct curve25519_donna_prefix and
+ * stops at the first public key whose leading bits equal those of prefix, in
+ * the order that base32 and hex encodings write them. */
+int curve25519_donna_match_prefix(const uint8_t *secret,
+                                  const uint8_t *mypublic, void *arg);
+
+/* Computes child, the public key of the child of the master public key under
+ * label (labellen bytes), without the master secret: u(P + [h]B), where P is
+ * the point of master with even x and h is SHA-512 of "curve25519-donna
+ * derive" (with its terminating zero), master and label, mod the group order.
+ * master is hashed in canonical form, with the top bit clear and u reduced mod
+ * p, so encodings that curve25519_donna reads as the same key give the same
+ * child.
+ * Besides decoding master, which takes a square root and an inversion, this
+ * costs a fixed-base multiplication, an addition and an inversion, so in a
+ * batch a child takes about a third of the time of curve25519_donna. master
+ * must be curve25519_donna(secret, {9}); keys with a small-order part, such
+ * as those of curve25519_donna_elligator_keypairs, give children that match
+ * no secret. Returns 0, or -1 with child zeroed if master is not on the
+ * curve, or with errno set if memory for the base point's table cannot be
+ * allocated. */
+int curve25519_donna_derive_public(uint8_t *child, const uint8_t *master,
+                                   const uint8_t *label, size_t labellen);
+
+/* Computes the n children of master under labels[i] (labellens[i] bytes), as
+ * curve25519_donna_derive_public does, into the array children of n 32-byte
+ * values, with the inversions shared between up to 32 children. */
+int curve25519_donna_derive_public_batch(uint8_t *children,
+                                         const uint8_t *master,
+                                         const uint8_t *const *labels,
+                                         const size_t *labellens, size_t n);
+
+/* Computes child, the secret of the child of the master secret under label,
+ * so that curve25519_donna(child, {9}) is curve25519_donna_derive_public of
+ * the master public key. child is a clamped secret like any other.
+ *
+ * This derivation is not hardened: the child's scalar is ±(a + h) for the
+ * master's scalar a and a public h, so anyone who holds one child secret and
+ * the master public key recovers the master secret, and with it every other
+ * child. Never hand a derived secret to a party that must not hold the
+ * master; derive such keys from independent secrets instead. Returns 0,
+ * or -1 with child zeroed, with probability about 2^-125, if the child's
+ * scalar has no clamped form, or with errno set if memory for the base
+ * point's table cannot be allocated. */
+int curve25519_donna_derive_secret(uint8_t *child, const uint8_t *master,
+                                   const uint8_t *label, size_t labellen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* CURVE25519_DONNA_H */
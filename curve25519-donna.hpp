@@ -0,0 +1,174 @@
+/* curve25519-donna: C++20 interface
+ *
+ * Code released into the public domain.
+ *
+ * Fixed-size key types and functions over them, for C++ callers that would
+ * otherwise pass keys around in vectors and strings. Nothing here allocates,
+ * throws or takes a lock; every function is a thin inline call into the C
+ * library.
+ *
+ *   curve25519::SecretKey secret(bytes);         // 32 random bytes
+ *   curve25519::PublicKey mine = curve25519::public_key(secret);
+ *   curve25519::SharedSecret shared = curve25519::shared_secret(secret, peer);
+ *   if (shared.is_zero()) ...                    // peer of small order
+ *
+ * PublicKey is a plain trivially copyable value. SecretKey and SharedSecret
+ * wipe themselves when destroyed, which a trivially copyable type cannot do,
+ * so they are copyable and movable but not trivially so. Moving one wipes the
+ * source.
+ *
+ * The batch overloads take spans of keys, which must be the same length, and
+ * return false without writing anything if they are not. Arrays of the key
+ * types are arrays of 32-byte strings, so the spans go straight to the batch
+ * entry points of curve25519-donna.h.
+ */
+
+#ifndef CURVE25519_DONNA_HPP
+#define CURVE25519_DONNA_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+#include "curve25519-donna.h"
+
+namespace curve25519 {
+
+inline constexpr std::size_t key_size = 32;
+
+namespace detail {
+
+inline void wipe(std::uint8_t *p, std::size_t n) noexcept {
+  volatile std::uint8_t *v = p;
+  while (n--) *v++ = 0;
+}
+
+/* The bytes of a key type, with the accessors all three share. */
+struct key_bytes {
+  std::array<std::uint8_t, key_size> bytes{};
+
+  constexpr std::uint8_t *data() noexcept { return bytes.data(); }
+  constexpr const std::uint8_t *data() const noexcept { return bytes.data(); }
+  static constexpr std::size_t size() noexcept { return key_size; }
+  constexpr std::span<const std::uint8_t, key_size> span() const noexcept {
+    return bytes;
+  }
+};
+
+/* A key_bytes that is wiped when destroyed or moved from. */
+struct secret_bytes : key_bytes {
+  secret_bytes() noexcept = default;
+  secret_bytes(const secret_bytes &) noexcept = default;
+  secret_bytes &operator=(const secret_bytes &) noexcept = default;
+  secret_bytes(secret_bytes &&other) noexcept : key_bytes(other) {
+    other.clear();
+  }
+  secret_bytes &operator=(secret_bytes &&other) noexcept {
+    bytes = other.bytes;
+    if (&other != this) other.clear();
+    return *this;
+  }
+  ~secret_bytes() { clear(); }
+
+  void clear() noexcept { wipe(bytes.data(), bytes.size()); }
+};
+
+}  // namespace detail
+
+struct PublicKey : detail::key_bytes {
+  constexpr PublicKey() noexcept = default;
+  /* constexpr, so that a key from curve25519-donna-constexpr.hpp can be a
+   * compile-time constant. */
+  constexpr explicit PublicKey(
+      std::span<const std::uint8_t, key_size> in) noexcept {
+    for (std::size_t i = 0; i < key_size; ++i) bytes[i] = in[i];
+  }
+
+  friend constexpr bool operator==(const PublicKey &a,
+                                   const PublicKey &b) noexcept {
+    return a.bytes == b.bytes;
+  }
+};
+
+class SecretKey : public detail::secret_bytes {
+ public:
+  SecretKey() noexcept = default;
+  /* The bytes are used as they are; curve25519_donna clamps them. */
+  explicit SecretKey(std::span<const std::uint8_t, key_size> in) noexcept {
+    for (std::size_t i = 0; i < key_size; ++i) bytes[i] = in[i];
+  }
+};
+
+class SharedSecret : public detail::secret_bytes {
+ public:
+  /* Returns whether every byte is zero, as it is exactly when the peer was a
+   * point of small order (RFC 7748, section 6.1). Constant time. */
+  bool is_zero() const noexcept {
+    unsigned acc = 0;
+    for (std::uint8_t b : bytes) acc |= b;
+    return ((acc - 1) >> 8) & 1;
+  }
+};
+
+static_assert(std::is_trivially_copyable_v<PublicKey>);
+static_assert(sizeof(PublicKey) == key_size && sizeof(SecretKey) == key_size &&
+              sizeof(SharedSecret) == key_size,
+              "arrays of keys are passed to the C batch functions as is");
+
+/* Returns the public key of secret. */
+inline PublicKey public_key(const SecretKey &secret) noexcept {
+  static const std::uint8_t basepoint[key_size] = {9};
+  PublicKey out;
+  curve25519_donna(out.data(), secret.data(), basepoint);
+  return out;
+}
+
+/* Returns the shared secret of secret and peer. It must be hashed before
+ * use; see curve25519-donna-kdf.h. */
+inline SharedSecret shared_secret(const SecretKey &secret,
+                                  const PublicKey &peer) noexcept {
+  SharedSecret out;
+  curve25519_donna(out.data(), secret.data(), peer.data());
+  return out;
+}
+
+/* out[i] = public_key(secrets[i]). */
+inline bool public_keys(std::span<const SecretKey> secrets,
+                        std::span<PublicKey> out) noexcept {
+  if (secrets.size() != out.size()) return false;
+  if (!out.empty()) {
+    curve25519_donna_batch(out.data()->data(), secrets.data()->data(), nullptr,
+                           out.size());
+  }
+  return true;
+}
+
+/* out[i] = shared_secret(secrets[i], peers[i]). */
+inline bool shared_secrets(std::span<const SecretKey> secrets,
+                           std::span<const PublicKey> peers,
+                           std::span<SharedSecret> out) noexcept {
+  if (secrets.size() != out.size() || peers.size() != out.size()) return false;
+  if (!out.empty()) {
+    curve25519_donna_batch(out.data()->data(), secrets.data()->data(),
+                           peers.data()->data(), out.size());
+  }
+  return true;
+}
+
+/* out[i] = shared_secret(secret, peers[i]): one secret against many peers. */
+inline bool shared_secrets(const SecretKey &secret,
+                           std::span<const PublicKey> peers,
+                           std::span<SharedSecret> out) noexcept {
+  if (peers.size() != out.size()) return false;
+  if (!out.empty()) {
+    curve25519_donna_fanout(out.data()->data(), secret.data(),
+                            peers.data()->data(), out.size());
+  }
+  return true;
+}
+
+}  // namespace curve25519
+
+#endif  // CURVE25519_DONNA_HPP
@@ -14,6 +14,11 @@
 	#define y "t"
 #endif
 
+#include <string.h>
+
+#include "../../curve25519-donna-internal.h"
+#include "../../curve25519-donna-sha256.h"
+
 int curve25519_donna(char *mypublic, 
                      const char *secret, const char *basepoint);
 
@@ -72,12 +77,44 @@ pycurve25519_makeshared(PyObject *self, PyObject *args)
     return PyBytes_FromStringAndSize((char *)shared_key, 32);
 }
 
+/* Like make_shared, followed by keys.py's _hash_shared, but the shared key
+ * itself never leaves this function. */
+static PyObject *
+pycurve25519_makesharedhashed(PyObject *self, PyObject *args)
+{
+    static const char prefix[] = "curve25519-shared:";
+    const char *myprivate, *theirpublic;
+    char shared_key[32];
+    uint8_t digest[32];
+    struct curve25519_donna_sha256_ctx ctx;
+    Py_ssize_t myprivatelen, theirpubliclen;
+    if (!PyArg_ParseTuple(args, y"#"y"#:generate_hashed",
+                          &myprivate, &myprivatelen, &theirpublic, &theirpubliclen))
+        return NULL;
+    if (myprivatelen != 32) {
+        PyErr_SetString(PyExc_ValueError, "input must be 32-byte string");
+        return NULL;
+    }
+    if (theirpubliclen != 32) {
+        PyErr_SetString(PyExc_ValueError, "input must be 32-byte string");
+        return NULL;
+    }
+    curve25519_donna(shared_key, myprivate, theirpublic);
+    curve25519_donna_sha256_init(&ctx);
+    curve25519_donna_sha256_update(&ctx, (const uint8_t *)prefix,
+                                   sizeof(prefix) - 1);
+    curve25519_donna_sha256_update(&ctx, (const uint8_t *)shared_key, 32);
+    curve25519_donna_sha256_final(&ctx, digest);
+    donna_memset(shared_key, 0, sizeof(shared_key));
+    return PyBytes_FromStringAndSize((char *)digest, 32);
+}
 
 static PyMethodDef
 curve25519_functions[] = {
     {"make_private", pycurve25519_makeprivate, METH_VARARGS, "data->private"},
     {"make_public", pycurve25519_makepublic, METH_VARARGS, "private->public"},
     {"make_shared", pycurve25519_makeshared, METH_VARARGS, "private+public->shared"},
+    {"make_shared_hashed", pycurve25519_makesharedhashed, METH_VARARGS, "private+public->sha256(shared)"},
     {NULL, NULL, 0, NULL},
 };
 
@@ -32,7 +32,8 @@ class Private:
         if not isinstance(public, Public):
             raise ValueError("'public' must be an instance of Public")
         if hashfunc is None:
-            hashfunc = _hash_shared
+            # The same as _hash_shared, without the raw key reaching Python.
+            return _curve25519.make_shared_hashed(self.private, public.public)
         shared = _curve25519.make_shared(self.private, public.public)
         return hashfunc(shared)
 
@@ -0,0 +1,255 @@
+/* Compares the per-operation cost of the batch entry points, including the
+ * two-way curve25519_donna_x2, with that of calling curve25519_donna once per
+ * operation, the cost of curve25519_donna_batch for growing batch sizes, which
+ * shows where each ladder backend takes over, and on each backend this CPU
+ * supports, the cost of a multiplication with a precomputed table for
+ * several window sizes, the cost of a key from curve25519_donna_enumerate,
+ * the cost of a derived child public key, alone and in a batch, and of a
+ * derived child secret, the cost of a key pair with an Elligator 2
+ * representative made either way, and the cost of a step of a chain of
+ * hashed Diffie-Hellman steps made either way. */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-kdf.h"
+
+#define N 32
+#define ROUNDS 1000
+#define DEPTH 8
+
+static const char *const backend_names[] = {
+  "auto", "scalar", "avx2", "avx512", "float", "edwards"
+};
+
+static uint64_t
+time_now() {
+  struct timeval tv;
+  uint64_t ret;
+
+  gettimeofday(&tv, NULL);
+  ret = tv.tv_sec;
+  ret *= 1000000;
+  ret += tv.tv_usec;
+
+  return ret;
+}
+
+static void
+report(const char *name, uint64_t start, uint64_t end) {
+  printf("%-10s %.2fus\n", name, (double) (end - start) / (ROUNDS * N));
+}
+
+static int
+match_none(const unsigned char *secret, const unsigned char *mypublic,
+           void *arg) {
+  (void) secret;
+  (void) arg;
+  return mypublic[0] == 0 && mypublic[1] == 0 && mypublic[2] == 0 &&
+         mypublic[3] == 0 && mypublic[4] == 0 && mypublic[5] == 0;
+}
+
+int
+main() {
+  static unsigned char secrets[N * 32], peers[N * 32], out[N * 32];
+  static unsigned char reps[N * 32], copath[N * DEPTH * 32];
+  static unsigned char path[N * (DEPTH + 1) * 32];
+  static unsigned char path_publics[N * (DEPTH + 1) * 32];
+  static const unsigned char basepoint[32] = {9};
+  const unsigned char *labels[N];
+  size_t labellens[N];
+  struct curve25519_donna_table *table;
+  char name[16];
+  unsigned i, j, k, window;
+  int backend;
+  uint64_t start, end;
+
+  memset(secrets, 42, sizeof(secrets));
+  for (i = 0; i < N; ++i) secrets[32 * i] = i;
+  curve25519_donna_batch(peers, secrets, NULL, N);
+
+  // Load the caches
+  for (i = 0; i < 10; ++i) {
+    curve25519_donna_batch(out, secrets, peers, N);
+  }
+
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    for (j = 0; j < N; ++j) {
+      curve25519_donna(out + 32 * j, secrets + 32 * j, peers + 32 * j);
+    }
+  }
+  end = time_now();
+  report("single", start, end);
+
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    curve25519_donna_batch(out, secrets, peers, N);
+  }
+  end = time_now();
+  report("batch", start, end);
+
+  // 1: one ladder, 2: two interleaved, 4: AVX2 lanes, 8: AVX-512 lanes.
+  for (k = 1; k <= N; k *= 2) {
+    start = time_now();
+    for (i = 0; i < ROUNDS; ++i) {
+      for (j = 0; j < N; j += k) {
+        curve25519_donna_batch(out + 32 * j, secrets + 32 * j,
+                               peers + 32 * j, k);
+      }
+    }
+    end = time_now();
+    sprintf(name, "batch/%u", k);
+    report(name, start, end);
+  }
+
+  for (backend = CURVE25519_BACKEND_SCALAR;
+       backend <= CURVE25519_BACKEND_EDWARDS; ++backend) {
+    if (curve25519_donna_set_backend(backend)) continue;
+    start = time_now();
+    for (i = 0; i < ROUNDS; ++i) {
+      curve25519_donna_batch(out, secrets, peers, N);
+    }
+    end = time_now();
+    report(backend_names[backend], start, end);
+  }
+  curve25519_donna_set_backend(CURVE25519_BACKEND_AUTO);
+  printf("%-10s %s\n", "auto", backend_names[curve25519_donna_get_backend()]);
+
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    for (j = 0; j < N; j += 2) {
+      curve25519_donna_x2(out + 32 * j, secrets + 32 * j, peers + 32 * j);
+    }
+  }
+  end = time_now();
+  report("x2", start, end);
+
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    curve25519_donna_batch(out, secrets, NULL, N);
+  }
+  end = time_now();
+  report("keygen", start, end);
+
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    curve25519_donna_fanout(out, secrets, peers, N);
+  }
+  end = time_now();
+  report("fanout", start, end);
+
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    for (j = 0; j < N; j += 2) {
+      curve25519_donna_ephemeral(out + 32 * j, out + 32 * j + 32,
+                                 secrets + 32 * j, peers + 32 * j);
+    }
+  }
+  end = time_now();
+  report("ephemeral", start, end);
+
+  for (window = 2; window <= 8; ++window) {
+    table = curve25519_donna_table_new(peers, window);
+    start = time_now();
+    for (i = 0; i < ROUNDS; ++i) {
+      for (j = 0; j < N; ++j) {
+        curve25519_donna_table_mult(out + 32 * j, table, secrets + 32 * j);
+      }
+    }
+    end = time_now();
+    sprintf(name, "table/%u", window);
+    report(name, start, end);
+    curve25519_donna_table_free(table);
+  }
+
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    curve25519_donna_enumerate(secrets, N, match_none, NULL);
+  }
+  end = time_now();
+  report("enumerate", start, end);
+
+  /* Children of one master under N labels of eight bytes. */
+  for (j = 0; j < N; ++j) {
+    labels[j] = secrets + 32 * j;
+    labellens[j] = 8;
+  }
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    for (j = 0; j < N; ++j) {
+      curve25519_donna_derive_public(out + 32 * j, peers, labels[j], 8);
+    }
+  }
+  end = time_now();
+  report("derive/one", start, end);
+
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    curve25519_donna_derive_public_batch(out, peers, labels, labellens, N);
+  }
+  end = time_now();
+  report("derive/pub", start, end);
+
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    for (j = 0; j < N; ++j) {
+      curve25519_donna_derive_secret(reps + 32 * j, secrets, labels[j], 8);
+    }
+  }
+  end = time_now();
+  report("derive/sec", start, end);
+
+  /* Drawing secrets until one gives a representable key, as without
+   * curve25519_donna_elligator_keypairs. */
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    for (j = 0; j < N; ++j) {
+      do {
+        secrets[32 * j + 1]++;
+        curve25519_donna(out + 32 * j, secrets + 32 * j, basepoint);
+      } while (curve25519_donna_elligator_encode(reps + 32 * j, out + 32 * j,
+                                                 0));
+    }
+  }
+  end = time_now();
+  report("repr/loop", start, end);
+
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    curve25519_donna_elligator_keypairs(secrets, out, reps, N);
+  }
+  end = time_now();
+  report("repr/batch", start, end);
+
+  /* One round is DEPTH steps of N chains, so these report per step. */
+  memset(copath, 9, sizeof(copath));
+  start = time_now();
+  for (i = 0; i < ROUNDS / DEPTH; ++i) {
+    for (j = 0; j < N; ++j) {
+      memcpy(path, secrets + 32 * j, 32);
+      for (k = 0; k < DEPTH; ++k) {
+        curve25519_donna(out, path, basepoint);
+        curve25519_kdf_hkdf(path, 32, CURVE25519_KDF_SHA256, path,
+                            copath + 32 * (DEPTH * j + k), NULL, 0, NULL, 0);
+      }
+      curve25519_donna(out, path, basepoint);
+    }
+  }
+  end = time_now();
+  report("path/loop", start, end);
+
+  start = time_now();
+  for (i = 0; i < ROUNDS / DEPTH; ++i) {
+    curve25519_kdf_path(path, path_publics, secrets, copath, DEPTH, N,
+                        CURVE25519_KDF_SHA256, NULL, 0, NULL, 0);
+  }
+  end = time_now();
+  report("path/batch", start, end);
+
+  return 0;
+}
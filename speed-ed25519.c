@@ -0,0 +1,84 @@
+/* Compares the per-signature cost of curve25519_donna_ed25519_verify_batch
+ * with that of calling curve25519_donna_ed25519_verify once per signature. */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "curve25519-donna.h"
+
+#define N 64
+#define ROUNDS 200
+
+/* RFC 8032, section 7.1, test 2. */
+static const char pk_hex[] =
+    "3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c";
+static const char sig_hex[] =
+    "92a009a9f0d4cab8720e820b5f642540a2b27b5416503f8fb3762223ebdb69da085ac1e43e15996e458f3613d0f11d8c387b2eaeb4302aeeb00d291612bb0c00";
+
+static uint64_t
+time_now() {
+  struct timeval tv;
+  uint64_t ret;
+
+  gettimeofday(&tv, NULL);
+  ret = tv.tv_sec;
+  ret *= 1000000;
+  ret += tv.tv_usec;
+
+  return ret;
+}
+
+static void
+unhex(uint8_t *out, const char *in) {
+  unsigned v;
+
+  while (sscanf(in, "%2x", &v) == 1) {
+    *out++ = v;
+    in += 2;
+  }
+}
+
+int
+main() {
+  static const uint8_t msg[1] = {0x72};
+  uint8_t pk_bytes[32], sig_bytes[64];
+  const uint8_t *m[N], *pk[N], *sig[N];
+  size_t mlen[N];
+  unsigned i, j;
+  uint64_t start, end;
+
+  unhex(pk_bytes, pk_hex);
+  unhex(sig_bytes, sig_hex);
+  for (i = 0; i < N; ++i) {
+    m[i] = msg;
+    mlen[i] = sizeof(msg);
+    pk[i] = pk_bytes;
+    sig[i] = sig_bytes;
+  }
+
+  if (curve25519_donna_ed25519_verify_batch(m, mlen, pk, sig, N, NULL)) {
+    fprintf(stderr, "Verification failed.\n");
+    return 1;
+  }
+
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    for (j = 0; j < N; ++j) {
+      curve25519_donna_ed25519_verify(sig[j], m[j], mlen[j], pk[j]);
+    }
+  }
+  end = time_now();
+  printf("%-10s %.2fus\n", "single", (double) (end - start) / (ROUNDS * N));
+
+  start = time_now();
+  for (i = 0; i < ROUNDS; ++i) {
+    curve25519_donna_ed25519_verify_batch(m, mlen, pk, sig, N, NULL);
+  }
+  end = time_now();
+  printf("%-10s %.2fus\n", "batch", (double) (end - start) / (ROUNDS * N));
+
+  return 0;
+}
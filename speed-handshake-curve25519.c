@@ -0,0 +1,121 @@
+/* Replays a flood of synthetic Noise IK handshakes, as a responder sees after
+ * a restart when every client rekeys at once, and compares the cost of each
+ * handshake made with sequential calls to curve25519_donna with that made
+ * with curve25519_donna_handshakes over the messages that arrive together.
+ *
+ * Usage: speed-handshake-curve25519-donna-c64 [handshakes]
+ *
+ * For each handshake the responder reads "e, es, s, ss" and writes "e, ee,
+ * se". It only learns the client's static key by decrypting it with a key
+ * mixed from es, so each window of messages takes three calls: es, then ss,
+ * then the fresh ephemeral keys with curve25519_donna_batch and ee and se
+ * together. The hashing and encryption are left out. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "curve25519-donna.h"
+
+#define TEST_FILL_SEED 0x243f6a8885a308d3ull
+#include "test-fill.h"
+
+#define MAX_WINDOW 256
+
+static uint64_t
+time_now() {
+  struct timeval tv;
+  uint64_t ret;
+
+  gettimeofday(&tv, NULL);
+  ret = tv.tv_sec;
+  ret *= 1000000;
+  ret += tv.tv_usec;
+
+  return ret;
+}
+
+static void
+report(const char *name, unsigned handshakes, uint64_t start, uint64_t end) {
+  const double us = (double) (end - start) / handshakes;
+
+  printf("%-12s %8.2fus %8.0f handshakes/s\n", name, us, 1e6 / us);
+}
+
+int
+main(int argc, char **argv) {
+  static const uint8_t basepoint[32] = {9};
+  static uint8_t server_s[32], server_e[MAX_WINDOW][32];
+  static uint8_t server_epub[MAX_WINDOW][32];
+  static struct curve25519_donna_handshake es[MAX_WINDOW], ss[MAX_WINDOW],
+                                           reply[MAX_WINDOW];
+  const unsigned handshakes = argc > 1 ? atoi(argv[1]) : 4096;
+  uint8_t *client_e, *client_s, *client_epub, *client_spub, out[32];
+  unsigned i, j, window, count;
+  uint64_t start, end;
+  char name[16];
+
+  client_e = malloc(4 * 32 * (size_t) handshakes);
+  if (!handshakes || !client_e) {
+    fprintf(stderr, "Usage: %s [handshakes]\n", argv[0]);
+    return 1;
+  }
+  client_s = client_e + 32 * handshakes;
+  client_epub = client_s + 32 * handshakes;
+  client_spub = client_epub + 32 * handshakes;
+  fill(server_s, 32);
+  fill(client_e, 2 * 32 * handshakes);
+  curve25519_donna_batch(client_epub, client_e, NULL, handshakes);
+  curve25519_donna_batch(client_spub, client_s, NULL, handshakes);
+
+  start = time_now();
+  for (i = 0; i < handshakes; ++i) {
+    curve25519_donna(out, server_s, client_epub + 32 * i);
+    curve25519_donna(out, server_s, client_spub + 32 * i);
+    fill(server_e[0], 32);
+    curve25519_donna(server_epub[0], server_e[0], basepoint);
+    curve25519_donna(out, server_e[0], client_epub + 32 * i);
+    curve25519_donna(out, server_e[0], client_spub + 32 * i);
+  }
+  end = time_now();
+  report("sequential", handshakes, start, end);
+
+  for (window = 1; window <= MAX_WINDOW; window *= 4) {
+    start = time_now();
+    for (i = 0; i < handshakes; i += count) {
+      count = handshakes - i < window ? handshakes - i : window;
+      for (j = 0; j < count; ++j) {
+        es[j].count = 1;
+        es[j].secret[0] = server_s;
+        es[j].peer[0] = client_epub + 32 * (i + j);
+      }
+      curve25519_donna_handshakes(es, count);
+
+      for (j = 0; j < count; ++j) {
+        ss[j].count = 1;
+        ss[j].secret[0] = server_s;
+        ss[j].peer[0] = client_spub + 32 * (i + j);
+      }
+      curve25519_donna_handshakes(ss, count);
+
+      fill(server_e[0], 32 * count);
+      curve25519_donna_batch(server_epub[0], server_e[0], NULL, count);
+      for (j = 0; j < count; ++j) {
+        reply[j].count = 2;
+        reply[j].secret[0] = server_e[j];
+        reply[j].peer[0] = client_epub + 32 * (i + j);
+        reply[j].secret[1] = server_e[j];
+        reply[j].peer[1] = client_spub + 32 * (i + j);
+      }
+      curve25519_donna_handshakes(reply, count);
+    }
+    end = time_now();
+    snprintf(name, sizeof(name), "window/%u", window);
+    report(name, handshakes, start, end);
+  }
+
+  free(client_e);
+  return 0;
+}
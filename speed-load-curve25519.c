@@ -0,0 +1,484 @@
+/* Generates a handshake-like load on 1..N pinned threads and reports
+ * throughput and latency percentiles for every way the library offers of
+ * doing the work:
+ *
+ *   plain   curve25519_donna for each operation
+ *   batch   curve25519_donna_batch over 32 operations at a time
+ *   fanout  keygens batched with curve25519_donna_batch, shared keys with
+ *           curve25519_donna_fanout (see below)
+ *   pool    keygens taken from a curve25519_pool, shared keys computed inline
+ *   engine  every operation submitted to a curve25519_engine
+ *
+ * The load is a mix of keygen operations (a fresh secret times the base point)
+ * and shared-key operations (a fresh secret times a peer's public key), with
+ * peers drawn from a fixed population with Zipf-distributed popularity. The
+ * fanout entry point only applies when one secret meets many peers, so in
+ * that mode shared-key operations use a static secret per thread instead, as
+ * a server's static-key handshakes would.
+ *
+ * In the batched modes an operation's latency is the time from the start of
+ * the call that computed it to the end, and in engine mode the time from
+ * submission to completion. Each thread runs a closed loop.
+ *
+ * Usage: speed-load-curve25519 [-t max threads] [-k keygen percent]
+ *          [-p peers] [-z zipf exponent] [-d seconds] [-q engine depth]
+ *          [-m mode,mode,...]
+ */
+
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-engine.h"
+#include "curve25519-donna-pool.h"
+
+#define BATCH 32
+
+enum mode { PLAIN, BATCHED, FANOUT, POOL, ENGINE, NMODES };
+
+static const char *const mode_names[NMODES] = {
+  "plain", "batch", "fanout", "pool", "engine",
+};
+
+/* The workload, shared by all threads. */
+static unsigned keygen_percent = 50;
+static unsigned npeers = 1000;
+static double zipf_s = 1.0;
+static unsigned seconds = 1;
+static unsigned engine_depth = 64;
+static uint8_t *peers;       /* npeers public keys */
+static double *peer_cdf;     /* cumulative popularity of the peers */
+
+static atomic_int stop;
+static pthread_barrier_t start_barrier;
+static struct curve25519_pool *pool;
+static struct curve25519_engine *engine;
+
+struct worker {
+  pthread_t thread;
+  unsigned cpu;
+  enum mode mode;
+  uint64_t rng;
+  uint8_t static_secret[32];
+  uint64_t ops;
+  uint64_t *latencies;  /* nanoseconds, one per operation */
+  size_t nlatencies, cap;
+  struct curve25519_job *jobs;  /* engine mode */
+  atomic_int *done;
+};
+
+struct op {
+  int keygen;
+  uint8_t secret[32];
+  const uint8_t *peer;
+  uint8_t result[32];
+};
+
+static uint64_t
+time_nsec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/* xorshift64*: cheap enough that generating keys does not skew the results. */
+static uint64_t
+next_random(struct worker *w) {
+  w->rng ^= w->rng >> 12;
+  w->rng ^= w->rng << 25;
+  w->rng ^= w->rng >> 27;
+  return w->rng * 0x2545f4914f6cdd1dull;
+}
+
+static void
+random_secret(struct worker *w, uint8_t *secret) {
+  unsigned i;
+
+  for (i = 0; i < 32; i += 8) {
+    const uint64_t r = next_random(w);
+    memcpy(secret + i, &r, 8);
+  }
+  secret[0] &= 248;
+  secret[31] &= 127;
+  secret[31] |= 64;
+}
+
+static const uint8_t *
+random_peer(struct worker *w) {
+  const double u = (next_random(w) >> 11) * (1.0 / 9007199254740992.0);
+  unsigned lo = 0, hi = npeers - 1;
+
+  while (lo < hi) {
+    const unsigned mid = (lo + hi) / 2;
+    if (peer_cdf[mid] < u) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return peers + 32 * lo;
+}
+
+static void
+next_op(struct worker *w, struct op *op) {
+  op->keygen = next_random(w) % 100 < keygen_percent;
+  random_secret(w, op->secret);
+  op->peer = op->keygen ? NULL : random_peer(w);
+}
+
+static void
+record(struct worker *w, uint64_t latency) {
+  if (w->nlatencies == w->cap) {
+    w->cap = w->cap ? 2 * w->cap : 4096;
+    w->latencies = realloc(w->latencies, w->cap * sizeof(uint64_t));
+    if (!w->latencies) abort();
+  }
+  w->latencies[w->nlatencies++] = latency;
+  w->ops++;
+}
+
+static void
+run_plain(struct worker *w) {
+  static const uint8_t basepoint[32] = {9};
+  struct op op;
+
+  while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+    uint64_t start;
+
+    next_op(w, &op);
+    start = time_nsec();
+    curve25519_donna(op.result, op.secret, op.keygen ? basepoint : op.peer);
+    record(w, time_nsec() - start);
+  }
+}
+
+static void
+run_batch(struct worker *w) {
+  static const uint8_t basepoint[32] = {9};
+  uint8_t secrets[BATCH * 32], points[BATCH * 32], results[BATCH * 32];
+  struct op op;
+  unsigned i;
+
+  while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+    uint64_t start, latency;
+
+    for (i = 0; i < BATCH; ++i) {
+      next_op(w, &op);
+      memcpy(secrets + 32 * i, op.secret, 32);
+      memcpy(points + 32 * i, op.keygen ? basepoint : op.peer, 32);
+    }
+    start = time_nsec();
+    curve25519_donna_batch(results, secrets, points, BATCH);
+    latency = time_nsec() - start;
+    for (i = 0; i < BATCH; ++i) record(w, latency);
+  }
+}
+
+static void
+run_fanout(struct worker *w) {
+  uint8_t secrets[BATCH * 32], points[BATCH * 32], results[BATCH * 32];
+  struct op op;
+  unsigned i, nkeygen, nshared;
+
+  while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+    uint64_t start, latency;
+
+    nkeygen = nshared = 0;
+    for (i = 0; i < BATCH; ++i) {
+      next_op(w, &op);
+      if (op.keygen) {
+        memcpy(secrets + 32 * nkeygen++, op.secret, 32);
+      } else {
+        memcpy(points + 32 * nshared++, op.peer, 32);
+      }
+    }
+    start = time_nsec();
+    curve25519_donna_batch(results, secrets, NULL, nkeygen);
+    curve25519_donna_fanout(results, w->static_secret, points, nshared);
+    latency = time_nsec() - start;
+    for (i = 0; i < BATCH; ++i) record(w, latency);
+  }
+}
+
+static void
+run_pool(struct worker *w) {
+  struct op op;
+  uint8_t secret[32];
+
+  while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+    uint64_t start;
+
+    next_op(w, &op);
+    start = time_nsec();
+    if (op.keygen) {
+      curve25519_pool_take(pool, op.result, secret);
+    } else {
+      curve25519_donna(op.result, op.secret, op.peer);
+    }
+    record(w, time_nsec() - start);
+  }
+}
+
+static void
+run_engine(struct worker *w) {
+  struct pollfd pfd;
+  struct op op;
+  unsigned i, in_flight = 0;
+
+  w->jobs = calloc(engine_depth, sizeof(struct curve25519_job));
+  w->done = calloc(engine_depth, sizeof(atomic_int));
+  if (!w->jobs || !w->done) abort();
+  for (i = 0; i < engine_depth; ++i) {
+    w->jobs[i].user_data = w;
+    atomic_init(&w->done[i], 1);
+  }
+
+  pfd.fd = curve25519_engine_fd(engine);
+  pfd.events = POLLIN;
+
+  while (!atomic_load_explicit(&stop, memory_order_relaxed) || in_flight) {
+    struct curve25519_job *job;
+
+    /* Resubmit the jobs that have completed. */
+    for (i = 0; i < engine_depth; ++i) {
+      if (!atomic_load_explicit(&w->done[i], memory_order_acquire)) continue;
+      if (w->jobs[i].submit_nsec) in_flight--;
+      w->jobs[i].submit_nsec = 0;
+      if (atomic_load_explicit(&stop, memory_order_relaxed)) continue;
+
+      next_op(w, &op);
+      w->jobs[i].op =
+          op.keygen ? CURVE25519_JOB_KEYGEN : CURVE25519_JOB_SHARED;
+      memcpy(w->jobs[i].secret, op.secret, 32);
+      if (!op.keygen) memcpy(w->jobs[i].peer, op.peer, 32);
+      atomic_store_explicit(&w->done[i], 0, memory_order_relaxed);
+      if (curve25519_engine_submit(engine, &w->jobs[i])) {
+        atomic_store_explicit(&w->done[i], 1, memory_order_relaxed);
+        break;
+      }
+      in_flight++;
+    }
+
+    /* The completion ring is shared, so this may collect other threads'
+     * jobs. The latency is recorded by whoever collects the job and the job
+     * is handed back to its owner through its done flag. */
+    while ((job = curve25519_engine_poll(engine)) != NULL) {
+      struct worker *const owner = job->user_data;
+
+      record(w, time_nsec() - job->submit_nsec);
+      atomic_store_explicit(&owner->done[job - owner->jobs], 1,
+                            memory_order_release);
+    }
+
+    if (in_flight && poll(&pfd, 1, 1) == 1) {
+      uint64_t count;
+      if (read(pfd.fd, &count, sizeof(count)) < 0) continue;
+    }
+  }
+}
+
+static void *
+worker_main(void *arg) {
+  struct worker *w = arg;
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(w->cpu, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+  pthread_barrier_wait(&start_barrier);
+  switch (w->mode) {
+    case PLAIN: run_plain(w); break;
+    case BATCHED: run_batch(w); break;
+    case FANOUT: run_fanout(w); break;
+    case POOL: run_pool(w); break;
+    case ENGINE: run_engine(w); break;
+    default: break;
+  }
+  return NULL;
+}
+
+static int
+compare_u64(const void *a, const void *b) {
+  const uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+  return x < y ? -1 : x > y;
+}
+
+/* Runs one mode on nthreads threads and prints a line of results. */
+static int
+measure(enum mode mode, unsigned nthreads, unsigned ncpus) {
+  static const double percentiles[] = {50, 90, 99, 99.9};
+  struct worker *workers;
+  uint64_t *all, start, elapsed, ops = 0;
+  size_t n = 0;
+  unsigned i;
+
+  workers = calloc(nthreads, sizeof(struct worker));
+  if (!workers) return -1;
+
+  if (mode == POOL) {
+    pool = curve25519_pool_new(1024, nthreads);
+    if (!pool) return -1;
+  } else if (mode == ENGINE) {
+    engine = curve25519_engine_new(nthreads * engine_depth, nthreads,
+                                   100000 /* 100us */);
+    if (!engine) return -1;
+  }
+
+  atomic_store(&stop, 0);
+  pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+  for (i = 0; i < nthreads; ++i) {
+    workers[i].cpu = i % ncpus;
+    workers[i].mode = mode;
+    if (getrandom(&workers[i].rng, sizeof(workers[i].rng), 0) < 0) abort();
+    workers[i].rng |= 1;
+    random_secret(&workers[i], workers[i].static_secret);
+    if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i])) {
+      return -1;
+    }
+  }
+
+  pthread_barrier_wait(&start_barrier);
+  start = time_nsec();
+  sleep(seconds);
+  atomic_store(&stop, 1);
+  for (i = 0; i < nthreads; ++i) pthread_join(workers[i].thread, NULL);
+  elapsed = time_nsec() - start;
+  pthread_barrier_destroy(&start_barrier);
+
+  for (i = 0; i < nthreads; ++i) {
+    ops += workers[i].ops;
+    n += workers[i].nlatencies;
+  }
+  all = malloc((n ? n : 1) * sizeof(uint64_t));
+  if (!all) return -1;
+  for (i = 0, n = 0; i < nthreads; ++i) {
+    memcpy(all + n, workers[i].latencies,
+           workers[i].nlatencies * sizeof(uint64_t));
+    n += workers[i].nlatencies;
+    free(workers[i].latencies);
+    free(workers[i].jobs);
+    free(workers[i].done);
+  }
+  qsort(all, n, sizeof(uint64_t), compare_u64);
+
+  printf("%-8s %7u %12.0f", mode_names[mode], nthreads,
+         ops * 1e9 / elapsed);
+  for (i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i) {
+    const size_t k = n ? (size_t) (percentiles[i] / 100 * (n - 1)) : 0;
+    printf(" %10.1f", n ? all[k] / 1000.0 : 0.0);
+  }
+  printf("\n");
+  fflush(stdout);
+
+  free(all);
+  free(workers);
+  curve25519_pool_free(pool);
+  pool = NULL;
+  curve25519_engine_free(engine);
+  engine = NULL;
+  return 0;
+}
+
+static void
+usage(const char *argv0) {
+  fprintf(stderr,
+          "Usage: %s [-t max threads] [-k keygen percent] [-p peers]\n"
+          "       [-z zipf exponent] [-d seconds] [-q engine depth]\n"
+          "       [-m mode,mode,...]\n"
+          "Modes: plain, batch, fanout, pool, engine (default: all)\n",
+          argv0);
+}
+
+int
+main(int argc, char **argv) {
+  static const uint8_t basepoint[32] = {9};
+  const long online = sysconf(_SC_NPROCESSORS_ONLN);
+  const unsigned ncpus = online > 0 ? online : 1;
+  unsigned max_threads = ncpus, i, t;
+  int modes[NMODES], opt;
+  uint8_t secret[32];
+  double total = 0;
+  struct worker setup;
+
+  for (i = 0; i < NMODES; ++i) modes[i] = 1;
+
+  while ((opt = getopt(argc, argv, "t:k:p:z:d:q:m:")) != -1) {
+    switch (opt) {
+      case 't': max_threads = atoi(optarg); break;
+      case 'k': keygen_percent = atoi(optarg); break;
+      case 'p': npeers = atoi(optarg); break;
+      case 'z': zipf_s = atof(optarg); break;
+      case 'd': seconds = atoi(optarg); break;
+      case 'q': engine_depth = atoi(optarg); break;
+      case 'm': {
+        char *name = strtok(optarg, ",");
+        for (i = 0; i < NMODES; ++i) modes[i] = 0;
+        for (; name; name = strtok(NULL, ",")) {
+          for (i = 0; i < NMODES && strcmp(name, mode_names[i]); ++i) {
+          }
+          if (i == NMODES) {
+            usage(argv[0]);
+            return 1;
+          }
+          modes[i] = 1;
+        }
+        break;
+      }
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if (max_threads == 0 || npeers == 0 || keygen_percent > 100 ||
+      seconds == 0 || engine_depth == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  /* The peer population: peer i is chosen with probability proportional to
+   * 1 / (i + 1)^s. */
+  peers = malloc(32 * (size_t) npeers);
+  peer_cdf = malloc(sizeof(double) * npeers);
+  if (!peers || !peer_cdf) return 1;
+  memset(&setup, 0, sizeof(setup));
+  setup.rng = 0x0123456789abcdefull;
+  for (i = 0; i < npeers; ++i) {
+    random_secret(&setup, secret);
+    curve25519_donna(peers + 32 * i, secret, basepoint);
+    total += 1.0 / pow(i + 1, zipf_s);
+    peer_cdf[i] = total;
+  }
+  for (i = 0; i < npeers; ++i) peer_cdf[i] /= total;
+
+  printf("%u%% keygen, %u peers, zipf s=%.2f, %us per run\n", keygen_percent,
+         npeers, zipf_s, seconds);
+  printf("%-8s %7s %12s %10s %10s %10s %10s\n", "mode", "threads", "ops/s",
+         "p50 us", "p90 us", "p99 us", "p99.9 us");
+  for (i = 0; i < NMODES; ++i) {
+    if (!modes[i]) continue;
+    for (t = 1; t <= max_threads; ++t) {
+      if (measure(i, t, ncpus)) {
+        fprintf(stderr, "Failed to run %s on %u threads.\n", mode_names[i],
+                t);
+        return 1;
+      }
+    }
+  }
+
+  free(peers);
+  free(peer_cdf);
+  return 0;
+}
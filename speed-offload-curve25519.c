@@ -0,0 +1,152 @@
+/* Compares the throughput of several single-threaded worker processes that
+ * call curve25519_donna themselves with that of the same processes sending
+ * their jobs to the offload daemon.
+ *
+ * Usage: speed-offload-curve25519-donna-c64 [-p processes] [-n jobs]
+ *                                            [-k jobs per request]
+ *
+ * Each process makes n/k requests of k jobs, one after the other. In-process,
+ * a request is k calls to curve25519_donna; offloaded, it is one call to
+ * curve25519_offload_batch. The daemon runs in a process of its own, so with
+ * fewer cores than processes plus one it competes with the workers. */
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-offload.h"
+
+static uint64_t
+time_now() {
+  struct timeval tv;
+  uint64_t ret;
+
+  gettimeofday(&tv, NULL);
+  ret = tv.tv_sec;
+  ret *= 1000000;
+  ret += tv.tv_usec;
+
+  return ret;
+}
+
+static int
+worker(const char *path, unsigned requests, unsigned k, int gate) {
+  static const unsigned char basepoint[32] = {9};
+  unsigned char secrets[64 * 32], out[64 * 32];
+  struct curve25519_offload *c = NULL;
+  unsigned i, j;
+  char byte;
+
+  memset(secrets, 42, sizeof(secrets));
+  if (path) {
+    for (i = 0; i < 500 && !c; ++i) {
+      c = curve25519_offload_connect(path, k);
+      if (!c) usleep(10000);
+    }
+    if (!c) {
+      perror("curve25519_offload_connect");
+      return 1;
+    }
+  }
+  if (read(gate, &byte, 1) < 0) return 1;
+
+  for (i = 0; i < requests; ++i) {
+    secrets[0] = i;
+    if (c) {
+      if (curve25519_offload_batch(c, out, secrets, NULL, k)) return 1;
+    } else {
+      for (j = 0; j < k; ++j) {
+        curve25519_donna(out + 32 * j, secrets + 32 * j, basepoint);
+      }
+    }
+  }
+  curve25519_offload_close(c);
+  return 0;
+}
+
+/* Runs the workers and returns the elapsed time in microseconds. */
+static uint64_t
+run(const char *path, unsigned processes, unsigned requests, unsigned k) {
+  pid_t pids[256];
+  int gate[2], status;
+  uint64_t start;
+  unsigned i;
+  char byte = 0;
+
+  if (pipe(gate)) return 0;
+  for (i = 0; i < processes; ++i) {
+    pids[i] = fork();
+    if (pids[i] == 0) {
+      close(gate[1]);
+      _exit(worker(path, requests, k, gate[0]));
+    }
+  }
+  close(gate[0]);
+  /* Give the workers time to connect before opening the gate. */
+  usleep(100000);
+  start = time_now();
+  for (i = 0; i < processes; ++i) {
+    if (write(gate[1], &byte, 1) != 1) return 0;
+  }
+  for (i = 0; i < processes; ++i) {
+    waitpid(pids[i], &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+      fprintf(stderr, "A worker failed.\n");
+    }
+  }
+  close(gate[1]);
+  return time_now() - start;
+}
+
+int
+main(int argc, char **argv) {
+  unsigned processes = 4, jobs = 2000, k = 1;
+  char path[64];
+  uint64_t elapsed;
+  pid_t daemon;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "p:n:k:")) != -1) {
+    switch (opt) {
+      case 'p': processes = atoi(optarg); break;
+      case 'n': jobs = atoi(optarg); break;
+      case 'k': k = atoi(optarg); break;
+      default:
+        fprintf(stderr, "Usage: %s [-p processes] [-n jobs] "
+                "[-k jobs per request]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (processes < 1 || processes > 256 || k < 1 || k > 64 || jobs < k) {
+    fprintf(stderr, "Need 1-256 processes, 1-64 jobs per request and at "
+            "least as many jobs.\n");
+    return 1;
+  }
+
+  elapsed = run(NULL, processes, jobs / k, k);
+  printf("in-process %8.0f jobs/s\n",
+         (double) processes * (jobs / k) * k * 1e6 / elapsed);
+
+  sprintf(path, "/tmp/speed-offload-%d.sock", (int) getpid());
+  unlink(path);
+  daemon = fork();
+  if (daemon == 0) {
+    curve25519_offload_serve(path);
+    perror("curve25519_offload_serve");
+    _exit(1);
+  }
+  elapsed = run(path, processes, jobs / k, k);
+  printf("offloaded  %8.0f jobs/s\n",
+         (double) processes * (jobs / k) * k * 1e6 / elapsed);
+
+  kill(daemon, SIGKILL);
+  waitpid(daemon, NULL, 0);
+  unlink(path);
+  return 0;
+}
@@ -0,0 +1,99 @@
+/* This file checks that curve25519_donna_batch, curve25519_donna_fanout,
+ * curve25519_donna_x2 and curve25519_donna_ephemeral give the same results as
+ * calling curve25519_donna on each element, on every ladder backend, including
+ * for points (such as zero) whose final inversion is of zero. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "curve25519-donna.h"
+
+#define TEST_FILL_SEED 0x0123456789abcdefull
+#include "test-fill.h"
+
+int
+main() {
+  static const uint8_t basepoint[32] = {9};
+  static uint8_t secrets[100 * 32], points[100 * 32], out[100 * 32];
+  uint8_t expected[32], pub[32], shared[32];
+  size_t n, i;
+  int backend;
+
+  /* Every backend this CPU supports, each with batch sizes whose partly
+   * filled groups of lanes reach the narrower backends too. */
+  for (backend = CURVE25519_BACKEND_SCALAR;
+       backend <= CURVE25519_BACKEND_EDWARDS; ++backend) {
+    if (curve25519_donna_set_backend(backend)) continue;
+
+    for (n = 1; n <= 100; n += 11) {
+      fill(secrets, sizeof(secrets));
+      fill(points, sizeof(points));
+      /* Some elements get low-order points, whose results are zero. */
+      memset(points, 0, 32);
+      memset(points + 32 * (n / 2), 0, 32);
+      points[32 * (n / 2)] = 1;
+      memset(points + 32 * (n - 1), 0xff, 32);
+
+      curve25519_donna_batch(out, secrets, points, n);
+      for (i = 0; i < n; ++i) {
+        curve25519_donna(expected, secrets + 32 * i, points + 32 * i);
+        if (memcmp(expected, out + 32 * i, 32) != 0) {
+          fprintf(stderr, "Batch element %u of %u differs on backend %d.\n",
+                  (unsigned) i, (unsigned) n, backend);
+          return 1;
+        }
+      }
+
+      curve25519_donna_batch(out, secrets, NULL, n);
+      for (i = 0; i < n; ++i) {
+        curve25519_donna(expected, secrets + 32 * i, basepoint);
+        if (memcmp(expected, out + 32 * i, 32) != 0) {
+          fprintf(stderr, "Batch keygen element %u of %u differs on backend "
+                  "%d.\n", (unsigned) i, (unsigned) n, backend);
+          return 1;
+        }
+      }
+
+      curve25519_donna_fanout(out, secrets, points, n);
+      for (i = 0; i < n; ++i) {
+        curve25519_donna(expected, secrets, points + 32 * i);
+        if (memcmp(expected, out + 32 * i, 32) != 0) {
+          fprintf(stderr, "Fanout element %u of %u differs on backend %d.\n",
+                  (unsigned) i, (unsigned) n, backend);
+          return 1;
+        }
+      }
+
+      for (i = 0; i + 1 < n; i += 2) {
+        curve25519_donna_x2(out, secrets + 32 * i, points + 32 * i);
+        curve25519_donna(expected, secrets + 32 * i, points + 32 * i);
+        curve25519_donna(shared, secrets + 32 * i + 32, points + 32 * i + 32);
+        if (memcmp(expected, out, 32) != 0 ||
+            memcmp(shared, out + 32, 32) != 0) {
+          fprintf(stderr, "Pair %u of %u differs.\n", (unsigned) i,
+                  (unsigned) n);
+          return 1;
+        }
+      }
+
+      for (i = 0; i < n; ++i) {
+        curve25519_donna_ephemeral(pub, shared, secrets + 32 * i,
+                                   points + 32 * i);
+        curve25519_donna(expected, secrets + 32 * i, basepoint);
+        if (memcmp(expected, pub, 32) != 0) {
+          fprintf(stderr, "Ephemeral public key %u differs.\n", (unsigned) i);
+          return 1;
+        }
+        curve25519_donna(expected, secrets + 32 * i, points + 32 * i);
+        if (memcmp(expected, shared, 32) != 0) {
+          fprintf(stderr, "Ephemeral shared key %u differs.\n", (unsigned) i);
+          return 1;
+        }
+      }
+    }
+  }
+
+  fprintf(stderr, "Batch, fanout, pairs and ephemeral match single calls.\n");
+  return 0;
+}
@@ -0,0 +1,91 @@
+/* This file checks curve25519-donna-constexpr.hpp at compile time, against
+ * RFC 7748 and the first two rounds of test-curve25519.c, and at run time,
+ * against curve25519_donna. */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna.hpp"
+#include "curve25519-donna-constexpr.hpp"
+
+#define TEST_FILL_SEED 0x2468ace013579bdfull
+#include "test-fill.h"
+
+namespace ct = curve25519::compile_time;
+
+/* RFC 7748, section 6.1. */
+constexpr ct::bytes alice = ct::from_hex(
+    "77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a");
+constexpr ct::bytes bob = ct::from_hex(
+    "5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb");
+constexpr curve25519::PublicKey alice_public(ct::public_key(alice));
+
+static_assert(alice_public == curve25519::PublicKey(ct::from_hex(
+    "8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a")));
+static_assert(ct::public_key(bob) == ct::from_hex(
+    "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f"));
+static_assert(ct::x25519(alice, ct::public_key(bob)) == ct::from_hex(
+    "4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742"));
+
+/* RFC 7748, section 5.2: a u-coordinate with the top bit set. */
+static_assert(ct::x25519(
+    ct::from_hex(
+        "a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4"),
+    ct::from_hex(
+        "e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c")) ==
+    ct::from_hex(
+        "c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552"));
+
+/* A round of the loop of test-curve25519.c. Each round is a constant of its
+ * own, which keeps each evaluation within the compiler's limits. */
+struct test_state {
+  ct::bytes e1{3}, e2{5}, k{9}, e1e2k{};
+  bool agreed = true;
+};
+
+constexpr test_state
+test_round(test_state s) {
+  const ct::bytes e1k = ct::x25519(s.e1, s.k);
+  const ct::bytes e2e1k = ct::x25519(s.e2, e1k);
+  const ct::bytes e2k = ct::x25519(s.e2, s.k);
+
+  s.e1e2k = ct::x25519(s.e1, e2k);
+  s.agreed = s.agreed && s.e1e2k == e2e1k;
+  for (int i = 0; i < 32; ++i) {
+    s.e1[i] ^= e2k[i];
+    s.e2[i] ^= e1k[i];
+    s.k[i] ^= s.e1e2k[i];
+  }
+  return s;
+}
+
+constexpr test_state round1 = test_round(test_state{});
+constexpr test_state round2 = test_round(round1);
+
+static_assert(round1.agreed && round1.e1e2k == ct::from_hex(
+    "93fea2a7c1aeb62cfd6452ff5badae8bdffcbd7196dc910c89944006d85dbb68"));
+static_assert(round2.agreed && round2.e1e2k == ct::from_hex(
+    "fd2fbba00d997278a75827810b4efc5c1259c731cb6a7185deed26fe6413f005"));
+
+int
+main() {
+  ct::bytes secret, peer, got;
+  uint8_t expected[32];
+  unsigned i;
+
+  for (i = 0; i < 64; ++i) {
+    fill(secret.data(), 32);
+    fill(peer.data(), 32);
+    got = ct::x25519(secret, peer);
+    curve25519_donna(expected, secret.data(), peer.data());
+    if (memcmp(expected, got.data(), 32) != 0) {
+      fprintf(stderr, "Run-time key %u differs.\n", i);
+      return 1;
+    }
+  }
+
+  fprintf(stderr, "Compile-time keys match.\n");
+  return 0;
+}
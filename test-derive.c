@@ -0,0 +1,115 @@
+/* This file checks that the public keys of derived secrets are the derived
+ * public keys, for masters of either sign and for children of children, that
+ * the batch matches single derivations, that labels and masters give
+ * different children, that non-canonical encodings of a master give its
+ * children, and that masters on the twist are refused. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "curve25519-donna.h"
+
+#define TEST_FILL_SEED 0x7e57de71eed5eedull
+#include "test-fill.h"
+
+#define MASTERS 64
+#define LABELS 40
+
+int
+main() {
+  static const uint8_t basepoint[32] = {9};
+  static uint8_t labels[LABELS][16], children[LABELS][32];
+  const uint8_t *label_ptrs[LABELS];
+  size_t labellens[LABELS];
+  uint8_t master[32], master_pub[32], child[32], child_pub[32], pub[32];
+  uint8_t grandchild[32], grandchild_pub[32], twist[32], high[32];
+  unsigned i, j;
+
+  fill(labels[0], sizeof(labels));
+  for (j = 0; j < LABELS; ++j) {
+    label_ptrs[j] = labels[j];
+    labellens[j] = j % 17;
+  }
+
+  for (i = 0; i < MASTERS; ++i) {
+    fill(master, 32);
+    curve25519_donna(master_pub, master, basepoint);
+
+    for (j = 0; j < 4; ++j) {
+      if (curve25519_donna_derive_secret(child, master, labels[j],
+                                         labellens[j]) ||
+          curve25519_donna_derive_public(child_pub, master_pub, labels[j],
+                                         labellens[j])) {
+        fprintf(stderr, "Derivation %u of master %u failed.\n", j, i);
+        return 1;
+      }
+      curve25519_donna(pub, child, basepoint);
+      if (memcmp(pub, child_pub, 32) != 0 || (child[0] & 7) != 0 ||
+          (child[31] & 0xc0) != 0x40) {
+        fprintf(stderr, "Child %u of master %u differs.\n", j, i);
+        return 1;
+      }
+      if (memcmp(child_pub, master_pub, 32) == 0) {
+        fprintf(stderr, "Child %u of master %u is the master.\n", j, i);
+        return 1;
+      }
+    }
+
+    /* The last child is itself a master. */
+    curve25519_donna_derive_secret(grandchild, child, labels[5], 9);
+    curve25519_donna_derive_public(grandchild_pub, child_pub, labels[5], 9);
+    curve25519_donna(pub, grandchild, basepoint);
+    if (memcmp(pub, grandchild_pub, 32) != 0) {
+      fprintf(stderr, "Grandchild of master %u differs.\n", i);
+      return 1;
+    }
+  }
+
+  if (curve25519_donna_derive_public_batch(children[0], master_pub, label_ptrs,
+                                           labellens, LABELS)) {
+    fprintf(stderr, "Batch derivation failed.\n");
+    return 1;
+  }
+  for (j = 0; j < LABELS; ++j) {
+    curve25519_donna_derive_public(child_pub, master_pub, labels[j],
+                                   labellens[j]);
+    if (memcmp(children[j], child_pub, 32) != 0) {
+      fprintf(stderr, "Batch child %u differs.\n", j);
+      return 1;
+    }
+    if (j && memcmp(children[j], children[j - 1], 32) == 0) {
+      fprintf(stderr, "Labels %u and %u give the same child.\n", j - 1, j);
+      return 1;
+    }
+  }
+  curve25519_donna_derive_public(child_pub, pub, labels[0], 0);
+  if (memcmp(children[0], child_pub, 32) == 0) {
+    fprintf(stderr, "Two masters give the same child.\n");
+    return 1;
+  }
+
+  /* master_pub with the top bit set is the same key to curve25519_donna, so
+   * it has the same children as master_pub, and those of master. */
+  memcpy(high, master_pub, 32);
+  high[31] |= 0x80;
+  curve25519_donna_derive_secret(child, master, labels[3], 7);
+  curve25519_donna(pub, child, basepoint);
+  if (curve25519_donna_derive_public(child_pub, high, labels[3], 7) ||
+      memcmp(child_pub, pub, 32) != 0) {
+    fprintf(stderr, "A master with the top bit set gives another child.\n");
+    return 1;
+  }
+
+  /* u = 2 is on the twist. */
+  memset(twist, 0, 32);
+  twist[0] = 2;
+  if (curve25519_donna_derive_public(child_pub, twist, labels[0], 16) != -1 ||
+      memcmp(child_pub, twist + 1, 31) != 0 || child_pub[0] != 0) {
+    fprintf(stderr, "A master on the twist was accepted.\n");
+    return 1;
+  }
+
+  fprintf(stderr, "Derived secrets match derived public keys.\n");
+  return 0;
+}
@@ -0,0 +1,144 @@
+/* This file checks curve25519_donna_ed25519_verify and
+ * curve25519_donna_ed25519_verify_batch against signatures made with the
+ * reference code of RFC 8032. Signature i is of the i*9 byte message whose
+ * byte j is i*31 + j*7. The last one has a point of order eight added to R,
+ * which the cofactored equation accepts. Corrupted signatures must be rejected,
+ * and the batch verifier must agree with the single one on every signature. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "curve25519-donna.h"
+
+#define NVECTORS 16
+#define N 100
+
+static const char *const vectors[NVECTORS][2] = {
+  {"caba08b5912f1c2c31790aeccf0584db9897965a7e2f2e0f6d3f1efadf3cba2a",
+   "d26cb27acdce2951c5d04223108316ca8d6afb6a20bfb6f30a9d8cea28f88ce3c6c4fc200e6c76de8aa56e637145be1f0862f7326e1c82b881e1571aedac2e03"},
+  {"5b53276dbc1cff7ab04fa66e717ebf29bebda082591a341377b6b7ef800726b7",
+   "27a930695d71d1ef353d74d2a95126ac4de8e855ae12f3be359ab8778b0d2f9a5601b6c49542e309db9d4ee446a4185d304b1eff524c9f91c00eec8f46e9ef05"},
+  {"e30aeeacea251512f94f662a6bc5099bc7b95362951e4274cbc58ea4805aa988",
+   "ad5c7d1da1c451affd223a9c5ffb5b4891ba83cbec913dfea6bc0e7e3dd226a719b0c7fe740298e38583b74ea2147ef5581fc2998290c99d236e8f8d63ca040a"},
+  {"d02a89e733e6fca4b85929a91ce444faff913890248edb80b6e41789df6d1c3d",
+   "32f98df0c84679b7ddfbbff892a567632e88a0e09d1950056753579b1786e683c34d505c9a164a6c53a3ae4b991879710c7493371c90390b93960ae615e3bf09"},
+  {"fe4645775ee26b2c25c9906a880f7c3b30d4d53d61cd48038e8742656d3e88a1",
+   "5caa04b1e5023560bc3b3c9a68ba8bb65141bb48d5d93ed8abad83edd53594e4ff303d4d39cda71ecf18fdf104556b6477108da6ecb18f3287ef9ae49fe5c305"},
+  {"716ab7e5d1f5425e95af171d9eb7f92096be5c4c1e402586a25129fc723efad9",
+   "e0018d6ed2dff23b89f5236028ea6ccbc2a8cb30ad0ee0a646b157dbccd430ca54aa025cead861e3bd0b4d73a19c77ce8344b5da148ee6f577c50b94fa50bd04"},
+  {"8a7b427d61b35eccaa64c39832ba508b17ae6f468e2162a8bb92b30dc772684f",
+   "dc5b783dd2ef234bb6172abc0dbbad4d57de4933a6eb714c6fb5e16edb813b90d08c0125cf19e411b62630eca26fc99de47c3a9f991aa7ec8a83f44eceb9af01"},
+  {"3acf0bcda7a114c87e32a81e7cbf67ea0adf53a4a3e084be4e0bf742d3faad70",
+   "4235acdcf62d21a3c783a045672a24ec76781baeb2f96b2704cb35a8bb4687541db1dfb57410b8f03505f59b9835114d3737b11ea35a109c5cb2b719f3e7fa00"},
+  {"b856a0513502bd596af0f89c9a3f74782b2b27d8d198429d9be7eb566389712e",
+   "d8fa05a288feab63533ed8128fbc9924038c0cbcb155d3a48a1e21be34f1975959f820f99d5e82e5487877736f966c8c9a327d16783bb7694f2ab8231bf58a08"},
+  {"3120fa3249d99443e88f26f2921b7a288282251e41e2fdc05a51d6b0666c3095",
+   "1cbb48d49fc8dacbae366e710d81e53dfa29ce08b5190981bcdc4e093de5f0d653031582dfaf5866758c7a6f3fb1f4b16360fd3835a9ae40d09374947e6f050d"},
+  {"8d497b6557b1edbd928860f8df7fc0c4eb22a5c54b4ddcfef8dcc5b98b8be3aa",
+   "64c3d3df8c7f99246dc18c8a23acd5c29c9b7d627fe31b092f7a10d6089275874d3a12e1d7f2e33cdcd2ee97f8c9d3db6f34c812396c0b79fcf69b58012f280a"},
+  {"02900a70c9c6b16757c60d381ec8220f4952c257fa2868d69045bee7c550059b",
+   "28be35ee309d5d0cb0d7468ab45b4314383423599d4d9ad10c296ebfefe4f1a8622bdf318f23231b542bb67cf9aed60db62d4915dd32f4fd94fac4fa0573750c"},
+  {"437087921818f6c7eface8fe45cabcea81299d382cc9a875dc6e6f0f653451f6",
+   "276177a8a3bcfc179b4c3daf6e43399aabd9af778616101b40be59989c5fc5a6cbd26329daff6ae09fe9c6a43c95f1d701b511dbaa6b770b491b13eceb1c8c0d"},
+  {"b5da41cc706542821cf1746193f37e388c69258767af3a772b71b2e48fde2bf2",
+   "b589d328ad09c8b48ded3bd3f43c0e30f5615610988d79e905241eade3e71bdfaf4657adc791cfc560bf034a5493f72c86ca83ba3025440d63f908425e0a950f"},
+  {"dbcda3c1ba8ec22d652126d3a0be9a8a9a2e51339484f44a8d65e6f228a2b9ed",
+   "779eb69f373c4ca5d8d003b3eace5369f3c4bd5e3f6a61061b2ba67a8d48b50d7c66ab218a3d489648fb9cb05c6a68328e6305274700ed8e4ab65e6879a8100b"},
+  {"6ec312e753dad5f54b6dbb9a154aefeb86c2edfc33813fd59186ab211c77a222",
+   "052fb65e47c9c6eedfa682aeab6c3a11c32aabe5b6c288eb43eff9df768d4a5e8ae68010f3062f0bb7b132eb487388ab0a9ce1711c9bd3a634e6201bb472f201"},
+};
+
+/* RFC 8032, section 7.1, test 1. */
+static const char rfc_pk[] =
+    "d75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a";
+static const char rfc_sig[] =
+    "e5564300c360ac729086e2cc806e828a84877f1eb8e5d974d873e065224901555fb8821590a33bacc61e39701cf9b46bd25bf5f0595bbe24655141438e7a100b";
+
+/* The group order, L. */
+static const uint8_t order[32] = {
+  0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2,
+  0xde, 0xf9, 0xde, 0x14, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10,
+};
+
+static void
+unhex(uint8_t *out, const char *in) {
+  unsigned v;
+
+  while (sscanf(in, "%2x", &v) == 1) {
+    *out++ = v;
+    in += 2;
+  }
+}
+
+int
+main() {
+  static uint8_t msgs[N][NVECTORS * 9], pks[N][32], sigs[N][64];
+  const uint8_t *m[N], *pk[N], *sig[N];
+  size_t mlen[N];
+  int valid[N], expect[N];
+  unsigned i, j, carry;
+
+  unhex(pks[0], rfc_pk);
+  unhex(sigs[0], rfc_sig);
+  if (curve25519_donna_ed25519_verify(sigs[0], NULL, 0, pks[0]) != 0) {
+    fprintf(stderr, "RFC 8032 test 1 failed.\n");
+    return 1;
+  }
+
+  for (i = 0; i < N; ++i) {
+    const unsigned v = i % NVECTORS;
+    unhex(pks[i], vectors[v][0]);
+    unhex(sigs[i], vectors[v][1]);
+    mlen[i] = v * 9;
+    for (j = 0; j < mlen[i]; ++j) msgs[i][j] = v * 31 + j * 7;
+    m[i] = msgs[i];
+    pk[i] = pks[i];
+    sig[i] = sigs[i];
+    expect[i] = 1;
+
+    if (i < NVECTORS &&
+        curve25519_donna_ed25519_verify(sig[i], m[i], mlen[i], pk[i]) != 0) {
+      fprintf(stderr, "Signature %u was rejected.\n", i);
+      return 1;
+    }
+  }
+
+  if (curve25519_donna_ed25519_verify_batch(m, mlen, pk, sig, N, valid) != 0) {
+    fprintf(stderr, "A batch of valid signatures was rejected.\n");
+    return 1;
+  }
+
+  sigs[3][5] ^= 1;               /* R */
+  sigs[17][40] ^= 0x10;          /* S */
+  msgs[40][2] ^= 0x80;           /* the message */
+  pks[63][0] ^= 1;               /* the public key */
+  memcpy(pks[64], pks[65], 32);  /* someone else's public key */
+  /* S + L, which is the same scalar but must be rejected. */
+  for (i = carry = 0; i < 32; ++i) {
+    carry += sigs[70][32 + i] + order[i];
+    sigs[70][32 + i] = carry;
+    carry >>= 8;
+  }
+  memset(sigs[99], 0, 64);       /* R is the neutral element and S is 0 */
+  sigs[99][0] = 1;
+  expect[3] = expect[17] = expect[40] = expect[63] = expect[64] = 0;
+  expect[70] = expect[99] = 0;
+
+  if (curve25519_donna_ed25519_verify_batch(m, mlen, pk, sig, N, valid) == 0) {
+    fprintf(stderr, "A batch of invalid signatures was accepted.\n");
+    return 1;
+  }
+  for (i = 0; i < N; ++i) {
+    const int single =
+        curve25519_donna_ed25519_verify(sig[i], m[i], mlen[i], pk[i]) == 0;
+    if (valid[i] != expect[i] || single != expect[i]) {
+      fprintf(stderr, "Signature %u: expected %d, batch %d, single %d.\n", i,
+              expect[i], valid[i], single);
+      return 1;
+    }
+  }
+
+  printf("Ed25519 signatures verified.\n");
+  return 0;
+}
@@ -0,0 +1,85 @@
+/* This file checks that the windowed Edwards backend gives the same results
+ * as the ladder, for curve25519_donna and curve25519_donna_batch, for peers on
+ * the curve, on the twist, of low order and not in canonical form, and that
+ * it is never chosen unless it is set. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "curve25519-donna.h"
+
+#define TEST_FILL_SEED 0x1234fedc5678ba98ull
+#include "test-fill.h"
+
+#define PEERS 16
+#define SECRETS 16
+
+int
+main() {
+  static const uint8_t basepoint[32] = {9};
+  static uint8_t peers[PEERS][32], secrets[SECRETS][32];
+  static uint8_t ladder[SECRETS][PEERS][32], out[PEERS][32];
+  uint8_t tmp[32];
+  unsigned i, j;
+
+  memcpy(peers[0], basepoint, 32);
+  for (i = 1; i < 8; ++i) {
+    fill(tmp, 32);
+    curve25519_donna(peers[i], tmp, basepoint);
+  }
+  /* Random values: about half of them are on the twist. */
+  for (; i < 12; ++i) fill(peers[i], 32);
+  /* 0 and 1 are of low order, p-1 has no Edwards y, 2^255-1 is p+18 and has
+   * the top bit set. */
+  memset(peers[12], 0, 32);
+  memset(peers[13], 0, 32);
+  peers[13][0] = 1;
+  memset(peers[14], 0xff, 32);
+  peers[14][0] = 0xec;
+  peers[14][31] = 0x7f;
+  memset(peers[15], 0xff, 32);
+
+  fill(secrets[0], sizeof(secrets));
+
+  if (curve25519_donna_set_backend(CURVE25519_BACKEND_SCALAR) ||
+      curve25519_donna_get_backend() != CURVE25519_BACKEND_SCALAR) {
+    fprintf(stderr, "The ladder backend cannot be chosen.\n");
+    return 1;
+  }
+  for (i = 0; i < SECRETS; ++i) {
+    for (j = 0; j < PEERS; ++j) {
+      curve25519_donna(ladder[i][j], secrets[i], peers[j]);
+    }
+  }
+
+  if (curve25519_donna_set_backend(CURVE25519_BACKEND_EDWARDS)) {
+    fprintf(stderr, "The Edwards backend cannot be chosen.\n");
+    return 1;
+  }
+  for (i = 0; i < SECRETS; ++i) {
+    for (j = 0; j < PEERS; ++j) {
+      curve25519_donna(tmp, secrets[i], peers[j]);
+      if (memcmp(tmp, ladder[i][j], 32) != 0) {
+        fprintf(stderr, "Secret %u with peer %u differs.\n", i, j);
+        return 1;
+      }
+    }
+    curve25519_donna_fanout(out[0], secrets[i], peers[0], PEERS);
+    for (j = 0; j < PEERS; ++j) {
+      if (memcmp(out[j], ladder[i][j], 32) != 0) {
+        fprintf(stderr, "Fanout of secret %u to peer %u differs.\n", i, j);
+        return 1;
+      }
+    }
+  }
+
+  if (curve25519_donna_set_backend(CURVE25519_BACKEND_AUTO) ||
+      curve25519_donna_get_backend() == CURVE25519_BACKEND_EDWARDS) {
+    fprintf(stderr, "The Edwards backend was chosen automatically.\n");
+    return 1;
+  }
+
+  fprintf(stderr, "Edwards multiplications match the ladder.\n");
+  return 0;
+}
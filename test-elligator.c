@@ -0,0 +1,115 @@
+/* This file checks that Elligator 2 representatives decode to the keys they
+ * were made from, that about half of all public keys have them, and that the
+ * key pairs from curve25519_donna_elligator_keypairs agree with
+ * curve25519_donna on shared keys. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "curve25519-donna.h"
+
+#define TEST_FILL_SEED 0x0123456789abcdefull
+#include "test-fill.h"
+
+#define KEYS 256
+#define PAIRS 100
+
+int
+main() {
+  static const uint8_t basepoint[32] = {9}, zero[32] = {0};
+  static uint8_t secrets[PAIRS][32], publics[PAIRS][32], reps[PAIRS][32];
+  uint8_t secret[32], peer[32], public[32], rep[32], u[32], a[32], b[32];
+  unsigned i, representable = 0, top = 0, dirty = 0;
+  uint8_t tweak;
+
+  /* Public keys made by the ladder. */
+  for (i = 0; i < KEYS; ++i) {
+    fill(secret, 32);
+    fill(&tweak, 1);
+    curve25519_donna(public, secret, basepoint);
+    if (curve25519_donna_elligator_encode(rep, public, tweak)) continue;
+    representable++;
+    curve25519_donna_elligator_decode(u, rep);
+    if (memcmp(u, public, 32) != 0 || (rep[31] & 0xc0) != (tweak & 0xc0)) {
+      fprintf(stderr, "Key %u does not survive encoding.\n", i);
+      return 1;
+    }
+  }
+  if (representable < KEYS / 4 || representable > 3 * KEYS / 4) {
+    fprintf(stderr, "%u of %u keys are representable.\n", representable, KEYS);
+    return 1;
+  }
+
+  /* Every string decodes to a point with two representatives. */
+  for (i = 0; i < KEYS; ++i) {
+    fill(rep, 32);
+    curve25519_donna_elligator_decode(u, rep);
+    if (curve25519_donna_elligator_encode(a, u, 0) ||
+        curve25519_donna_elligator_encode(b, u, 1) ||
+        memcmp(a, b, 32) == 0) {
+      fprintf(stderr, "Decoded string %u is not representable.\n", i);
+      return 1;
+    }
+    curve25519_donna_elligator_decode(a, a);
+    curve25519_donna_elligator_decode(b, b);
+    if (memcmp(a, u, 32) != 0 || memcmp(b, u, 32) != 0) {
+      fprintf(stderr, "Decoded string %u does not survive encoding.\n", i);
+      return 1;
+    }
+  }
+
+  /* 0 is represented by 0, and -A, a point of the twist, by nothing. */
+  if (curve25519_donna_elligator_encode(rep, zero, 1) ||
+      memcmp(rep, zero, 32) != 0) {
+    fprintf(stderr, "0 is not represented by 0.\n");
+    return 1;
+  }
+  memset(u, 0xff, 32);
+  u[0] = 0xe7;
+  u[1] = 0x92;
+  u[2] = 0xf8;
+  u[31] = 0x7f;
+  if (curve25519_donna_elligator_encode(rep, u, 0) == 0 ||
+      curve25519_donna_elligator_encode(rep, u, 1) == 0) {
+    fprintf(stderr, "-A is representable.\n");
+    return 1;
+  }
+
+  if (curve25519_donna_elligator_keypairs(secrets[0], publics[0], reps[0],
+                                          PAIRS)) {
+    perror("curve25519_donna_elligator_keypairs");
+    return 1;
+  }
+  for (i = 0; i < PAIRS; ++i) {
+    curve25519_donna_elligator_decode(u, reps[i]);
+    if (memcmp(u, publics[i], 32) != 0) {
+      fprintf(stderr, "Key pair %u has the wrong representative.\n", i);
+      return 1;
+    }
+    fill(secret, 32);
+    curve25519_donna(peer, secret, basepoint);
+    curve25519_donna(a, secrets[i], peer);
+    curve25519_donna(b, secret, publics[i]);
+    if (memcmp(a, b, 32) != 0) {
+      fprintf(stderr, "Key pair %u does not agree on a shared key.\n", i);
+      return 1;
+    }
+    top += reps[i][31] >> 7;
+    curve25519_donna(a, secrets[i], basepoint);
+    dirty += memcmp(a, publics[i], 32) != 0;
+  }
+  if (dirty < PAIRS / 2) {
+    fprintf(stderr, "Only %u of %u public keys have a small-order part.\n",
+            dirty, PAIRS);
+    return 1;
+  }
+  if (top < PAIRS / 5 || top > 4 * PAIRS / 5) {
+    fprintf(stderr, "%u of %u representatives have the top bit set.\n", top,
+            PAIRS);
+    return 1;
+  }
+
+  fprintf(stderr, "Elligator 2 representatives round trip.\n");
+  return 0;
+}
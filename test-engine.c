@@ -0,0 +1,180 @@
+/* This file pushes a mix of jobs through the asynchronous engine, waiting on
+ * its eventfd, and checks every result against curve25519_donna. It also
+ * checks that a lone job is flushed by the deadline rather than waiting for a
+ * full batch, that jobs from submitters racing onto an empty queue all wake a
+ * worker, and that a partial batch is run as soon as it fills, well before
+ * its deadline. */
+
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-engine.h"
+
+#define JOBS 300
+#define SUBMITTERS 8
+#define ROUNDS 500
+
+static struct curve25519_job jobs[JOBS];
+
+static struct curve25519_engine *racing_engine;
+static pthread_barrier_t racing_start;
+
+/* Submits the job given as soon as every submitter is ready. */
+static void *
+submitter(void *arg) {
+  pthread_barrier_wait(&racing_start);
+  return curve25519_engine_submit(racing_engine, arg) ? arg : NULL;
+}
+
+/* Waits up to timeout ms for each job and collects up to want jobs. Returns
+ * the number collected. */
+static unsigned
+collect(struct curve25519_engine *engine, unsigned want, int timeout) {
+  struct pollfd pfd;
+  unsigned got = 0;
+
+  pfd.fd = curve25519_engine_fd(engine);
+  pfd.events = POLLIN;
+  while (got < want) {
+    struct curve25519_job *job;
+    uint64_t count;
+
+    if (poll(&pfd, 1, timeout) != 1) break;
+    if (read(pfd.fd, &count, sizeof(count)) != sizeof(count)) continue;
+    while ((job = curve25519_engine_poll(engine)) != NULL) {
+      job->user_data = job;
+      got++;
+    }
+  }
+  return got;
+}
+
+int
+main() {
+  static const uint8_t basepoint[32] = {9};
+  struct curve25519_engine *engine;
+  struct curve25519_engine_stats stats, filling;
+  pthread_t threads[SUBMITTERS];
+  uint8_t expected[32];
+  unsigned i, j, round;
+  void *failed;
+
+  engine = curve25519_engine_new(128, 2, 1000000 /* 1ms */);
+  if (!engine) {
+    fprintf(stderr, "Failed to create engine.\n");
+    return 1;
+  }
+
+  /* A lone job must be completed by the deadline. */
+  jobs[0].op = CURVE25519_JOB_KEYGEN;
+  memset(jobs[0].secret, 7, 32);
+  if (curve25519_engine_submit(engine, &jobs[0]) || collect(engine, 1, 5000) != 1) {
+    fprintf(stderr, "A lone job was not completed.\n");
+    return 1;
+  }
+
+  for (i = 0; i < JOBS; ++i) {
+    jobs[i].op = i % 3 ? CURVE25519_JOB_SHARED : CURVE25519_JOB_KEYGEN;
+    jobs[i].user_data = NULL;
+    for (j = 0; j < 32; ++j) {
+      jobs[i].secret[j] = i * 7 + j;
+      jobs[i].peer[j] = i * 13 + j * 3;
+    }
+  }
+
+  for (i = 0; i < JOBS; i += 100) {
+    for (j = i; j < i + 100; ++j) {
+      if (curve25519_engine_submit(engine, &jobs[j])) {
+        fprintf(stderr, "Submission failed.\n");
+        return 1;
+      }
+    }
+    if (collect(engine, 100, 5000) != 100) {
+      fprintf(stderr, "Jobs were not completed.\n");
+      return 1;
+    }
+  }
+
+  for (i = 0; i < JOBS; ++i) {
+    if (jobs[i].user_data != &jobs[i]) {
+      fprintf(stderr, "Job %u was not returned.\n", i);
+      return 1;
+    }
+    curve25519_donna(expected, jobs[i].secret,
+                     jobs[i].op == CURVE25519_JOB_SHARED ? jobs[i].peer
+                                                         : basepoint);
+    if (memcmp(expected, jobs[i].result, 32) != 0) {
+      fprintf(stderr, "Job %u has the wrong result.\n", i);
+      return 1;
+    }
+  }
+
+  curve25519_engine_stats(engine, &stats);
+  curve25519_engine_free(engine);
+  if (stats.completed != JOBS + 1 || stats.in_flight != 0 ||
+      stats.batches == 0 || stats.batch_capacity < stats.completed) {
+    fprintf(stderr, "Engine statistics are inconsistent.\n");
+    return 1;
+  }
+
+  /* Submitters that push onto an empty queue at once must wake a worker
+   * between them, or their jobs wait for jobs that never come. */
+  racing_engine = curve25519_engine_new(128, 2, 1000000 /* 1ms */);
+  if (!racing_engine) {
+    fprintf(stderr, "Failed to create engine.\n");
+    return 1;
+  }
+  for (round = 0; round < ROUNDS; ++round) {
+    pthread_barrier_init(&racing_start, NULL, SUBMITTERS);
+    for (i = 0; i < SUBMITTERS; ++i) {
+      pthread_create(&threads[i], NULL, submitter, &jobs[i]);
+    }
+    for (i = 0; i < SUBMITTERS; ++i) {
+      pthread_join(threads[i], &failed);
+      if (failed) {
+        fprintf(stderr, "Submission failed.\n");
+        return 1;
+      }
+    }
+    pthread_barrier_destroy(&racing_start);
+    if (collect(racing_engine, SUBMITTERS, 500) != SUBMITTERS) {
+      fprintf(stderr, "Racing jobs were not completed in round %u.\n",
+              round);
+      return 1;
+    }
+  }
+  curve25519_engine_free(racing_engine);
+
+  /* A worker holding one job of a batch runs it once 31 more arrive, not at
+   * its ten second deadline. */
+  engine = curve25519_engine_new(128, 1, 10000000000ull);
+  if (!engine || curve25519_engine_submit(engine, &jobs[0])) {
+    fprintf(stderr, "Failed to create engine.\n");
+    return 1;
+  }
+  curve25519_engine_stats(engine, &filling);
+  for (i = 0; filling.queue_depth != 0 && i < 1000; ++i) {
+    usleep(1000);
+    curve25519_engine_stats(engine, &filling);
+  }
+  for (i = 1; i < 32; ++i) {
+    if (curve25519_engine_submit(engine, &jobs[i])) {
+      fprintf(stderr, "Submission failed.\n");
+      return 1;
+    }
+  }
+  if (collect(engine, 32, 1000) != 32) {
+    fprintf(stderr, "A full batch waited for its deadline.\n");
+    return 1;
+  }
+  curve25519_engine_free(engine);
+
+  fprintf(stderr, "Engine completed %u jobs in %u batches.\n",
+          (unsigned) stats.completed, (unsigned) stats.batches);
+  return 0;
+}
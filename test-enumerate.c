@@ -0,0 +1,101 @@
+/* This file checks that curve25519_donna_enumerate gives the secrets s,
+ * s + 8, ... and the same public keys as curve25519_donna, stops when the
+ * matcher says so, finds keys by prefix and refuses secrets that would
+ * overflow. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "curve25519-donna.h"
+
+#define TEST_FILL_SEED 0x0f1e2d3c4b5a6978ull
+#include "test-fill.h"
+
+#define KEYS 70
+
+struct check {
+  uint8_t next[32];  /* the secret expected next */
+  unsigned seen, stop;
+  int failed;
+};
+
+static int
+check_key(const uint8_t *secret, const uint8_t *mypublic, void *arg) {
+  static const uint8_t basepoint[32] = {9};
+  struct check *const c = arg;
+  uint8_t expected[32];
+  unsigned carry = 8, i;
+
+  curve25519_donna(expected, secret, basepoint);
+  if (memcmp(secret, c->next, 32) != 0 || memcmp(expected, mypublic, 32) != 0) {
+    c->failed = 1;
+  }
+  for (i = 0; i < 32; ++i) {
+    carry += c->next[i];
+    c->next[i] = carry;
+    carry >>= 8;
+  }
+  return ++c->seen == c->stop ? 7 : 0;
+}
+
+int
+main() {
+  static const uint8_t basepoint[32] = {9};
+  uint8_t secret[32], expected[32];
+  struct curve25519_donna_prefix prefix;
+  struct check c;
+  unsigned round;
+
+  for (round = 0; round < 4; ++round) {
+    fill(secret, 32);
+    memset(&c, 0, sizeof(c));
+    memcpy(c.next, secret, 32);
+    c.next[0] &= 248;
+    c.next[31] &= 127;
+    c.next[31] |= 64;
+    /* The last rounds stop early, once inside a block and once at its end. */
+    c.stop = round == 2 ? 40 : round == 3 ? 32 : 0;
+
+    if (curve25519_donna_enumerate(secret, KEYS, check_key, &c) !=
+            (c.stop ? 7 : 0) ||
+        c.failed || c.seen != (c.stop ? c.stop : KEYS)) {
+      fprintf(stderr, "Enumerated keys differ in round %u.\n", round);
+      return 1;
+    }
+  }
+
+  /* 12 bits take about 4096 keys. */
+  fill(secret, 32);
+  memset(&prefix, 0, sizeof(prefix));
+  prefix.prefix = (const uint8_t *) "\xab\xc0";
+  prefix.bits = 12;
+  if (curve25519_donna_enumerate(secret, 1 << 20, curve25519_donna_match_prefix,
+                                 &prefix) != 1) {
+    fprintf(stderr, "No key with the prefix was found.\n");
+    return 1;
+  }
+  curve25519_donna(expected, prefix.secret, basepoint);
+  if (memcmp(expected, prefix.mypublic, 32) != 0 || expected[0] != 0xab ||
+      (expected[1] & 0xf0) != 0xc0) {
+    fprintf(stderr, "The key found does not have the prefix.\n");
+    return 1;
+  }
+
+  /* The largest clamped secret, 2^255 - 8, has no successor. */
+  memset(secret, 0xff, 32);
+  memset(&c, 0, sizeof(c));
+  memcpy(c.next, secret, 32);
+  c.next[0] &= 248;
+  c.next[31] &= 127;
+  if (curve25519_donna_enumerate(secret, 2, check_key, &c) != -1 ||
+      c.seen != 0 ||
+      curve25519_donna_enumerate(secret, 1, check_key, &c) != 0 ||
+      c.failed || c.seen != 1) {
+    fprintf(stderr, "Overflowing secrets were not refused.\n");
+    return 1;
+  }
+
+  fprintf(stderr, "Enumerated keys match single calls.\n");
+  return 0;
+}
@@ -0,0 +1,35 @@
+/* curve25519-donna: reproducible inputs for the tests and benchmarks
+ *
+ * Code released into the public domain.
+ *
+ * A xorshift generator, so that a failing test sees the same keys on every
+ * run. Each program defines TEST_FILL_SEED before including this header to
+ * pick its own sequence. This is not a source of secrets.
+ */
+
+#ifndef CURVE25519_DONNA_TEST_FILL_H
+#define CURVE25519_DONNA_TEST_FILL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef TEST_FILL_SEED
+#error "Define TEST_FILL_SEED before including test-fill.h."
+#endif
+
+static uint64_t fill_state = TEST_FILL_SEED;
+
+static inline uint64_t
+fill_next(void) {
+  fill_state ^= fill_state << 13;
+  fill_state ^= fill_state >> 7;
+  fill_state ^= fill_state << 17;
+  return fill_state;
+}
+
+static inline void
+fill(uint8_t *out, size_t len) {
+  while (len--) *out++ = (uint8_t) fill_next();
+}
+
+#endif  /* CURVE25519_DONNA_TEST_FILL_H */
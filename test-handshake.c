@@ -0,0 +1,84 @@
+/* This file checks that curve25519_donna_handshakes gives the same shared keys
+ * as calling curve25519_donna on each operation, for messages of every size
+ * whose operations straddle the blocks of the batch, and that it rejects
+ * exactly the messages with a peer of small order or too many operations. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "curve25519-donna.h"
+
+#define TEST_FILL_SEED 0x5a5a0f0f3c3cc3c3ull
+#include "test-fill.h"
+
+#define MESSAGES 40
+
+int
+main() {
+  static const uint8_t basepoint[32] = {9};
+  static const uint8_t zero[CURVE25519_DONNA_HANDSHAKE_DH][32];
+  static uint8_t statics[2][32], ephemerals[MESSAGES][32];
+  static uint8_t publics[MESSAGES][32];
+  static struct curve25519_donna_handshake h[MESSAGES];
+  uint8_t expected[32];
+  unsigned i, k;
+
+  /* A server's static key against the ephemeral and static keys of each
+   * client, and the server's ephemeral against the client's ephemeral, in the
+   * manner of the es, ss, ee and se tokens. */
+  fill(statics[0], sizeof(statics));
+  fill(ephemerals[0], sizeof(ephemerals));
+  curve25519_donna_batch(publics[0], ephemerals[0], NULL, MESSAGES);
+  for (i = 0; i < MESSAGES; ++i) {
+    h[i].count = i % (CURVE25519_DONNA_HANDSHAKE_DH + 1);
+    for (k = 0; k < h[i].count; ++k) {
+      h[i].secret[k] = k & 1 ? ephemerals[(i + k) % MESSAGES] : statics[0];
+      h[i].peer[k] = k & 2 ? statics[1] : publics[(i + 7 * k) % MESSAGES];
+    }
+  }
+  /* Rejected: a peer of small order, and one operation too many. */
+  h[9].peer[2] = zero[0];
+  h[13].count = CURVE25519_DONNA_HANDSHAKE_DH + 1;
+
+  if (curve25519_donna_handshakes(h, MESSAGES) != -1) {
+    fprintf(stderr, "Bad messages were not reported.\n");
+    return 1;
+  }
+  for (i = 0; i < MESSAGES; ++i) {
+    const int bad = i == 9 || i == 13;
+
+    if (h[i].result != (bad ? -1 : 0)) {
+      fprintf(stderr, "Message %u has the wrong result.\n", i);
+      return 1;
+    }
+    for (k = 0; k < CURVE25519_DONNA_HANDSHAKE_DH; ++k) {
+      if (bad || k >= h[i].count) continue;
+      curve25519_donna(expected, h[i].secret[k], h[i].peer[k]);
+      if (memcmp(h[i].shared[k], expected, 32) != 0) {
+        fprintf(stderr, "Operation %u of message %u differs.\n", k, i);
+        return 1;
+      }
+    }
+    if (bad && memcmp(h[i].shared, zero, sizeof(zero)) != 0) {
+      fprintf(stderr, "Message %u was not zeroed.\n", i);
+      return 1;
+    }
+  }
+
+  h[9].peer[2] = basepoint;
+  h[13].count = 0;
+  if (curve25519_donna_handshakes(h, MESSAGES) != 0 ||
+      curve25519_donna_handshakes(h, 0) != 0) {
+    fprintf(stderr, "Good messages were rejected.\n");
+    return 1;
+  }
+  curve25519_donna(expected, h[9].secret[2], basepoint);
+  if (memcmp(h[9].shared[2], expected, 32) != 0) {
+    fprintf(stderr, "The second run differs.\n");
+    return 1;
+  }
+
+  fprintf(stderr, "Handshake batches match curve25519_donna.\n");
+  return 0;
+}
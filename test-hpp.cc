@@ -0,0 +1,124 @@
+/* This file checks that the C++ interface of curve25519-donna.hpp gives the
+ * same keys as the C functions, that it never allocates, and that secrets are
+ * wiped when they are destroyed or moved from. */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna.hpp"
+
+#define TEST_FILL_SEED 0x0f0f0f0f12345678ull
+#include "test-fill.h"
+
+#define KEYS 10
+
+static unsigned allocations;
+
+void *
+operator new(std::size_t n) {
+  allocations++;
+  if (void *p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void
+operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void
+operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+static bool
+all_zero(const uint8_t *p) {
+  for (unsigned i = 0; i < 32; ++i) {
+    if (p[i]) return false;
+  }
+  return true;
+}
+
+int
+main() {
+  static const uint8_t basepoint[32] = {9};
+  curve25519::SecretKey secrets[KEYS];
+  curve25519::PublicKey publics[KEYS], peers[KEYS];
+  curve25519::SharedSecret shared[KEYS];
+  uint8_t expected[32];
+  unsigned i;
+
+  for (i = 0; i < KEYS; ++i) {
+    fill(secrets[i].data(), 32);
+    fill(peers[i].data(), 32);
+  }
+  peers[3] = curve25519::PublicKey();
+
+  if (!curve25519::public_keys(secrets, publics) ||
+      !curve25519::shared_secrets(secrets, peers, shared)) {
+    fprintf(stderr, "Batch sizes were rejected.\n");
+    return 1;
+  }
+  for (i = 0; i < KEYS; ++i) {
+    curve25519_donna(expected, secrets[i].data(), basepoint);
+    if (memcmp(expected, publics[i].data(), 32) != 0 ||
+        !(curve25519::public_key(secrets[i]) == publics[i])) {
+      fprintf(stderr, "Public key %u differs.\n", i);
+      return 1;
+    }
+    curve25519_donna(expected, secrets[i].data(), peers[i].data());
+    if (memcmp(expected, shared[i].data(), 32) != 0 ||
+        memcmp(expected, curve25519::shared_secret(secrets[i], peers[i]).data(),
+               32) != 0 ||
+        shared[i].is_zero() != (i == 3)) {
+      fprintf(stderr, "Shared secret %u differs.\n", i);
+      return 1;
+    }
+  }
+
+  if (!curve25519::shared_secrets(secrets[0], peers, shared)) return 1;
+  for (i = 0; i < KEYS; ++i) {
+    curve25519_donna(expected, secrets[0].data(), peers[i].data());
+    if (memcmp(expected, shared[i].data(), 32) != 0) {
+      fprintf(stderr, "Fanout secret %u differs.\n", i);
+      return 1;
+    }
+  }
+
+  if (curve25519::shared_secrets(secrets, std::span(peers).first(KEYS - 1),
+                                 shared)) {
+    fprintf(stderr, "Mismatched batch sizes were accepted.\n");
+    return 1;
+  }
+
+  /* A moved-from secret is wiped, and so is a destroyed one. */
+  curve25519::SecretKey moved(std::move(secrets[1]));
+  if (!all_zero(secrets[1].data()) || all_zero(moved.data())) {
+    fprintf(stderr, "A moved secret was not wiped.\n");
+    return 1;
+  }
+  alignas(curve25519::SecretKey) unsigned char storage[32];
+  curve25519::SecretKey *key = new (storage) curve25519::SecretKey(moved);
+  key->~SecretKey();
+  /* Read the storage as what it is now, bytes that no object lives in. */
+  const volatile unsigned char *dead = storage;
+  unsigned char left = 0;
+  for (i = 0; i < sizeof(storage); ++i) left |= dead[i];
+  if (left) {
+    fprintf(stderr, "A destroyed secret was not wiped.\n");
+    return 1;
+  }
+
+  if (allocations) {
+    fprintf(stderr, "%u allocations.\n", allocations);
+    return 1;
+  }
+
+  fprintf(stderr, "C++ keys match the C functions.\n");
+  return 0;
+}
@@ -0,0 +1,160 @@
+/* This file checks the HKDF and hashing functions of curve25519-donna-kdf.h
+ * against values computed with Python's hmac and hashlib, on the key
+ * agreement example of RFC 7748, section 6.1. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-kdf.h"
+
+#define TEST_FILL_SEED 0x1234567812345678ull
+#include "test-fill.h"
+
+#define N 40
+#define CHAINS 20
+#define DEPTH 5
+
+static const char alice_secret[] =
+    "77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a";
+static const char bob_public[] =
+    "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f";
+
+static const char hkdf_sha256[] =
+    "dfdf3ce5d8a064972e2c7033de0f29798e773efba52a80c07250c458c7c315a6d41aa94b"
+    "006e18a15fc7";
+static const char hkdf_sha512[] =
+    "d9fbf186ac2aa89816a6a60295924ddd5735edfb098cea7a9d0f3ecc67e7b713065f0a53"
+    "b6efde6f1fcb6826d7a8789d4897aed45d75df7e83ccb6afb97629b2bf9dcc361560f6c4"
+    "132faa9dfc4ca9ca98989e4115299ed8cd69c4f77ab0e5116a0fda3e";
+/* With a 200-byte salt, which HMAC hashes down first. */
+static const char hkdf_long_salt[] =
+    "679279fbea3ca1fc56c4be4b0b4f56f74fe3734c8a9d0420a81834c43ae3ec10";
+/* SHA-256("curve25519-shared:" || shared), as the Python binding does. */
+static const char hash_shared[] =
+    "236cb9de43c42f5665e6d165d943c51a9b9ede228b8db97df1817939065fc264";
+
+static void
+unhex(uint8_t *out, const char *in) {
+  unsigned v;
+
+  for (; sscanf(in, "%2x", &v) == 1; in += 2) *out++ = v;
+}
+
+static int
+check(const char *name, const uint8_t *got, const char *expected) {
+  uint8_t want[128];
+  const size_t len = strlen(expected) / 2;
+
+  unhex(want, expected);
+  if (memcmp(got, want, len) != 0) {
+    fprintf(stderr, "%s differs.\n", name);
+    return 1;
+  }
+  return 0;
+}
+
+int
+main() {
+  static const uint8_t zero[32] = {0};
+  static uint8_t big[255 * 32 + 1];
+  uint8_t secret[32], peer[32], out[128], salt[200];
+  uint8_t secrets[N][32], peers[N][32], keys[N][42], one[42];
+  static uint8_t leaves[CHAINS][32], copath[CHAINS][DEPTH][32];
+  static uint8_t path[CHAINS][DEPTH + 1][32], path_publics[CHAINS][DEPTH + 1][32];
+  unsigned i, j;
+
+  unhex(secret, alice_secret);
+  unhex(peer, bob_public);
+  memset(salt, 'k', sizeof(salt));
+
+  if (curve25519_kdf_hkdf(out, 42, CURVE25519_KDF_SHA256, secret, peer,
+                          (const uint8_t *) "salt", 4,
+                          (const uint8_t *) "info", 4) ||
+      check("HKDF-SHA256", out, hkdf_sha256) ||
+      curve25519_kdf_hkdf(out, 100, CURVE25519_KDF_SHA512, secret, peer,
+                          NULL, 0, NULL, 0) ||
+      check("HKDF-SHA512", out, hkdf_sha512) ||
+      curve25519_kdf_hkdf(out, 32, CURVE25519_KDF_SHA256, secret, peer,
+                          salt, sizeof(salt), (const uint8_t *) "info", 4) ||
+      check("HKDF with a long salt", out, hkdf_long_salt) ||
+      curve25519_kdf_hash_shared(out, CURVE25519_KDF_SHA256, secret, peer,
+                                 (const uint8_t *) "curve25519-shared:", 18) ||
+      check("Hashed shared key", out, hash_shared)) {
+    return 1;
+  }
+
+  /* A peer of small order, and outputs that are too long. */
+  memset(out, 0xaa, sizeof(out));
+  if (curve25519_kdf_hkdf(out, 32, CURVE25519_KDF_SHA256, secret, zero, NULL,
+                          0, NULL, 0) == 0 ||
+      memcmp(out, zero, 32) != 0) {
+    fprintf(stderr, "A zero shared secret was accepted.\n");
+    return 1;
+  }
+  if (curve25519_kdf_hkdf(big, sizeof(big), CURVE25519_KDF_SHA256, secret,
+                          peer, NULL, 0, NULL, 0) == 0 ||
+      curve25519_kdf_hash_size(CURVE25519_KDF_SHA512) != 64) {
+    fprintf(stderr, "Output sizes are not checked.\n");
+    return 1;
+  }
+
+  fill(secrets[0], sizeof(secrets));
+  fill(peers[0], sizeof(peers));
+  memset(peers[7], 0, 32);
+  if (curve25519_kdf_hkdf_batch(keys[0], 42, CURVE25519_KDF_SHA256,
+                                secrets[0], peers[0], N,
+                                (const uint8_t *) "salt", 4,
+                                (const uint8_t *) "info", 4) == 0) {
+    fprintf(stderr, "A zero shared secret was accepted in a batch.\n");
+    return 1;
+  }
+  for (i = 0; i < N; ++i) {
+    curve25519_kdf_hkdf(one, 42, CURVE25519_KDF_SHA256, secrets[i], peers[i],
+                        (const uint8_t *) "salt", 4,
+                        (const uint8_t *) "info", 4);
+    if (memcmp(one, keys[i], 42) != 0) {
+      fprintf(stderr, "Batch key %u differs.\n", i);
+      return 1;
+    }
+  }
+
+  /* The chain of one path, one step at a time. */
+  fill(leaves[0], sizeof(leaves));
+  fill(copath[0][0], sizeof(copath));
+  memset(copath[3][2], 0, 32);
+  if (curve25519_kdf_path(path[0][0], path_publics[0][0], leaves[0],
+                          copath[0][0], DEPTH, CHAINS, CURVE25519_KDF_SHA256,
+                          NULL, 0, (const uint8_t *) "node", 4) == 0) {
+    fprintf(stderr, "A zero shared secret was accepted in a path.\n");
+    return 1;
+  }
+  for (i = 0; i < CHAINS; ++i) {
+    memcpy(secret, leaves[i], 32);
+    for (j = 0; j <= DEPTH; ++j) {
+      static const uint8_t basepoint[32] = {9};
+      curve25519_donna(out, secret, basepoint);
+      if (i == 3) {
+        if (memcmp(path[i][j], zero, 32) != 0 ||
+            memcmp(path_publics[i][j], zero, 32) != 0) {
+          fprintf(stderr, "A failed path was not zeroed.\n");
+          return 1;
+        }
+      } else if (memcmp(path[i][j], secret, 32) != 0 ||
+                 memcmp(path_publics[i][j], out, 32) != 0) {
+        fprintf(stderr, "Path %u differs at node %u.\n", i, j);
+        return 1;
+      }
+      if (j < DEPTH &&
+          curve25519_kdf_hkdf(secret, 32, CURVE25519_KDF_SHA256, secret,
+                              copath[i][j], NULL, 0,
+                              (const uint8_t *) "node", 4) && i != 3) {
+        return 1;
+      }
+    }
+  }
+
+  fprintf(stderr, "Derived keys match.\n");
+  return 0;
+}
@@ -0,0 +1,99 @@
+/* This file writes a key store, maps it and looks every key up by ID and by
+ * public key, checking the secrets come back clamped and the public keys
+ * match curve25519_donna. It also checks that missing keys, duplicate IDs and
+ * damaged files are rejected. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-keystore.h"
+
+#define TEST_FILL_SEED 0x0123456789abcdefull
+#include "test-fill.h"
+
+#define N 1000
+
+int
+main() {
+  static const uint8_t basepoint[32] = {9};
+  static uint64_t ids[N];
+  static uint8_t secrets[N * 32];
+  char path[] = "/tmp/test-keystore-XXXXXX";
+  struct curve25519_keystore *ks;
+  const uint8_t *secret, *public_key;
+  uint8_t expected[32], clamped[32];
+  uint64_t id;
+  unsigned i, j;
+  int fd;
+
+  for (i = 0; i < N; ++i) {
+    ids[i] = fill_next() | 1;  /* even IDs are never used */
+    for (j = 0; j < 32; ++j) secrets[32 * i + j] = fill_next();
+  }
+
+  fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+
+  if (curve25519_keystore_write(path, ids, secrets, N)) {
+    perror("curve25519_keystore_write");
+    return 1;
+  }
+  ks = curve25519_keystore_open(path);
+  if (!ks || curve25519_keystore_count(ks) != N) {
+    fprintf(stderr, "Failed to open the key store.\n");
+    return 1;
+  }
+
+  for (i = 0; i < N; ++i) {
+    memcpy(clamped, secrets + 32 * i, 32);
+    clamped[0] &= 248;
+    clamped[31] &= 127;
+    clamped[31] |= 64;
+    curve25519_donna(expected, clamped, basepoint);
+
+    secret = curve25519_keystore_find(ks, ids[i], &public_key);
+    if (!secret || memcmp(secret, clamped, 32) != 0 ||
+        memcmp(public_key, expected, 32) != 0) {
+      fprintf(stderr, "Lookup of key %u by ID failed.\n", i);
+      return 1;
+    }
+    secret = curve25519_keystore_find_public(ks, expected, &id);
+    if (!secret || memcmp(secret, clamped, 32) != 0 || id != ids[i]) {
+      fprintf(stderr, "Lookup of key %u by public key failed.\n", i);
+      return 1;
+    }
+    if (curve25519_keystore_find(ks, ids[i] - 1, NULL) != NULL) {
+      fprintf(stderr, "A missing ID was found.\n");
+      return 1;
+    }
+  }
+  memset(expected, 0, 32);
+  if (curve25519_keystore_find_public(ks, expected, NULL) != NULL) {
+    fprintf(stderr, "A missing public key was found.\n");
+    return 1;
+  }
+  curve25519_keystore_close(ks);
+
+  ids[N - 1] = ids[0];
+  if (curve25519_keystore_write(path, ids, secrets, N) == 0) {
+    fprintf(stderr, "Duplicate IDs were accepted.\n");
+    return 1;
+  }
+
+  if (truncate(path, 64 + 72 * N) || curve25519_keystore_open(path) != NULL) {
+    fprintf(stderr, "A truncated key store was accepted.\n");
+    return 1;
+  }
+
+  unlink(path);
+  printf("Key store lookups match.\n");
+  return 0;
+}
@@ -0,0 +1,119 @@
+/* This file checks that a ladder run in slices of any size gives the same
+ * result as curve25519_donna, both through the C API, with many ladders
+ * interleaved, and through the coroutine wrapper on a toy run queue. */
+
+#include <coroutine>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-ladder.hpp"
+
+#define TEST_FILL_SEED 0x5555aaaa3333ccccull
+#include "test-fill.h"
+
+#define KEYS 16
+
+static std::deque<std::coroutine_handle<>> run_queue;
+
+/* A coroutine that nobody waits for. */
+struct detached {
+  struct promise_type {
+    detached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+static unsigned finished;
+
+static detached
+handshake(uint8_t *out, const uint8_t *secret, const uint8_t *peer,
+          unsigned steps) {
+  co_await curve25519::sliced(
+      out, secret, peer, steps,
+      [](std::coroutine_handle<> h) { run_queue.push_back(h); });
+  finished++;
+}
+
+int
+main() {
+  static const unsigned slices[] = {1, 2, 7, 64, 254, 255, 1000};
+  uint8_t secrets[KEYS][32], peers[KEYS][32], expected[KEYS][32];
+  uint8_t out[KEYS][32];
+  curve25519_donna_ladder ladders[KEYS];
+  unsigned i, j, left, resumed = 0;
+
+  fill(secrets[0], sizeof(secrets));
+  fill(peers[0], sizeof(peers));
+  for (i = 0; i < KEYS; ++i) {
+    curve25519_donna(expected[i], secrets[i], peers[i]);
+  }
+
+  for (j = 0; j < sizeof(slices) / sizeof(slices[0]); ++j) {
+    for (i = 0; i < KEYS; ++i) {
+      curve25519_donna_ladder_init(&ladders[i], secrets[i], peers[i]);
+      while (curve25519_donna_ladder_step(&ladders[i], slices[j])) {}
+      curve25519_donna_ladder_finish(&ladders[i], out[i]);
+      if (memcmp(out[i], expected[i], 32) != 0) {
+        fprintf(stderr, "Slices of %u, key %u differs.\n", slices[j], i);
+        return 1;
+      }
+    }
+  }
+
+  /* All the ladders at once, round robin, finishing some early. */
+  for (i = 0; i < KEYS; ++i) {
+    curve25519_donna_ladder_init(&ladders[i], secrets[i], peers[i]);
+  }
+  do {
+    left = 0;
+    for (i = 0; i < KEYS; ++i) {
+      left += curve25519_donna_ladder_step(&ladders[i], 3 + i);
+    }
+  } while (left > KEYS * 40);
+  for (i = 0; i < KEYS; ++i) {
+    curve25519_donna_ladder_finish(&ladders[i], out[i]);
+    if (memcmp(out[i], expected[i], 32) != 0) {
+      fprintf(stderr, "Interleaved key %u differs.\n", i);
+      return 1;
+    }
+  }
+
+  memset(out, 0, sizeof(out));
+  for (i = 0; i < KEYS; ++i) {
+    handshake(out[i], secrets[i], peers[i], 16 + i);
+  }
+  while (!run_queue.empty()) {
+    std::coroutine_handle<> h = run_queue.front();
+    run_queue.pop_front();
+    if (finished) {
+      fprintf(stderr, "A handshake finished before the others started.\n");
+      return 1;
+    }
+    h.resume();
+    if (++resumed == KEYS * 4) break;
+  }
+  while (!run_queue.empty()) {
+    std::coroutine_handle<> h = run_queue.front();
+    run_queue.pop_front();
+    h.resume();
+  }
+  if (finished != KEYS) {
+    fprintf(stderr, "%u of %u handshakes finished.\n", finished, KEYS);
+    return 1;
+  }
+  for (i = 0; i < KEYS; ++i) {
+    if (memcmp(out[i], expected[i], 32) != 0) {
+      fprintf(stderr, "Coroutine key %u differs.\n", i);
+      return 1;
+    }
+  }
+
+  fprintf(stderr, "Sliced ladders match single calls.\n");
+  return 0;
+}
@@ -0,0 +1,175 @@
+/* This file checks that jobs run through the offload daemon give the same
+ * results as curve25519_donna, for several client processes at once, and that
+ * clients notice when the daemon goes away, both in curve25519_offload_batch
+ * and on the asynchronous path with jobs in flight. */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-offload.h"
+
+#define TEST_FILL_SEED 0x0123456789abcdefull
+#include "test-fill.h"
+
+#define CLIENTS 4
+#define N 100
+
+static struct curve25519_offload *
+connect_retry(const char *path) {
+  struct curve25519_offload *c;
+  unsigned i;
+
+  for (i = 0; i < 500; ++i) {
+    c = curve25519_offload_connect(path, 16);
+    if (c) return c;
+    usleep(10000);
+  }
+  return NULL;
+}
+
+static int
+client(const char *path) {
+  static const uint8_t basepoint[32] = {9};
+  static uint8_t secrets[N * 32], points[N * 32], out[N * 32];
+  uint8_t expected[32];
+  struct curve25519_offload *c;
+  size_t i, n;
+  ssize_t got;
+
+  c = connect_retry(path);
+  if (!c) {
+    perror("curve25519_offload_connect");
+    return 1;
+  }
+
+  fill(secrets, sizeof(secrets));
+  fill(points, sizeof(points));
+  if (curve25519_offload_batch(c, out, secrets, points, N) ||
+      curve25519_offload_batch(c, out + 32 * (N / 2), secrets, NULL, N / 2)) {
+    perror("curve25519_offload_batch");
+    return 1;
+  }
+  for (i = 0; i < N; ++i) {
+    if (i < N / 2) {
+      curve25519_donna(expected, secrets + 32 * i, points + 32 * i);
+    } else {
+      curve25519_donna(expected, secrets + 32 * (i - N / 2), basepoint);
+    }
+    if (memcmp(expected, out + 32 * i, 32) != 0) {
+      fprintf(stderr, "Offloaded job %u differs.\n", (unsigned) i);
+      return 1;
+    }
+  }
+
+  /* Fill the ring, then collect the results in order. */
+  for (n = 0; curve25519_offload_submit(c, secrets + 32 * n, NULL) == 0; ++n) {}
+  if (errno != EAGAIN || n != 16) {
+    fprintf(stderr, "A full ring accepted a job.\n");
+    return 1;
+  }
+  for (i = 0; i < n; i += got) {
+    got = curve25519_offload_complete(c, out + 32 * i, n - i);
+    if (got < 0) {
+      perror("curve25519_offload_complete");
+      return 1;
+    }
+  }
+  for (i = 0; i < n; ++i) {
+    curve25519_donna(expected, secrets + 32 * i, basepoint);
+    if (memcmp(expected, out + 32 * i, 32) != 0) {
+      fprintf(stderr, "Asynchronous job %u differs.\n", (unsigned) i);
+      return 1;
+    }
+  }
+
+  curve25519_offload_close(c);
+  return 0;
+}
+
+int
+main() {
+  char path[64];
+  static uint8_t secrets[N * 32], out[N * 32];
+  struct curve25519_offload *c, *async;
+  struct pollfd pfd;
+  pid_t daemon, clients[CLIENTS];
+  unsigned i;
+  ssize_t got = 0;
+  int status, failed = 0;
+
+  sprintf(path, "/tmp/test-offload-%d.sock", (int) getpid());
+  unlink(path);
+  daemon = fork();
+  if (daemon == 0) {
+    curve25519_offload_serve(path);
+    perror("curve25519_offload_serve");
+    _exit(1);
+  }
+
+  for (i = 0; i < CLIENTS; ++i) {
+    clients[i] = fork();
+    if (clients[i] == 0) {
+      fill_state += i;
+      _exit(client(path));
+    }
+  }
+  for (i = 0; i < CLIENTS; ++i) {
+    if (waitpid(clients[i], &status, 0) < 0 || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+      failed = 1;
+    }
+  }
+
+  /* The second client has jobs in flight when the daemon dies. */
+  c = connect_retry(path);
+  async = connect_retry(path);
+  if (async) {
+    for (i = 0; i < 8; ++i) curve25519_offload_submit(async, secrets, NULL);
+    while ((got = curve25519_offload_complete(async, out, 1)) == 0) {}
+    for (i = 0; i < 8; ++i) curve25519_offload_submit(async, secrets, NULL);
+  }
+  kill(daemon, SIGKILL);
+  waitpid(daemon, &status, 0);
+  unlink(path);
+  if (failed) return 1;
+
+  if (!async || got != 1) {
+    fprintf(stderr, "The asynchronous client got no result.\n");
+    return 1;
+  }
+  /* Its descriptor must wake a poller, and it must then collect whatever
+   * finished, followed by EPIPE from both calls. */
+  pfd.fd = curve25519_offload_fd(async);
+  pfd.events = POLLIN;
+  if (poll(&pfd, 1, 5000) != 1) {
+    fprintf(stderr, "Polling a client of a dead daemon hung.\n");
+    return 1;
+  }
+  for (i = 0; i < 16; ++i) {
+    got = curve25519_offload_complete(async, out, N);
+    if (got <= 0) break;
+  }
+  if (got != -1 || errno != EPIPE ||
+      curve25519_offload_submit(async, secrets, NULL) == 0 || errno != EPIPE) {
+    fprintf(stderr, "A dead daemon went unnoticed on the asynchronous path.\n");
+    return 1;
+  }
+  curve25519_offload_close(async);
+
+  if (!c || curve25519_offload_batch(c, out, secrets, NULL, N) == 0 ||
+      errno != EPIPE) {
+    fprintf(stderr, "A dead daemon went unnoticed.\n");
+    return 1;
+  }
+  curve25519_offload_close(c);
+
+  fprintf(stderr, "Offloaded jobs match single calls.\n");
+  return 0;
+}
@@ -0,0 +1,90 @@
+/* This file takes keypairs from a pool on several threads and checks that
+ * each one is valid and that none is handed out twice. */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-pool.h"
+
+#define THREADS 4
+#define TAKES 500
+
+static struct curve25519_pool *pool;
+static uint8_t secrets[THREADS * TAKES][32];
+static int failed;
+
+static void *
+taker(void *arg) {
+  static const uint8_t basepoint[32] = {9};
+  const unsigned id = (unsigned) (uintptr_t) arg;
+  uint8_t mypublic[32], expected[32];
+  unsigned i;
+
+  for (i = 0; i < TAKES; ++i) {
+    uint8_t *mysecret = secrets[id * TAKES + i];
+    if (curve25519_pool_take(pool, mypublic, mysecret)) {
+      failed = 1;
+      continue;
+    }
+    curve25519_donna(expected, mysecret, basepoint);
+    if (memcmp(expected, mypublic, 32) != 0 ||
+        (mysecret[0] & 7) != 0 || (mysecret[31] & 0xc0) != 0x40) {
+      failed = 1;
+    }
+  }
+  return NULL;
+}
+
+static int
+compare(const void *a, const void *b) {
+  return memcmp(a, b, 32);
+}
+
+int
+main() {
+  pthread_t threads[THREADS];
+  struct curve25519_pool_stats stats;
+  unsigned i;
+
+  pool = curve25519_pool_new(64, 2);
+  if (!pool) {
+    fprintf(stderr, "Failed to create pool.\n");
+    return 1;
+  }
+
+  for (i = 0; i < THREADS; ++i) {
+    pthread_create(&threads[i], NULL, taker, (void *) (uintptr_t) i);
+  }
+  for (i = 0; i < THREADS; ++i) pthread_join(threads[i], NULL);
+
+  curve25519_pool_stats(pool, &stats);
+  curve25519_pool_free(pool);
+
+  if (failed) {
+    fprintf(stderr, "Pool handed out an invalid keypair.\n");
+    return 1;
+  }
+
+  qsort(secrets, THREADS * TAKES, 32, compare);
+  for (i = 1; i < THREADS * TAKES; ++i) {
+    if (memcmp(secrets[i - 1], secrets[i], 32) == 0) {
+      fprintf(stderr, "Pool handed out a keypair twice.\n");
+      return 1;
+    }
+  }
+
+  if (stats.taken + stats.misses != THREADS * TAKES ||
+      stats.capacity != 64 || stats.low_watermark > stats.capacity ||
+      stats.taken > stats.generated || stats.rng_failures != 0) {
+    fprintf(stderr, "Pool statistics are inconsistent.\n");
+    return 1;
+  }
+
+  fprintf(stderr, "Pool handed out %u distinct keypairs (%u misses).\n",
+          THREADS * TAKES, (unsigned) stats.misses);
+  return 0;
+}
@@ -0,0 +1,72 @@
+/* This file checks that curve25519_donna_table_mult gives the same results as
+ * curve25519_donna for every window size, for peers on the curve, on the
+ * twist, of low order and not in canonical form. */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "curve25519-donna.h"
+
+#define TEST_FILL_SEED 0xfedcba9876543210ull
+#include "test-fill.h"
+
+#define PEERS 12
+#define SECRETS 20
+
+int
+main() {
+  static const uint8_t basepoint[32] = {9};
+  uint8_t peers[PEERS][32], secrets[SECRETS][32], expected[32], out[32];
+  struct curve25519_donna_table *table;
+  unsigned window, i, j;
+
+  memcpy(peers[0], basepoint, 32);
+  for (i = 1; i < 5; ++i) {
+    fill(secrets[0], 32);
+    curve25519_donna(peers[i], secrets[0], basepoint);
+  }
+  /* Random values: about half of them are on the twist. */
+  for (; i < 8; ++i) fill(peers[i], 32);
+  /* 0 and 1 are of low order, p-1 has no Edwards y, 2^255-1 is p+18 and has
+   * the top bit set. */
+  memset(peers[8], 0, 32);
+  memset(peers[9], 0, 32);
+  peers[9][0] = 1;
+  memset(peers[10], 0xff, 32);
+  peers[10][0] = 0xec;
+  peers[10][31] = 0x7f;
+  memset(peers[11], 0xff, 32);
+
+  fill(secrets[0], sizeof(secrets));
+
+  if (curve25519_donna_table_new(basepoint, 1) ||
+      curve25519_donna_table_new(basepoint, 9) ||
+      curve25519_donna_table_size(9) != 0) {
+    fprintf(stderr, "Out of range windows accepted.\n");
+    return 1;
+  }
+
+  for (window = 2; window <= 8; ++window) {
+    for (i = 0; i < PEERS; ++i) {
+      table = curve25519_donna_table_new(peers[i], window);
+      if (!table) {
+        fprintf(stderr, "Table allocation failed.\n");
+        return 1;
+      }
+      for (j = 0; j < SECRETS; ++j) {
+        curve25519_donna(expected, secrets[j], peers[i]);
+        curve25519_donna_table_mult(out, table, secrets[j]);
+        if (memcmp(expected, out, 32) != 0) {
+          fprintf(stderr, "Window %u, peer %u, secret %u differs.\n", window,
+                  i, j);
+          return 1;
+        }
+      }
+      curve25519_donna_table_free(table);
+    }
+  }
+
+  fprintf(stderr, "Table multiplications match single calls.\n");
+  return 0;
+}
@@ -0,0 +1,132 @@
+/* This file checks, with the library built with -DCURVE25519_DONNA_TELEMETRY,
+ * that every call is recorded once under its entry point and its ladder
+ * backend, whichever thread made it, and that exported snapshots can be read
+ * back from shared memory. */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "curve25519-donna.h"
+#include "curve25519-donna-telemetry.h"
+
+#define THREADS 4
+#define CALLS 10
+
+static void *
+worker(void *arg) {
+  static const uint8_t basepoint[32] = {9};
+  uint8_t secret[32], out[32];
+  unsigned i;
+
+  memset(secret, (int) (uintptr_t) arg, 32);
+  for (i = 0; i < CALLS; ++i) {
+    secret[0] = i;
+    curve25519_donna(out, secret, basepoint);
+  }
+  return NULL;
+}
+
+/* Runs THREADS threads of CALLS calls each. */
+static int
+run_threads(void) {
+  pthread_t threads[THREADS];
+  unsigned i;
+
+  for (i = 0; i < THREADS; ++i) {
+    if (pthread_create(&threads[i], NULL, worker, (void *) (uintptr_t) i)) {
+      return -1;
+    }
+  }
+  for (i = 0; i < THREADS; ++i) pthread_join(threads[i], NULL);
+  return 0;
+}
+
+static uint64_t
+bucket_total(const struct curve25519_telemetry *t, enum curve25519_probe p) {
+  uint64_t total = 0;
+  unsigned i;
+
+  for (i = 0; i < CURVE25519_TELEMETRY_BUCKETS; ++i) total += t->counts[p][i];
+  return total;
+}
+
+int
+main() {
+  static struct curve25519_telemetry t;
+  static uint8_t secrets[4 * 32], out[4 * 32];
+  const struct curve25519_telemetry_segment *seg;
+  uint64_t floor, next;
+  char name[64];
+  unsigned i;
+  int fd;
+
+  for (i = 0; i + 1 < CURVE25519_TELEMETRY_BUCKETS; ++i) {
+    floor = curve25519_telemetry_bucket_floor(i);
+    next = curve25519_telemetry_bucket_floor(i + 1);
+    if (next <= floor || (i >= 8 && 8 * next > 9 * floor)) {
+      fprintf(stderr, "Bucket %u is [%llu, %llu).\n", i,
+              (unsigned long long) floor, (unsigned long long) next);
+      return 1;
+    }
+  }
+
+  /* The second round of threads takes over the blocks of the first. */
+  if (run_threads() || run_threads()) {
+    perror("pthread_create");
+    return 1;
+  }
+  memset(secrets, 7, sizeof(secrets));
+  curve25519_donna_batch(out, secrets, NULL, 4);
+
+  curve25519_telemetry_snapshot(&t);
+  if (t.calls[CURVE25519_PROBE_DONNA] != 2 * THREADS * CALLS ||
+      bucket_total(&t, CURVE25519_PROBE_DONNA) != 2 * THREADS * CALLS ||
+      t.calls[CURVE25519_PROBE_LADDER] != 2 * THREADS * CALLS ||
+      t.calls[CURVE25519_PROBE_BATCH] != 1 ||
+      t.calls[CURVE25519_PROBE_LADDER_X2] +
+          t.calls[CURVE25519_PROBE_LADDER_LANES] +
+          t.calls[CURVE25519_PROBE_LADDER_LANES8] +
+          t.calls[CURVE25519_PROBE_LADDER_FLANES] == 0) {
+    fprintf(stderr, "Calls were not all recorded.\n");
+    return 1;
+  }
+  if (curve25519_telemetry_quantile(&t, CURVE25519_PROBE_DONNA, 0.5) == 0 ||
+      curve25519_telemetry_quantile(&t, CURVE25519_PROBE_DONNA, 0.5) >
+          curve25519_telemetry_quantile(&t, CURVE25519_PROBE_DONNA, 0.99) ||
+      curve25519_telemetry_quantile(&t, CURVE25519_PROBE_FANOUT, 0.5) != 0) {
+    fprintf(stderr, "Quantiles are inconsistent.\n");
+    return 1;
+  }
+
+  sprintf(name, "/test-telemetry-%d", (int) getpid());
+  if (curve25519_telemetry_export(name)) {
+    perror("curve25519_telemetry_export");
+    return 1;
+  }
+  fd = shm_open(name, O_RDONLY, 0);
+  shm_unlink(name);
+  if (fd < 0) {
+    perror("shm_open");
+    return 1;
+  }
+  seg = mmap(NULL, sizeof(*seg), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (seg == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  if (seg->magic != CURVE25519_TELEMETRY_MAGIC || seg->seq % 2 ||
+      seg->probes != CURVE25519_PROBES ||
+      seg->snapshot.calls[CURVE25519_PROBE_DONNA] != 2 * THREADS * CALLS) {
+    fprintf(stderr, "The exported snapshot differs.\n");
+    return 1;
+  }
+
+  fprintf(stderr, "Telemetry recorded every call.\n");
+  return 0;
+}